@@ -0,0 +1,119 @@
+/*
+* xPL for ESP8266
+*
+* Microbenchmark helpers
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include "bench.h"
+
+#define BENCH_MIN_NS	20000000ULL		// Each run lasts at least this long
+#define BENCH_RUNS		25				// Keep the best, the others are mostly noise from the machine
+
+volatile uint32 bench_sink;
+
+static uint64 bench_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	}
+
+// Calls fn n times, returns the elapsed ns
+static uint64 bench_loop(bench_fn fn, void *arg, uint64 n) {
+	uint64 start = bench_ns(), i;
+
+	for (i = 0; i < n; i++)
+		fn(arg);
+	return bench_ns() - start;
+	}
+
+// Number of calls that takes long enough to time
+static uint64 bench_calibrate(bench_fn fn, void *arg) {
+	uint64 n = 1;
+
+	while (bench_loop(fn, arg, n) < BENCH_MIN_NS)
+		n *= 2;
+	return n;
+	}
+
+// Instructions one call to fn(arg) takes, single stepped in a child, -1 if ptrace is not allowed.
+// Counts include the return from the first raise() and the second call, nothing() takes those out.
+static long bench_steps(bench_fn fn, void *arg) {
+	pid_t pid;
+	int status;
+	long steps = 0;
+
+	fflush(stdout);
+	if ((pid = fork()) == 0) {
+		fn(arg);							// Resolve the library calls outside the count
+		if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) == 0) {
+			raise(SIGSTOP);
+			fn(arg);
+			raise(SIGSTOP);
+			}
+		_exit(0);
+		}
+
+	if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFSTOPPED(status))
+		return -1;
+	for (;;) {
+		if (ptrace(PTRACE_SINGLESTEP, pid, NULL, NULL) < 0 || waitpid(pid, &status, 0) < 0 || !WIFSTOPPED(status)) {
+			steps = -1;
+			break;
+			}
+		if (WSTOPSIG(status) == SIGSTOP)
+			break;
+		steps++;
+		}
+	kill(pid, SIGKILL);
+	waitpid(pid, &status, 0);
+	return steps;
+	}
+
+static void nothing(void *arg) {
+	}
+
+// Instructions per call of fn(arg)
+static long bench_insns(bench_fn fn, void *arg) {
+	long steps = bench_steps(fn, arg), base = bench_steps(nothing, arg);
+
+	return steps < 0 || base < 0 ? -1 : steps - base;
+	}
+
+// Time fn against ref, the code it replaces. The runs alternate, so both see the same machine.
+void bench_compare(const char *name, bench_fn fn, bench_fn ref, void *arg) {
+	uint64 n = bench_calibrate(fn, arg), m = bench_calibrate(ref, arg);
+	double best = 0, best_ref = 0, ns;
+	int run;
+
+	for (run = 0; run < BENCH_RUNS; run++) {
+		ns = (double)bench_loop(fn, arg, n) / n;
+		if (run == 0 || ns < best) best = ns;
+		ns = (double)bench_loop(ref, arg, m) / m;
+		if (run == 0 || ns < best_ref) best_ref = ns;
+		}
+
+	printf("%-32s %8.1f ns, %8.1f ns before, %5.2fx   %4ld insns, %4ld before\n", name, best, best_ref, best_ref / best,
+		bench_insns(fn, arg), bench_insns(ref, arg));
+	}
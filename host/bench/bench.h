@@ -0,0 +1,36 @@
+/*
+* xPL for ESP8266
+*
+* Microbenchmark helpers
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef bench_h
+#define bench_h
+
+#include "port/host.h"
+
+typedef void (*bench_fn)(void *arg);
+
+// Time fn(arg) against ref(arg), prints the best ns per call of each
+void bench_compare(const char *name, bench_fn fn, bench_fn ref, void *arg);
+
+// Store results here so the calls are not optimised away
+extern volatile uint32 bench_sink;
+
+#endif
@@ -0,0 +1,64 @@
+/*
+* xPL for ESP8266
+*
+* Microbenchmark: decoding a binary frame against parsing the same message as text
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "bench.h"
+#include "xPL.h"
+#include "xPL_Binary.h"
+
+static char text[XPL_MESSAGE_BUFFER_MAX];
+static char frame[XPL_MESSAGE_BUFFER_MAX];
+
+static void bench_decode(void *arg) {
+	xPL_Message *msg = new_xPL_Message();
+
+	bench_sink += xPL_BinDecode(msg, frame);
+	bench_sink += msg->command_count;
+	free_xPL_Message(msg);
+	}
+
+static void bench_parse(void *arg) {
+	xPL_Message *msg = new_xPL_Message();
+
+	xPL_Parse(msg, text);
+	bench_sink += msg->command_count;
+	free_xPL_Message(msg);
+	}
+
+int main(void) {
+	xPL_Message *msg = new_xPL_Message();
+
+	msg->type = XPL_TRIG;
+	msg->hop = 1;
+	xPL_Message_SetSource(msg, "peteben", "ESP8266", "ESP-01");
+	xPL_Message_SetTarget(msg, "*", NULL, NULL);
+	xPL_Message_SetSchema(msg, "sensor", "basic");
+	xPL_Message_AddCommand(msg, "device", "C1");
+	xPL_Message_AddCommand(msg, "type", "temp");
+	xPL_Message_AddCommand(msg, "current", "-1234");
+	xPL_Message_AddCommand(msg, "msgid", "4711");
+	xPL_Message_toString(msg, text, sizeof(text));
+	printf("%d bytes binary, %d text\n", xPL_BinEncode(msg, frame, sizeof(frame)), (int)strlen(text));
+	free_xPL_Message(msg);
+
+	bench_compare("sensor.basic trigger", bench_decode, bench_parse, NULL);
+	return 0;
+	}
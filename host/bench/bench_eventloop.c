@@ -0,0 +1,107 @@
+/*
+* xPL for ESP8266
+*
+* Benchmark: what the tasks and queues cost, and how long events wait, in the simulation
+*
+* Build once with EVENT_LOOP 0 and once with 1 to compare. The RAM figures are what the firmware
+* asks of FreeRTOS, in ESP8266 bytes. The times are virtual: the code itself takes none, so they
+* only show what each build waits for, ticks, queues and debounce samples.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "bench.h"
+#include "port/sim.h"
+#include "UserConfig.h"
+
+#define EVENTS		100					// Of each kind
+
+void user_init(void);
+
+// Time from an event to the packet it causes
+struct wait {
+	const char *name;
+	const char *reply;					// Start of the packet that ends the wait
+	uint64 start;						// 0 when not waiting
+	uint64 total;
+	uint64 worst;
+	unsigned count;
+	};
+
+static struct wait command = { "x10 command to stat", "xpl-stat\n{\nhop=1\nsource=peteben-ESP8266.ESP-01\ntarget=*\n}\nx10.basic" };
+static struct wait input = { "input edge to trigger", "xpl-trig\n{\nhop=1\nsource=peteben-ESP8266.ESP-01\ntarget=*\n}\nx10.basic" };
+
+static const char *commands[2] = {			// The LED starts on
+	"xpl-cmnd\n{\nhop=1\nsource=acme-console.test\ntarget=peteben-ESP8266.ESP-01\n}\nx10.basic\n{\ncommand=off\ndevice=C1\n}\n",
+	"xpl-cmnd\n{\nhop=1\nsource=acme-console.test\ntarget=peteben-ESP8266.ESP-01\n}\nx10.basic\n{\ncommand=on\ndevice=C1\n}\n",
+	};
+
+static void start(void *arg) {
+	((struct wait *)arg)->start = sim_now();
+	}
+
+static void end(struct wait *wait, const struct sim_packet *packet) {
+	uint64 time;
+
+	if (wait->start == 0 || strncmp(packet->data, wait->reply, strlen(wait->reply)) != 0)
+		return;
+	time = packet->time - wait->start;
+	wait->total += time;
+	if (time > wait->worst) wait->worst = time;
+	wait->count++;
+	wait->start = 0;
+	}
+
+static void sent(const struct sim_packet *packet) {
+	end(&command, packet);
+	end(&input, packet);
+	}
+
+static void print(const struct wait *wait) {
+	printf("%-28s %6.2f ms average, %6.2f ms worst, %d of %d\n", wait->name,
+		wait->count ? wait->total / 1000.0 / wait->count : 0.0, wait->worst / 1000.0, wait->count, EVENTS);
+	}
+
+int main(void) {
+	uint64 time;
+	int i;
+
+	sim_init();
+	sim_on_send(sent);
+	user_init();
+	sim_run_until(1 * SIM_S);
+
+	printf("EVENT_LOOP %d: %u tasks, %lu bytes of stack, %u queues, %lu bytes of queue items\n",
+		EVENT_LOOP, host_ram.tasks, host_ram.stack, host_ram.queues, host_ram.queue);
+
+	// Spread over the tick, 1.37 ms apart in it
+	for (i = 0; i < EVENTS; i++) {
+		time = 1 * SIM_S + i * 100 * SIM_MS + i * 1370 % 10000;
+		sim_at(time, start, &command);
+		sim_inject(time, commands[i & 1]);
+		}
+	for (i = 0; i < EVENTS; i++) {
+		time = 12 * SIM_S + i * 200 * SIM_MS + i * 1370 % 10000;
+		sim_at(time, start, &input);
+		sim_gpio(time, INPUT_GPIO, i & 1 ? INPUT_GPIO : 0);
+		}
+	sim_run_until(34 * SIM_S);
+
+	print(&command);
+	print(&input);
+	return 0;
+	}
@@ -0,0 +1,57 @@
+/*
+* xPL for ESP8266
+*
+* Microbenchmark: integer conversions in sscanf, 32 bit path against the 64 bit one
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "bench.h"
+#include "xPL_utils.h"
+
+struct conv {
+	const char *in;
+	const char *fmt;					// %d
+	const char *fmt_q;					// The same with %qd
+	};
+
+// %d, %u... now convert in 32 bits
+static void bench_int(void *arg) {
+	const struct conv *conv = arg;
+	int v = 0;
+
+	sscanf(conv->in, conv->fmt, &v);
+	bench_sink += v;
+	}
+
+// %qd goes through strtoq as every %d used to
+static void bench_quad(void *arg) {
+	const struct conv *conv = arg;
+	long long v = 0;
+
+	sscanf(conv->in, conv->fmt_q, &v);
+	bench_sink += v;
+	}
+
+int main(void) {
+	static const struct conv hop = { "hop=1", XPL_HOP_COUNT_PARSER, "hop=%qd" };
+	static const struct conv interval = { "interval=12345678", "interval=%d", "interval=%qd" };
+
+	bench_compare("sscanf hop=%d", bench_int, bench_quad, (void *)&hop);
+	bench_compare("sscanf interval=%d", bench_int, bench_quad, (void *)&interval);
+	return 0;
+	}
@@ -0,0 +1,240 @@
+/*
+* xPL for ESP8266
+*
+* Host build: the parts of the ESP8266 SDK the firmware uses, implemented in port/esp.c
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef esp_common_h
+#define esp_common_h
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// glibc binds sscanf to its own C99 version whatever the mode, send the calls to the one in sscanf.c
+#define sscanf		xpl_sscanf
+#define vsscanf		xpl_vsscanf
+int sscanf(const char *ibuf, const char *fmt, ...);
+int vsscanf(const char *inp, const char *fmt0, va_list ap);
+
+typedef unsigned char uint8;
+typedef unsigned short uint16;
+typedef unsigned int uint32;
+typedef unsigned long long uint64;
+typedef signed char sint8;
+typedef short sint16;
+typedef int sint32;
+typedef signed char int8;
+typedef short int16;
+typedef unsigned char u8_t;
+typedef unsigned short u16_t;
+typedef unsigned int u32_t;
+typedef signed char s8_t;
+
+typedef unsigned char bool;
+#define true 1
+#define false 0
+
+#define ICACHE_FLASH_ATTR
+#define IRAM_ATTR
+
+#define BIT(n)		(1UL << (n))
+#define BIT0		0x1
+#define BIT1		0x2
+#define BIT2		0x4
+#define BIT3		0x8
+#define BIT4		0x10
+#define BIT5		0x20
+#define BIT6		0x40
+#define BIT7		0x80
+#define BIT8		0x100
+#define BIT9		0x200
+#define BIT10		0x400
+#define BIT11		0x800
+#define BIT12		0x1000
+#define BIT13		0x2000
+#define BIT14		0x4000
+#define BIT15		0x8000
+
+#define SDK_VERSION_MAJOR		0
+#define SDK_VERSION_MINOR		0
+#define SDK_VERSION_REVISION	0
+
+void *zalloc(size_t size);
+
+// System
+enum { REASON_DEFAULT_RST = 0, REASON_WDT_RST, REASON_EXCEPTION_RST, REASON_SOFT_WDT_RST, REASON_SOFT_RESTART, REASON_DEEP_SLEEP_AWAKE, REASON_EXT_SYS_RST };
+
+struct rst_info {
+	uint32 reason;
+	uint32 exccause;
+	uint32 epc1;
+	uint32 epc2;
+	uint32 epc3;
+	uint32 excvaddr;
+	uint32 depc;
+	};
+
+struct rst_info *system_get_rst_info(void);
+uint32 system_get_time(void);
+uint32 system_get_free_heap_size(void);
+uint16 system_adc_read(void);
+void system_deep_sleep(uint32 time_in_us);
+bool system_rtc_mem_read(uint8 src_addr, void *des_addr, uint16 save_size);
+bool system_rtc_mem_write(uint8 des_addr, const void *src_addr, uint16 save_size);
+bool system_param_save_with_protect(uint16 start_sec, void *param, uint16 len);
+bool system_param_load(uint16 start_sec, uint16 offset, void *param, uint16 len);
+
+// Wi-Fi
+#define STATION_IF		0
+#define STATION_MODE	1
+
+struct ip_addr {
+	uint32 addr;
+	};
+typedef struct ip_addr ip_addr_t;
+
+struct ip_info {
+	struct ip_addr ip;
+	struct ip_addr netmask;
+	struct ip_addr gw;
+	};
+
+struct station_config {
+	uint8 ssid[32];
+	uint8 password[64];
+	uint8 bssid_set;
+	uint8 bssid[6];
+	};
+
+enum { STATION_IDLE = 0, STATION_CONNECTING, STATION_WRONG_PASSWORD, STATION_NO_AP_FOUND, STATION_CONNECT_FAIL, STATION_GOT_IP };
+enum { EVENT_STAMODE_CONNECTED = 0, EVENT_STAMODE_DISCONNECTED, EVENT_STAMODE_AUTHMODE_CHANGE, EVENT_STAMODE_GOT_IP, EVENT_STAMODE_DHCP_TIMEOUT };
+
+typedef struct {
+	uint32 event_id;
+	} System_Event_t;
+
+typedef void (*wifi_event_handler_cb_t)(System_Event_t *event);
+
+bool wifi_set_opmode(uint8 mode);
+bool wifi_station_set_config(struct station_config *config);
+bool wifi_station_get_config(struct station_config *config);
+bool wifi_station_connect(void);
+bool wifi_station_disconnect(void);
+uint8 wifi_station_get_connect_status(void);
+bool wifi_station_dhcpc_start(void);
+bool wifi_station_dhcpc_stop(void);
+bool wifi_get_ip_info(uint8 if_index, struct ip_info *info);
+bool wifi_set_ip_info(uint8 if_index, struct ip_info *info);
+bool wifi_set_channel(uint8 channel);
+uint8 wifi_get_channel(void);
+void wifi_set_event_handler_cb(wifi_event_handler_cb_t cb);
+
+// Software timers
+typedef void os_timer_func_t(void *arg);
+
+typedef struct _os_timer_t {
+	struct _os_timer_t *next;
+	uint32 expire;					// system_get_time() / 1000
+	uint32 period;					// ms, 0 for a one shot
+	os_timer_func_t *func;
+	void *arg;
+	} os_timer_t;
+
+void os_timer_setfn(os_timer_t *timer, os_timer_func_t *func, void *arg);
+void os_timer_arm(os_timer_t *timer, uint32 ms, bool repeat);
+void os_timer_disarm(os_timer_t *timer);
+
+// Interrupts
+#define ETS_GPIO_INUM			4
+#define ETS_FRC_TIMER1_INUM		9
+
+typedef void (*_xt_isr)(void *arg);
+void _xt_isr_attach(uint8 i, _xt_isr func, void *arg);
+void _xt_isr_unmask(uint32 unmask);
+void _xt_isr_mask(uint32 mask);
+
+// GPIO, the registers are plain variables
+#define GPIO_OUT_ADDRESS			0x00
+#define GPIO_OUT_W1TS_ADDRESS		0x04
+#define GPIO_OUT_W1TC_ADDRESS		0x08
+#define GPIO_ENABLE_ADDRESS			0x0c
+#define GPIO_IN_ADDRESS				0x18
+#define GPIO_STATUS_ADDRESS			0x1c
+#define GPIO_STATUS_W1TC_ADDRESS	0x24
+
+uint32 host_gpio_reg_read(uint32 reg);
+void host_gpio_reg_write(uint32 reg, uint32 val);
+#define GPIO_REG_READ(reg)			host_gpio_reg_read(reg)
+#define GPIO_REG_WRITE(reg, val)	host_gpio_reg_write(reg, val)
+
+typedef enum { GPIO_PIN_INTR_DISABLE = 0, GPIO_PIN_INTR_POSEDGE, GPIO_PIN_INTR_NEGEDGE, GPIO_PIN_INTR_ANYEDGE, GPIO_PIN_INTR_LOLEVEL, GPIO_PIN_INTR_HILEVEL } GPIO_INT_TYPE;
+#define GPIO_ID_PIN(n)		(n)
+
+void gpio_output_set(uint32 set_mask, uint32 clear_mask, uint32 enable_mask, uint32 disable_mask);
+uint32 gpio_input_get(void);
+void gpio_pin_intr_state_set(uint32 i, GPIO_INT_TYPE intr_state);
+
+// IO mux, nothing to select on the host
+#define PERIPHS_IO_MUX_MTDI_U		0x04
+#define PERIPHS_IO_MUX_MTCK_U		0x08
+#define PERIPHS_IO_MUX_MTMS_U		0x0C
+#define PERIPHS_IO_MUX_MTDO_U		0x10
+#define PERIPHS_IO_MUX_U0RXD_U		0x14
+#define PERIPHS_IO_MUX_U0TXD_U		0x18
+#define PERIPHS_IO_MUX_SD_DATA2_U	0x24
+#define PERIPHS_IO_MUX_SD_DATA3_U	0x28
+#define PERIPHS_IO_MUX_GPIO0_U		0x34
+#define PERIPHS_IO_MUX_GPIO2_U		0x38
+#define PERIPHS_IO_MUX_GPIO5_U		0x3C
+#define PERIPHS_IO_MUX_GPIO4_U		0x40
+#define FUNC_GPIO0		0
+#define FUNC_GPIO1		3
+#define FUNC_GPIO2		0
+#define FUNC_GPIO3		3
+#define FUNC_GPIO4		0
+#define FUNC_GPIO5		0
+#define FUNC_GPIO9		3
+#define FUNC_GPIO10		3
+#define FUNC_GPIO12		3
+#define FUNC_GPIO13		3
+#define FUNC_GPIO14		3
+#define FUNC_GPIO15		3
+#define PIN_FUNC_SELECT(reg, func)	((void)(reg), (void)(func))
+#define PIN_PULLUP_EN(reg)			((void)(reg))
+#define PIN_PULLUP_DIS(reg)			((void)(reg))
+
+// FRC1 timer, see host_rtc_reg_write
+#define PERIPHS_TIMER_BASEDDR	0x60000600
+#define FRC1_LOAD_ADDRESS		(PERIPHS_TIMER_BASEDDR + 0x0)
+#define FRC1_CTRL_ADDRESS		(PERIPHS_TIMER_BASEDDR + 0x8)
+#define FRC1_INT_ADDRESS		(PERIPHS_TIMER_BASEDDR + 0xc)
+#define FRC1_INT_CLR_MASK		0x00000001
+#define FRC1_ENABLE_TIMER		BIT7
+#define DIVDED_BY_16			4
+#define TM_EDGE_INT				0
+
+void host_rtc_reg_write(uint32 reg, uint32 val);
+#define RTC_REG_WRITE(reg, val)			host_rtc_reg_write(reg, val)
+#define RTC_CLR_REG_MASK(reg, mask)		((void)(reg), (void)(mask))
+#define TM1_EDGE_INT_ENABLE()
+#define TM1_EDGE_INT_DISABLE()
+
+#endif
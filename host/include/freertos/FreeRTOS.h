@@ -0,0 +1,38 @@
+/*
+* xPL for ESP8266
+*
+* Host build: FreeRTOS types, implemented in port/freertos.c
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef FreeRTOS_h
+#define FreeRTOS_h
+
+typedef unsigned int portTickType;
+typedef long portBASE_TYPE;
+
+#define portMAX_DELAY				((portTickType)0xffffffffUL)
+#define portTICK_RATE_MS			10
+#define pdTRUE						1
+#define pdFALSE						0
+#define pdPASS						1
+#define pdFAIL						0
+#define errQUEUE_FULL				0
+#define portEND_SWITCHING_ISR(x)	((void)(x))
+
+#endif
@@ -0,0 +1,38 @@
+/*
+* xPL for ESP8266
+*
+* Host build: FreeRTOS queues
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef queue_h
+#define queue_h
+
+#include "FreeRTOS.h"
+
+typedef struct host_queue *xQueueHandle;
+
+xQueueHandle xQueueCreate(unsigned long len, unsigned long item);
+portBASE_TYPE xQueueSendToBack(xQueueHandle queue, const void *item, portTickType wait);
+portBASE_TYPE xQueueSendFromISR(xQueueHandle queue, const void *item, portBASE_TYPE *woken);
+portBASE_TYPE xQueueReceive(xQueueHandle queue, void *item, portTickType wait);
+unsigned long uxQueueMessagesWaiting(xQueueHandle queue);
+
+#define xQueueSend(q, item, wait)	xQueueSendToBack(q, item, wait)
+
+#endif
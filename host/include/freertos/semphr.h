@@ -0,0 +1,37 @@
+/*
+* xPL for ESP8266
+*
+* Host build: FreeRTOS binary semaphores, one item queues
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef semphr_h
+#define semphr_h
+
+#include "queue.h"
+
+typedef xQueueHandle xSemaphoreHandle;
+
+xSemaphoreHandle host_sem_create(void);
+portBASE_TYPE xSemaphoreTake(xSemaphoreHandle sem, portTickType wait);
+portBASE_TYPE xSemaphoreGive(xSemaphoreHandle sem);
+portBASE_TYPE xSemaphoreGiveFromISR(xSemaphoreHandle sem, portBASE_TYPE *woken);
+
+#define vSemaphoreCreateBinary(s)	((s) = host_sem_create())
+
+#endif
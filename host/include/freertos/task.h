@@ -0,0 +1,44 @@
+/*
+* xPL for ESP8266
+*
+* Host build: FreeRTOS tasks
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef task_h
+#define task_h
+
+#include "FreeRTOS.h"
+
+typedef void *xTaskHandle;
+typedef void (*pdTASK_CODE)(void *);
+
+portBASE_TYPE xTaskCreate(pdTASK_CODE code, const char *name, unsigned short stack, void *param, unsigned long prio, xTaskHandle *handle);
+void vTaskDelete(xTaskHandle task);
+void vTaskDelay(portTickType ticks);
+void vTaskDelayUntil(portTickType *prev, portTickType inc);
+portTickType xTaskGetTickCount(void);
+unsigned long uxTaskGetStackHighWaterMark(xTaskHandle task);
+xTaskHandle xTaskGetCurrentTaskHandle(void);
+void vPortEnterCritical(void);
+void vPortExitCritical(void);
+
+#define taskENTER_CRITICAL()	vPortEnterCritical()
+#define taskEXIT_CRITICAL()		vPortExitCritical()
+
+#endif
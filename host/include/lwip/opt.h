@@ -0,0 +1,2 @@
+// Host build: nothing beyond esp_common.h
+#include "esp_common.h"
@@ -0,0 +1,49 @@
+/*
+* xPL for ESP8266
+*
+* Host build: lwIP raw UDP API over sockets, implemented in port/lwip.c
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef udp_h
+#define udp_h
+
+#include "pbuf.h"
+
+typedef s8_t err_t;
+
+#define ERR_OK		0
+#define ERR_MEM		-1
+#define ERR_BUF		-2
+#define ERR_VAL		-6
+#define ERR_USE		-8
+
+extern const struct ip_addr ip_addr_any, ip_addr_broadcast;
+#define IP_ADDR_ANY			((struct ip_addr *)&ip_addr_any)
+#define IP_ADDR_BROADCAST	((struct ip_addr *)&ip_addr_broadcast)
+
+struct udp_pcb;
+typedef void (*udp_recv_fn)(void *arg, struct udp_pcb *pcb, struct pbuf *p, struct ip_addr *addr, u16_t port);
+
+struct udp_pcb *udp_new(void);
+void udp_remove(struct udp_pcb *pcb);
+err_t udp_bind(struct udp_pcb *pcb, struct ip_addr *addr, u16_t port);
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *arg);
+err_t udp_sendto(struct udp_pcb *pcb, struct pbuf *p, struct ip_addr *addr, u16_t port);
+
+#endif
@@ -0,0 +1,93 @@
+/*
+* xPL for ESP8266
+*
+* Host build: runs the firmware as a Linux daemon
+*
+* xpl-host [-d] [-a addr] [-l port] [-s addr[:port]]
+*   -d			detach from the terminal
+*   -a addr		IP address the device reports, 127.0.0.1 by default
+*   -l port		listen on port instead of the xPL port
+*   -s addr[:port]	send everything to addr instead of broadcasting on the xPL port
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include "port/host.h"
+
+void user_init(void);
+
+struct host_options host_options;
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s [-d] [-a addr] [-l port] [-s addr[:port]]\n", name);
+	exit(2);
+	}
+
+static uint32 parse_addr(const char *name, const char *addr) {
+	struct in_addr in;
+
+	if (inet_pton(AF_INET, addr, &in) != 1) usage(name);
+	return in.s_addr;
+	}
+
+int main(int argc, char **argv) {
+	int detach = 0;
+	char *port;
+	sigset_t sigs;
+	int sig;
+	int opt;
+
+	host_options.ip_addr = htonl(INADDR_LOOPBACK);
+
+	while ((opt = getopt(argc, argv, "da:l:s:")) != -1) {
+		switch (opt) {
+			case 'd': detach = 1; break;
+			case 'a': host_options.ip_addr = parse_addr(argv[0], optarg); break;
+			case 'l': host_options.listen_port = atoi(optarg); break;
+			case 's':
+				if ((port = strchr(optarg, ':')) != NULL) {
+					*port++ = '\0';
+					host_options.send_port = atoi(port);
+					}
+				host_options.send_addr = parse_addr(argv[0], optarg);
+				break;
+			default: usage(argv[0]);
+			}
+		}
+
+	if (detach && daemon(0, 0) < 0) {
+		perror("daemon");
+		return 1;
+		}
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	// Everything runs in the firmware threads, we just wait to be stopped
+	sigemptyset(&sigs);
+	sigaddset(&sigs, SIGINT);
+	sigaddset(&sigs, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+
+	host_lock();
+	user_init();
+	host_unlock();
+
+	sigwait(&sigs, &sig);
+	return 0;
+	}
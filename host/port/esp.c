@@ -0,0 +1,372 @@
+/*
+* xPL for ESP8266
+*
+* Host build: system, Wi-Fi, software timer and GPIO calls of the ESP8266 SDK
+*
+* The station connects 10 ms after it is asked to, or fails then if host_wifi_link() took the AP away.
+* The GPIO registers are plain variables, host_gpio_input() changes the inputs
+* and raises the GPIO interrupt like the pins would.
+* The FRC1 timer is not emulated, build without DIMMER.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "host.h"
+
+#define HOST_HEAP_SIZE		40000			// Reported free heap, about what the firmware has left
+#define HOST_RTC_BLOCKS		192				// RTC memory, in 4 byte blocks
+#define HOST_PARAM_SLOTS	8				// Flash sectors the firmware saves its settings in
+#define HOST_CONNECT_US		10000			// Association and DHCP
+
+static struct rst_info reset_info = { REASON_DEFAULT_RST };
+static uint16 adc_value;
+static uint32 rtc_mem[HOST_RTC_BLOCKS];
+
+static struct {
+	uint16 sector;
+	uint16 len;
+	unsigned char data[4096];
+	} params[HOST_PARAM_SLOTS];
+
+void *zalloc(size_t size) {
+	return calloc(1, size);
+	}
+
+// System
+
+struct rst_info *system_get_rst_info(void) {
+	return &reset_info;
+	}
+
+uint32 system_get_time(void) {
+	return (uint32)host_time_us();
+	}
+
+uint32 system_get_free_heap_size(void) {
+	return HOST_HEAP_SIZE;
+	}
+
+void host_set_adc(uint16 value) {
+	adc_value = value;
+	}
+
+uint16 system_adc_read(void) {
+	return adc_value;
+	}
+
+// There is nothing to wake us up again
+void system_deep_sleep(uint32 time_in_us) {
+	printf("Deep sleep for %u us, exiting\n", time_in_us);
+	exit(0);
+	}
+
+bool system_rtc_mem_read(uint8 src_addr, void *des_addr, uint16 save_size) {
+	if (src_addr * 4 + save_size > sizeof(rtc_mem)) return false;
+	memcpy(des_addr, (char *)rtc_mem + src_addr * 4, save_size);
+	return true;
+	}
+
+bool system_rtc_mem_write(uint8 des_addr, const void *src_addr, uint16 save_size) {
+	if (des_addr * 4 + save_size > sizeof(rtc_mem)) return false;
+	memcpy((char *)rtc_mem + des_addr * 4, src_addr, save_size);
+	return true;
+	}
+
+// Parameter sectors only live as long as the process
+bool system_param_save_with_protect(uint16 start_sec, void *param, uint16 len) {
+	int i;
+
+	if (len > sizeof(params[0].data)) return false;
+	for (i = 0; i < HOST_PARAM_SLOTS; i++) {
+		if (params[i].len == 0 || params[i].sector == start_sec) {
+			params[i].sector = start_sec;
+			params[i].len = len;
+			memcpy(params[i].data, param, len);
+			return true;
+			}
+		}
+	return false;
+	}
+
+// Erased flash reads back as all ones
+bool system_param_load(uint16 start_sec, uint16 offset, void *param, uint16 len) {
+	int i;
+
+	memset(param, 0xff, len);
+	if (offset + len > sizeof(params[0].data)) return false;
+	for (i = 0; i < HOST_PARAM_SLOTS; i++) {
+		if (params[i].len != 0 && params[i].sector == start_sec) {
+			memcpy(param, params[i].data + offset, len);
+			break;
+			}
+		}
+	return true;
+	}
+
+// Wi-Fi
+
+static struct station_config station;
+static uint8 station_status = STATION_IDLE;
+static uint8 channel = 1;
+static bool ap_up = true;
+static wifi_event_handler_cb_t event_cb;
+
+static void wifi_event(uint32 id) {
+	System_Event_t event;
+
+	event.event_id = id;
+	if (event_cb != NULL) event_cb(&event);
+	}
+
+// The SDK reports the link from its own task, so do we
+static void wifi_connect_thread(void *arg) {
+	host_sleep_until(host_time_us() + HOST_CONNECT_US);
+	if (station_status != STATION_CONNECTING) return;		// Cancelled
+
+	if (!ap_up) {
+		station_status = STATION_NO_AP_FOUND;
+		wifi_event(EVENT_STAMODE_DISCONNECTED);
+		return;
+		}
+
+	station_status = STATION_GOT_IP;
+	wifi_event(EVENT_STAMODE_CONNECTED);
+	wifi_event(EVENT_STAMODE_GOT_IP);
+	}
+
+// Take the AP away, or bring it back. Connect attempts fail while it is away.
+void host_wifi_link(bool up) {
+	ap_up = up;
+	if (!up && station_status == STATION_GOT_IP) {
+		station_status = STATION_IDLE;
+		wifi_event(EVENT_STAMODE_DISCONNECTED);
+		}
+	}
+
+bool wifi_set_opmode(uint8 mode) {
+	return true;
+	}
+
+bool wifi_station_set_config(struct station_config *config) {
+	station = *config;
+	return true;
+	}
+
+bool wifi_station_get_config(struct station_config *config) {
+	*config = station;
+	return true;
+	}
+
+bool wifi_station_connect(void) {
+	if (station_status == STATION_CONNECTING) return true;
+	station_status = STATION_CONNECTING;
+	host_thread(wifi_connect_thread, NULL, NULL, 0);
+	return true;
+	}
+
+bool wifi_station_disconnect(void) {
+	station_status = STATION_IDLE;
+	wifi_event(EVENT_STAMODE_DISCONNECTED);
+	return true;
+	}
+
+uint8 wifi_station_get_connect_status(void) {
+	return station_status;
+	}
+
+bool wifi_station_dhcpc_start(void) {
+	return true;
+	}
+
+bool wifi_station_dhcpc_stop(void) {
+	return true;
+	}
+
+bool wifi_get_ip_info(uint8 if_index, struct ip_info *info) {
+	memset(info, 0, sizeof(*info));
+	if (station_status == STATION_GOT_IP) info->ip.addr = host_options.ip_addr;
+	return true;
+	}
+
+bool wifi_set_ip_info(uint8 if_index, struct ip_info *info) {
+	return true;
+	}
+
+bool wifi_set_channel(uint8 _channel) {
+	channel = _channel;
+	return true;
+	}
+
+uint8 wifi_get_channel(void) {
+	return channel;
+	}
+
+void wifi_set_event_handler_cb(wifi_event_handler_cb_t cb) {
+	event_cb = cb;
+	}
+
+// Software timers, all run from one thread, in expiry order
+
+static os_timer_t *timers;
+static struct host_wait timer_wait;
+static unsigned char timer_started;
+
+static void timer_insert(os_timer_t *timer) {
+	os_timer_t **p = &timers;
+
+	while (*p != NULL && (sint32)((*p)->expire - timer->expire) <= 0) p = &(*p)->next;
+	timer->next = *p;
+	*p = timer;
+	}
+
+static void timer_thread(void *arg) {
+	os_timer_t *timer;
+	uint32 now;
+
+	for (;;) {
+		if (timers == NULL) {
+			host_wait(&timer_wait, 0);
+			continue;
+			}
+
+		now = host_time_us() / 1000;
+		if ((sint32)(timers->expire - now) > 0) {
+			host_wait(&timer_wait, (uint64)timers->expire * 1000);
+			continue;
+			}
+
+		timer = timers;
+		timers = timer->next;
+		timer->next = NULL;
+		if (timer->period) {
+			timer->expire += timer->period;
+			timer_insert(timer);
+			}
+		timer->func(timer->arg);
+		}
+	}
+
+void os_timer_setfn(os_timer_t *timer, os_timer_func_t *func, void *arg) {
+	os_timer_disarm(timer);
+	timer->func = func;
+	timer->arg = arg;
+	}
+
+void os_timer_arm(os_timer_t *timer, uint32 ms, bool repeat) {
+	if (!timer_started) {
+		timer_started = 1;
+		host_wait_init(&timer_wait);
+		host_thread(timer_thread, NULL, NULL, 0);
+		}
+
+	os_timer_disarm(timer);
+	timer->period = repeat ? (ms ? ms : 1) : 0;
+	timer->expire = host_time_us() / 1000 + ms;
+	timer_insert(timer);
+	host_wake(&timer_wait);
+	}
+
+void os_timer_disarm(os_timer_t *timer) {
+	os_timer_t **p = &timers;
+
+	while (*p != NULL && *p != timer) p = &(*p)->next;
+	if (*p != NULL) *p = timer->next;
+	timer->next = NULL;
+	}
+
+// Interrupts
+
+static struct {
+	_xt_isr func;
+	void *arg;
+	} isrs[16];
+static uint32 isr_mask;
+
+void _xt_isr_attach(uint8 i, _xt_isr func, void *arg) {
+	isrs[i].func = func;
+	isrs[i].arg = arg;
+	}
+
+void _xt_isr_unmask(uint32 unmask) {
+	isr_mask |= unmask;
+	}
+
+void _xt_isr_mask(uint32 mask) {
+	isr_mask &= ~mask;
+	}
+
+// GPIO
+
+static uint32 gpio_regs[16] = { [GPIO_IN_ADDRESS / 4] = 0xffff };		// Pull ups, all inputs high
+static GPIO_INT_TYPE gpio_intr[16];
+
+uint32 host_gpio_reg_read(uint32 reg) {
+	return gpio_regs[reg / 4];
+	}
+
+void host_gpio_reg_write(uint32 reg, uint32 val) {
+	switch (reg) {
+		case GPIO_OUT_W1TS_ADDRESS: gpio_regs[GPIO_OUT_ADDRESS / 4] |= val; break;
+		case GPIO_OUT_W1TC_ADDRESS: gpio_regs[GPIO_OUT_ADDRESS / 4] &= ~val; break;
+		case GPIO_STATUS_W1TC_ADDRESS: gpio_regs[GPIO_STATUS_ADDRESS / 4] &= ~val; break;
+		default: gpio_regs[reg / 4] = val; break;
+		}
+	}
+
+void gpio_output_set(uint32 set_mask, uint32 clear_mask, uint32 enable_mask, uint32 disable_mask) {
+	gpio_regs[GPIO_OUT_ADDRESS / 4] = (gpio_regs[GPIO_OUT_ADDRESS / 4] | set_mask) & ~clear_mask;
+	gpio_regs[GPIO_ENABLE_ADDRESS / 4] = (gpio_regs[GPIO_ENABLE_ADDRESS / 4] | enable_mask) & ~disable_mask;
+	}
+
+uint32 gpio_input_get(void) {
+	return gpio_regs[GPIO_IN_ADDRESS / 4];
+	}
+
+void gpio_pin_intr_state_set(uint32 i, GPIO_INT_TYPE intr_state) {
+	if (i < 16) gpio_intr[i] = intr_state;
+	}
+
+// Drive the inputs in mask to level, and raise the GPIO interrupt for the pins set to fire on the change.
+// Call with the big lock held.
+void host_gpio_input(uint32 mask, uint32 level) {
+	uint32 old = gpio_regs[GPIO_IN_ADDRESS / 4];
+	uint32 now = (old & ~mask) | (level & mask);
+	uint32 fired = 0;
+	int i;
+
+	gpio_regs[GPIO_IN_ADDRESS / 4] = now;
+	for (i = 0; i < 16; i++) {
+		uint32 bit = 1UL << i;
+
+		switch (gpio_intr[i]) {
+			case GPIO_PIN_INTR_POSEDGE: if ((now & ~old) & bit) fired |= bit; break;
+			case GPIO_PIN_INTR_NEGEDGE: if ((old & ~now) & bit) fired |= bit; break;
+			case GPIO_PIN_INTR_ANYEDGE: if ((old ^ now) & bit) fired |= bit; break;
+			case GPIO_PIN_INTR_LOLEVEL: if (~now & bit) fired |= bit; break;
+			case GPIO_PIN_INTR_HILEVEL: if (now & bit) fired |= bit; break;
+			default: break;
+			}
+		}
+
+	gpio_regs[GPIO_STATUS_ADDRESS / 4] |= fired;
+	if (fired && (isr_mask & (1 << ETS_GPIO_INUM)) && isrs[ETS_GPIO_INUM].func != NULL)
+		isrs[ETS_GPIO_INUM].func(isrs[ETS_GPIO_INUM].arg);
+	}
+
+// Only the FRC1 timer goes through here
+void host_rtc_reg_write(uint32 reg, uint32 val) {
+	}
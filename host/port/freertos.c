@@ -0,0 +1,209 @@
+/*
+* xPL for ESP8266
+*
+* Host build: FreeRTOS tasks, queues and ticks on the host threads and clock
+*
+* Tasks run on their own stack, filled with a pattern so the high water mark can be measured.
+* The numbers are host ones, much larger than on the ESP8266, but they still show which task grows.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "host.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+#define HOST_STACK_MIN		(64 * 1024)		// Bytes, printf and friends need a lot more than on the chip
+#define HOST_STACK_FILL		0xa5
+
+struct host_task {
+	const char *name;
+	pdTASK_CODE code;
+	void *param;
+	unsigned char *stack;
+	size_t size;
+	};
+
+struct host_queue {
+	struct host_wait wait;				// Woken on every send and receive
+	unsigned long len;
+	unsigned long item;
+	unsigned long head;
+	unsigned long count;
+	char data[];
+	};
+
+static __thread struct host_task *current;
+
+struct host_ram host_ram;
+
+// Deadline for a wait of ticks, 0 for portMAX_DELAY
+uint64 host_tick_deadline(portTickType ticks) {
+	if (ticks == portMAX_DELAY) return 0;
+	return host_time_us() + (uint64)ticks * portTICK_RATE_MS * 1000 + 1;
+	}
+
+void host_sleep_until(uint64 deadline_us) {
+	struct host_wait wait;
+
+	host_wait_init(&wait);
+	while (host_wait(&wait, deadline_us))
+		;
+	}
+
+// Tasks
+
+static void task_start(void *arg) {
+	current = arg;
+	current->code(current->param);
+	}
+
+portBASE_TYPE xTaskCreate(pdTASK_CODE code, const char *name, unsigned short stack, void *param, unsigned long prio, xTaskHandle *handle) {
+	struct host_task *task = calloc(1, sizeof(*task));
+
+	if (task == NULL) return pdFAIL;
+	task->name = name;
+	task->code = code;
+	task->param = param;
+	task->size = HOST_STACK_MIN + stack * 4 * 8;			// FreeRTOS stacks are in words
+	if ((task->stack = malloc(task->size)) == NULL) {
+		free(task);
+		return pdFAIL;
+		}
+	memset(task->stack, HOST_STACK_FILL, task->size);
+
+	host_thread(task_start, task, task->stack, task->size);
+	host_ram.tasks++;
+	host_ram.stack += stack * 4;
+
+	if (handle != NULL) *handle = task;
+	return pdPASS;
+	}
+
+// Only a task deleting itself is supported. Its stack is not freed, the thread is still on it.
+void vTaskDelete(xTaskHandle task) {
+	host_thread_exit();
+	}
+
+void vTaskDelay(portTickType ticks) {
+	host_sleep_until(host_tick_deadline(ticks));
+	}
+
+void vTaskDelayUntil(portTickType *prev, portTickType inc) {
+	uint64 deadline;
+
+	*prev += inc;
+	deadline = (uint64)*prev * portTICK_RATE_MS * 1000;
+	if (deadline > host_time_us()) host_sleep_until(deadline);
+	}
+
+portTickType xTaskGetTickCount(void) {
+	return host_time_us() / (portTICK_RATE_MS * 1000);
+	}
+
+// Untouched stack, in words
+unsigned long uxTaskGetStackHighWaterMark(xTaskHandle handle) {
+	struct host_task *task = handle != NULL ? handle : current;
+	size_t i = 0;
+
+	if (task == NULL) return 0;
+	while (i < task->size && task->stack[i] == HOST_STACK_FILL) i++;
+	return i / 4;
+	}
+
+xTaskHandle xTaskGetCurrentTaskHandle(void) {
+	return current;
+	}
+
+// We already hold the big lock
+void vPortEnterCritical(void) {
+	}
+
+void vPortExitCritical(void) {
+	}
+
+// Queues
+
+xQueueHandle xQueueCreate(unsigned long len, unsigned long item) {
+	struct host_queue *queue = calloc(1, sizeof(*queue) + len * item);
+
+	if (queue == NULL) return NULL;
+	host_wait_init(&queue->wait);
+	queue->len = len;
+	queue->item = item;
+	host_ram.queues++;
+	host_ram.queue += len * item;
+	return queue;
+	}
+
+portBASE_TYPE xQueueSendToBack(xQueueHandle queue, const void *item, portTickType wait) {
+	uint64 deadline = host_tick_deadline(wait);
+
+	while (queue->count == queue->len) {
+		if (wait == 0 || !host_wait(&queue->wait, deadline)) return errQUEUE_FULL;
+		}
+
+	if (item != NULL) memcpy(queue->data + (queue->head + queue->count) % queue->len * queue->item, item, queue->item);
+	queue->count++;
+	host_wake(&queue->wait);
+	return pdTRUE;
+	}
+
+portBASE_TYPE xQueueSendFromISR(xQueueHandle queue, const void *item, portBASE_TYPE *woken) {
+	if (woken != NULL) *woken = pdFALSE;
+	return xQueueSendToBack(queue, item, 0);
+	}
+
+portBASE_TYPE xQueueReceive(xQueueHandle queue, void *item, portTickType wait) {
+	uint64 deadline = host_tick_deadline(wait);
+
+	while (queue->count == 0) {
+		if (wait == 0 || !host_wait(&queue->wait, deadline)) return pdFALSE;
+		}
+
+	if (item != NULL) memcpy(item, queue->data + queue->head * queue->item, queue->item);
+	queue->head = (queue->head + 1) % queue->len;
+	queue->count--;
+	host_wake(&queue->wait);
+	return pdTRUE;
+	}
+
+unsigned long uxQueueMessagesWaiting(xQueueHandle queue) {
+	return queue->count;
+	}
+
+// Binary semaphores, a full queue of one empty item is a given semaphore
+
+xSemaphoreHandle host_sem_create(void) {
+	xSemaphoreHandle sem = xQueueCreate(1, 0);
+
+	if (sem != NULL) sem->count = 1;
+	return sem;
+	}
+
+portBASE_TYPE xSemaphoreTake(xSemaphoreHandle sem, portTickType wait) {
+	return xQueueReceive(sem, NULL, wait);
+	}
+
+portBASE_TYPE xSemaphoreGive(xSemaphoreHandle sem) {
+	return xQueueSendToBack(sem, NULL, 0);
+	}
+
+portBASE_TYPE xSemaphoreGiveFromISR(xSemaphoreHandle sem, portBASE_TYPE *woken) {
+	return xQueueSendFromISR(sem, NULL, woken);
+	}
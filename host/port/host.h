@@ -0,0 +1,89 @@
+/*
+* xPL for ESP8266
+*
+* Host build: shared state of the port layer
+*
+* The firmware expects a single core: only one task runs at a time and an interrupt
+* is never interrupted. Each task is a thread, and only one thread runs firmware code at a time.
+* It hands over only when it blocks in host_wait().
+*
+* thread.c does this in real time, the threads take turns on one big lock.
+* sim.c does it in virtual time, see there.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef host_h
+#define host_h
+
+#include <pthread.h>
+#include "esp_common.h"
+#include "freertos/FreeRTOS.h"
+
+// Something threads wait on, like a condition variable
+struct host_wait {
+	pthread_cond_t cond;
+	};
+
+typedef void (*host_thread_fn)(void *arg);
+
+uint64 host_time_us(void);
+
+// Start fn on its own thread, on stack if not NULL. Returning from fn ends the thread.
+void host_thread(host_thread_fn fn, void *arg, void *stack, size_t size);
+void host_thread_exit(void) __attribute__((noreturn));
+
+// Block until woken or until deadline_us, 0 to wait forever. Returns 0 on timeout.
+// Wake ups can be spurious, callers check their condition again.
+void host_wait_init(struct host_wait *wait);
+int host_wait(struct host_wait *wait, uint64 deadline_us);
+void host_wake(struct host_wait *wait);
+
+// Real time only, for the threads that block outside of host_wait()
+void host_lock(void);
+void host_unlock(void);
+
+// In freertos.c
+void host_sleep_until(uint64 deadline_us);
+uint64 host_tick_deadline(portTickType ticks);
+
+// What the firmware asked of FreeRTOS, in ESP8266 bytes, to compare builds
+struct host_ram {
+	unsigned tasks;
+	unsigned long stack;				// Task stacks
+	unsigned queues;					// Queues and semaphores
+	unsigned long queue;				// Queue items
+	};
+
+extern struct host_ram host_ram;
+
+// Set up by main() from the command line, or by the simulation
+struct host_options {
+	uint16 listen_port;					// Replaces the port the firmware binds to, 0 to keep it
+	uint32 send_addr;					// Destination of all sends, network order, 0 for the firmware's own
+	uint16 send_port;
+	uint32 ip_addr;						// Address reported by wifi_get_ip_info, network order
+	};
+
+extern struct host_options host_options;
+
+// In esp.c
+void host_gpio_input(uint32 mask, uint32 level);
+void host_set_adc(uint16 value);
+void host_wifi_link(bool up);
+
+#endif
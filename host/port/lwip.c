@@ -0,0 +1,153 @@
+/*
+* xPL for ESP8266
+*
+* Host build: lwIP raw UDP calls on top of sockets
+*
+* A bound pcb gets its own socket and a thread that hands each datagram to the receive
+* callback, with the big lock held like the lwIP task would. Sends from unbound pcbs,
+* which is what udpio_send() uses, all go out through one shared socket.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "host.h"
+#include "lwip/udp.h"
+
+#define HOST_UDP_MAX		1500
+
+struct udp_pcb {
+	int fd;
+	udp_recv_fn recv;
+	void *arg;
+	unsigned char receiving;
+	};
+
+const struct ip_addr ip_addr_any = { 0x00000000 };
+const struct ip_addr ip_addr_broadcast = { 0xffffffff };
+
+static int send_fd = -1;
+
+// Sockets
+
+static int udp_socket(void) {
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	int on = 1;
+
+	if (fd < 0) return -1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+	setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+	return fd;
+	}
+
+// Started with the lock held, and only gives it up while waiting on the socket
+static void udp_recv_thread(void *arg) {
+	struct udp_pcb *pcb = arg;
+	char buf[HOST_UDP_MAX];
+	struct sockaddr_in from;
+	socklen_t fromlen;
+	struct ip_addr addr;
+	struct pbuf *p;
+	ssize_t len;
+
+	for (;;) {
+		fromlen = sizeof(from);
+		host_unlock();
+		len = recvfrom(pcb->fd, buf, sizeof(buf), 0, (struct sockaddr *)&from, &fromlen);
+		host_lock();
+		if (len < 0) {
+			if (errno == EINTR) continue;
+			perror("recvfrom");
+			return;
+			}
+
+		if ((p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM)) != NULL) {
+			memcpy(p->payload, buf, len);
+			addr.addr = from.sin_addr.s_addr;
+			pcb->recv(pcb->arg, pcb, p, &addr, ntohs(from.sin_port));
+			}
+		}
+	}
+
+static void udp_start(struct udp_pcb *pcb) {
+	if (pcb->fd >= 0 && pcb->recv != NULL && !pcb->receiving) {
+		pcb->receiving = 1;
+		host_thread(udp_recv_thread, pcb, NULL, 0);
+		}
+	}
+
+struct udp_pcb *udp_new(void) {
+	struct udp_pcb *pcb = calloc(1, sizeof(*pcb));
+
+	if (pcb != NULL) pcb->fd = -1;
+	return pcb;
+	}
+
+// Receiving pcbs are never removed by the firmware, their thread would still be using them
+void udp_remove(struct udp_pcb *pcb) {
+	if (pcb->receiving) return;
+	if (pcb->fd >= 0) close(pcb->fd);
+	free(pcb);
+	}
+
+err_t udp_bind(struct udp_pcb *pcb, struct ip_addr *addr, u16_t port) {
+	struct sockaddr_in sin;
+
+	if (pcb->fd >= 0) return ERR_USE;
+	if ((pcb->fd = udp_socket()) < 0) return ERR_MEM;
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = addr != NULL ? addr->addr : 0;
+	sin.sin_port = htons(host_options.listen_port ? host_options.listen_port : port);
+	if (bind(pcb->fd, (struct sockaddr *)&sin, sizeof(sin)) < 0) {
+		perror("bind");
+		close(pcb->fd);
+		pcb->fd = -1;
+		return ERR_USE;
+		}
+
+	udp_start(pcb);
+	return ERR_OK;
+	}
+
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *arg) {
+	pcb->recv = recv;
+	pcb->arg = arg;
+	udp_start(pcb);
+	}
+
+err_t udp_sendto(struct udp_pcb *pcb, struct pbuf *p, struct ip_addr *addr, u16_t port) {
+	struct sockaddr_in sin;
+	int fd = pcb->fd;
+
+	if (fd < 0) {
+		if (send_fd < 0 && (send_fd = udp_socket()) < 0) return ERR_MEM;
+		fd = send_fd;
+		}
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = host_options.send_addr ? host_options.send_addr : addr->addr;
+	sin.sin_port = htons(host_options.send_port ? host_options.send_port : port);
+	if (sendto(fd, p->payload, p->len, 0, (struct sockaddr *)&sin, sizeof(sin)) < 0) return ERR_BUF;
+	return ERR_OK;
+	}
@@ -0,0 +1,46 @@
+/*
+* xPL for ESP8266
+*
+* Host build: lwIP packet buffers, always in one piece
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "host.h"
+#include "lwip/pbuf.h"
+
+struct pbuf *pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type) {
+	struct pbuf *p = malloc(sizeof(*p) + length);
+
+	if (p == NULL) return NULL;
+	p->next = NULL;
+	p->payload = p + 1;
+	p->tot_len = p->len = length;
+	return p;
+	}
+
+u8_t pbuf_free(struct pbuf *p) {
+	free(p);
+	return 1;
+	}
+
+u16_t pbuf_copy_partial(struct pbuf *p, void *dataptr, u16_t len, u16_t offset) {
+	if (offset >= p->len) return 0;
+	if (len > p->len - offset) len = p->len - offset;
+	memcpy(dataptr, (char *)p->payload + offset, len);
+	return len;
+	}
@@ -0,0 +1,260 @@
+/*
+* xPL for ESP8266
+*
+* Host build: firmware threads in virtual time
+*
+* Replaces thread.c for the scenario tests. Each firmware thread is still a pthread, for its stack,
+* but only the one the scheduler picked runs, and it runs until it blocks in host_wait().
+* The next one is picked in creation order. When none can run, the clock jumps straight
+* to the next deadline or scheduled event, so a minute of heartbeats takes no time at all.
+*
+* Events scheduled with sim_at() run at their time, before any thread, like interrupts.
+* Events due at the same time run in the order they were scheduled.
+* The same scenario always gives the same timeline, down to the microsecond.
+*
+* The test program itself is the first thread, and lets the others run in sim_run().
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "sim.h"
+
+struct sim_thread {
+	struct sim_thread *next;			// All threads, in creation order
+	pthread_cond_t go;					// Signaled when the thread gets to run
+	host_thread_fn fn;
+	void *arg;
+	struct host_wait *waiting;
+	uint64 deadline;					// 0 when waiting forever
+	unsigned char blocked;
+	unsigned char woken;				// Woken by host_wake(), as opposed to the deadline
+	unsigned char done;
+	};
+
+struct sim_event {
+	struct sim_event *next;
+	uint64 time;
+	sim_fn fn;
+	void *arg;
+	};
+
+struct host_options host_options;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct sim_thread *threads, **threads_tail = &threads;
+static struct sim_thread *running;
+static __thread struct sim_thread *self;
+static struct sim_event *events;
+static uint64 now;
+
+uint64 host_time_us(void) {
+	return now;
+	}
+
+uint64 sim_now(void) {
+	return now;
+	}
+
+void sim_at(uint64 time, sim_fn fn, void *arg) {
+	struct sim_event *event = malloc(sizeof(*event)), **p = &events;
+
+	if (event == NULL) {
+		perror("malloc");
+		exit(1);
+		}
+	event->time = time < now ? now : time;
+	event->fn = fn;
+	event->arg = arg;
+
+	while (*p != NULL && (*p)->time <= event->time) p = &(*p)->next;
+	event->next = *p;
+	*p = event;
+	}
+
+// Nothing can run, move the clock on to whatever comes next, and run what is due then
+static void sim_advance(void) {
+	struct sim_thread *thread;
+	struct sim_event *event;
+	uint64 next = events != NULL ? events->time : 0;
+
+	for (thread = threads; thread != NULL; thread = thread->next) {
+		if (thread->blocked && thread->deadline && (next == 0 || thread->deadline < next)) next = thread->deadline;
+		}
+
+	if (next == 0) {
+		fprintf(stderr, "sim: every thread waits forever\n");
+		abort();
+		}
+	if (next > now) now = next;
+
+	while (events != NULL && events->time <= now) {
+		event = events;
+		events = event->next;
+		event->fn(event->arg);
+		free(event);
+		}
+
+	for (thread = threads; thread != NULL; thread = thread->next) {
+		if (thread->blocked && thread->deadline && thread->deadline <= now) {
+			thread->blocked = 0;
+			thread->woken = 0;
+			}
+		}
+	}
+
+// Next thread that can run, starting after the current one
+static struct sim_thread *sim_pick(void) {
+	struct sim_thread *thread = self;
+
+	do {
+		thread = thread->next != NULL ? thread->next : threads;
+		if (!thread->blocked && !thread->done) return thread;
+		} while (thread != self);
+
+	return NULL;
+	}
+
+// Hand over to the next thread and wait for our turn, unless we are done
+static void sim_switch(void) {
+	struct sim_thread *next;
+
+	while ((next = sim_pick()) == NULL) sim_advance();
+	if (next == self) return;
+
+	running = next;
+	pthread_cond_signal(&next->go);
+	if (self->done) return;
+
+	while (running != self) pthread_cond_wait(&self->go, &lock);
+	}
+
+void host_wait_init(struct host_wait *wait) {
+	}
+
+int host_wait(struct host_wait *wait, uint64 deadline_us) {
+	self->waiting = wait;
+	self->deadline = deadline_us;
+	self->blocked = 1;
+	self->woken = 0;
+	sim_switch();
+	self->waiting = NULL;
+	return self->woken;
+	}
+
+void host_wake(struct host_wait *wait) {
+	struct sim_thread *thread;
+
+	for (thread = threads; thread != NULL; thread = thread->next) {
+		if (thread->blocked && thread->waiting == wait) {
+			thread->blocked = 0;
+			thread->woken = 1;
+			}
+		}
+	}
+
+static struct sim_thread *sim_thread_new(void) {
+	struct sim_thread *thread = calloc(1, sizeof(*thread));
+
+	if (thread == NULL) {
+		perror("calloc");
+		exit(1);
+		}
+	pthread_cond_init(&thread->go, NULL);
+	*threads_tail = thread;
+	threads_tail = &thread->next;
+	return thread;
+	}
+
+static void *sim_thread_start(void *arg) {
+	pthread_mutex_lock(&lock);
+	self = arg;
+	while (running != self) pthread_cond_wait(&self->go, &lock);
+
+	self->fn(self->arg);
+	host_thread_exit();
+	}
+
+// The new thread waits for its turn, it does not run straight away
+void host_thread(host_thread_fn fn, void *arg, void *stack, size_t size) {
+	struct sim_thread *thread = sim_thread_new();
+	pthread_t id;
+	pthread_attr_t attr;
+
+	thread->fn = fn;
+	thread->arg = arg;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if (stack != NULL) pthread_attr_setstack(&attr, stack, size);
+	if (pthread_create(&id, &attr, sim_thread_start, thread) != 0) {
+		perror("pthread_create");
+		exit(1);
+		}
+	pthread_attr_destroy(&attr);
+	}
+
+void host_thread_exit(void) {
+	self->done = 1;
+	sim_switch();
+	pthread_mutex_unlock(&lock);
+	pthread_exit(NULL);
+	}
+
+// Nothing blocks outside of host_wait() in the simulation
+void host_lock(void) {
+	}
+
+void host_unlock(void) {
+	}
+
+// Make the calling thread, the test program, the first simulated thread
+void sim_init(void) {
+	pthread_mutex_lock(&lock);
+	self = running = sim_thread_new();
+	host_options.ip_addr = 0x0100007f;			// 127.0.0.1
+	}
+
+// Let the firmware run until time
+void sim_run_until(uint64 time) {
+	host_sleep_until(time);
+	}
+
+void sim_run(uint64 duration) {
+	sim_run_until(now + duration);
+	}
+
+// Inputs, as seen by the GPIO registers
+
+struct sim_gpio {
+	uint32 mask;
+	uint32 level;
+	};
+
+static void sim_gpio_event(void *arg) {
+	struct sim_gpio *gpio = arg;
+
+	host_gpio_input(gpio->mask, gpio->level);
+	free(gpio);
+	}
+
+void sim_gpio(uint64 time, uint32 mask, uint32 level) {
+	struct sim_gpio *gpio = malloc(sizeof(*gpio));
+
+	gpio->mask = mask;
+	gpio->level = level;
+	sim_at(time, sim_gpio_event, gpio);
+	}
@@ -0,0 +1,53 @@
+/*
+* xPL for ESP8266
+*
+* Host build: deterministic simulation, for the scenario tests
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef sim_h
+#define sim_h
+
+#include "host.h"
+
+#define SIM_MS		1000ULL				// Virtual time is in us
+#define SIM_S		1000000ULL
+
+typedef void (*sim_fn)(void *arg);
+
+// A packet the device sent
+struct sim_packet {
+	uint64 time;
+	char *data;							// Null terminated
+	u16_t len;
+	};
+
+void sim_init(void);
+uint64 sim_now(void);
+void sim_run_until(uint64 time);
+void sim_run(uint64 duration);
+void sim_at(uint64 time, sim_fn fn, void *arg);
+void sim_gpio(uint64 time, uint32 mask, uint32 level);
+
+// In simnet.c
+void sim_inject(uint64 time, const char *msg);
+void sim_on_send(void (*hook)(const struct sim_packet *packet));
+unsigned sim_sent_count(void);
+const struct sim_packet *sim_sent(unsigned i);
+
+#endif
@@ -0,0 +1,115 @@
+/*
+* xPL for ESP8266
+*
+* Host build: lwIP raw UDP calls for the simulation
+*
+* Replaces lwip.c. What the device sends goes into a log, with the time it was sent.
+* What the scenario injects is handed to the receive callback at the set time,
+* the way lwIP would call it. The network itself takes no time.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "sim.h"
+#include "lwip/udp.h"
+
+struct udp_pcb {
+	udp_recv_fn recv;
+	void *arg;
+	u16_t port;
+	};
+
+const struct ip_addr ip_addr_any = { 0x00000000 };
+const struct ip_addr ip_addr_broadcast = { 0xffffffff };
+
+static struct udp_pcb *listener;
+static struct sim_packet *sent;
+static unsigned sent_count, sent_max;
+static void (*send_hook)(const struct sim_packet *packet);
+
+struct udp_pcb *udp_new(void) {
+	return calloc(1, sizeof(struct udp_pcb));
+	}
+
+void udp_remove(struct udp_pcb *pcb) {
+	if (pcb == listener) listener = NULL;
+	free(pcb);
+	}
+
+err_t udp_bind(struct udp_pcb *pcb, struct ip_addr *addr, u16_t port) {
+	pcb->port = port;
+	listener = pcb;
+	return ERR_OK;
+	}
+
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *arg) {
+	pcb->recv = recv;
+	pcb->arg = arg;
+	}
+
+err_t udp_sendto(struct udp_pcb *pcb, struct pbuf *p, struct ip_addr *addr, u16_t port) {
+	struct sim_packet *packet;
+
+	if (sent_count == sent_max) {
+		sent_max = sent_max ? sent_max * 2 : 256;
+		if ((sent = realloc(sent, sent_max * sizeof(*sent))) == NULL) {
+			perror("realloc");
+			exit(1);
+			}
+		}
+
+	packet = &sent[sent_count++];
+	packet->time = sim_now();
+	packet->len = p->len;
+	packet->data = malloc(p->len + 1);
+	memcpy(packet->data, p->payload, p->len);
+	packet->data[p->len] = '\0';
+
+	if (send_hook != NULL) send_hook(packet);
+	return ERR_OK;
+	}
+
+// Called for each packet the device sends, as it sends it
+void sim_on_send(void (*hook)(const struct sim_packet *packet)) {
+	send_hook = hook;
+	}
+
+unsigned sim_sent_count(void) {
+	return sent_count;
+	}
+
+const struct sim_packet *sim_sent(unsigned i) {
+	return i < sent_count ? &sent[i] : NULL;
+	}
+
+static void sim_deliver(void *arg) {
+	char *msg = arg;
+	struct ip_addr from = { 0x0200007f };			// 127.0.0.2
+	u16_t len = strlen(msg);
+	struct pbuf *p;
+
+	if (listener != NULL && listener->recv != NULL && (p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM)) != NULL) {
+		memcpy(p->payload, msg, len);
+		listener->recv(listener->arg, listener, p, &from, 3865);
+		}
+	free(msg);
+	}
+
+// Have msg arrive at time. Dropped if the device is not listening yet.
+void sim_inject(uint64 time, const char *msg) {
+	sim_at(time, sim_deliver, strdup(msg));
+	}
@@ -0,0 +1,122 @@
+/*
+* xPL for ESP8266
+*
+* Host build: firmware threads in real time
+*
+* The threads take turns on one big lock, held whenever firmware code runs.
+* host_wait() gives it up while blocked, and the monotonic clock gives the time.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <errno.h>
+#include <time.h>
+#include "host.h"
+
+struct host_thread {
+	host_thread_fn fn;
+	void *arg;
+	};
+
+static pthread_mutex_t big_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64 boot_us;
+
+void host_lock(void) {
+	pthread_mutex_lock(&big_lock);
+	}
+
+void host_unlock(void) {
+	pthread_mutex_unlock(&big_lock);
+	}
+
+static uint64 host_clock_us(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+	}
+
+uint64 host_time_us(void) {
+	return host_clock_us() - boot_us;
+	}
+
+static void __attribute__((constructor)) host_clock_init(void) {
+	boot_us = host_clock_us();
+	}
+
+void host_wait_init(struct host_wait *wait) {
+	pthread_condattr_t attr;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&wait->cond, &attr);
+	pthread_condattr_destroy(&attr);
+	}
+
+int host_wait(struct host_wait *wait, uint64 deadline_us) {
+	struct timespec ts;
+
+	if (deadline_us == 0) {
+		pthread_cond_wait(&wait->cond, &big_lock);
+		return 1;
+		}
+
+	deadline_us += boot_us;
+	ts.tv_sec = deadline_us / 1000000;
+	ts.tv_nsec = (deadline_us % 1000000) * 1000;
+	return pthread_cond_timedwait(&wait->cond, &big_lock, &ts) != ETIMEDOUT;
+	}
+
+void host_wake(struct host_wait *wait) {
+	pthread_cond_broadcast(&wait->cond);
+	}
+
+static void *host_thread_start(void *arg) {
+	struct host_thread thread = *(struct host_thread *)arg;
+
+	free(arg);
+	host_lock();
+	thread.fn(thread.arg);
+	host_thread_exit();
+	}
+
+void host_thread(host_thread_fn fn, void *arg, void *stack, size_t size) {
+	struct host_thread *thread = malloc(sizeof(*thread));
+	pthread_t id;
+	pthread_attr_t attr;
+
+	if (thread == NULL) {
+		perror("malloc");
+		exit(1);
+		}
+	thread->fn = fn;
+	thread->arg = arg;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if (stack != NULL) pthread_attr_setstack(&attr, stack, size);
+	if (pthread_create(&id, &attr, host_thread_start, thread) != 0) {
+		perror("pthread_create");
+		exit(1);
+		}
+	pthread_attr_destroy(&attr);
+	}
+
+void host_thread_exit(void) {
+	host_unlock();
+	pthread_exit(NULL);
+	}
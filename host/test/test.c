@@ -0,0 +1,127 @@
+/*
+* xPL for ESP8266
+*
+* Scenario tests: checks and helpers on the packets the device sent
+*
+* Failures and the result go to stderr, the firmware output stays on stdout.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <stdarg.h>
+#include "test.h"
+
+static int failures;
+
+void test_check(int ok, const char *file, int line, const char *fmt, ...) {
+	va_list ap;
+
+	if (ok) return;
+	failures++;
+	fprintf(stderr, "%s:%d: ", file, line);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+	}
+
+// Print the result, returns the exit status
+int test_done(const char *name) {
+	fprintf(stderr, "%s: %s\n", name, failures ? "FAILED" : "ok");
+	return failures != 0;
+	}
+
+// Does the packet have this message type (xpl-stat...) and schema (hbeat.app...), NULL for any
+static int test_match(const struct sim_packet *packet, const char *type, const char *schema) {
+	const char *body = strstr(packet->data, "}\n");
+	size_t len;
+
+	if (type != NULL && (strncmp(packet->data, type, strlen(type)) != 0 || packet->data[strlen(type)] != '\n')) return 0;
+	if (schema == NULL) return 1;
+	if (body == NULL) return 0;
+	len = strlen(schema);
+	return strncmp(body + 2, schema, len) == 0 && body[2 + len] == '\n';
+	}
+
+// Index of the first matching packet from index from on, -1 if none
+int test_find(int from, const char *type, const char *schema) {
+	const struct sim_packet *packet;
+
+	for (; (packet = sim_sent(from)) != NULL; from++) {
+		if (test_match(packet, type, schema)) return from;
+		}
+	return -1;
+	}
+
+// Matching packets sent from start up to, not including, end
+int test_count(uint64 start, uint64 end, const char *type, const char *schema) {
+	const struct sim_packet *packet;
+	unsigned i;
+	int count = 0;
+
+	for (i = 0; (packet = sim_sent(i)) != NULL; i++) {
+		if (packet->time >= start && packet->time < end && test_match(packet, type, schema)) count++;
+		}
+	return count;
+	}
+
+// Value of a name=value line of the message body, NULL if it has none
+const char *test_field(const struct sim_packet *packet, const char *name, char *value, size_t size) {
+	const char *p = strstr(packet->data, "}\n"), *end;
+	size_t len = strlen(name);
+
+	for (; p != NULL; p = strchr(p, '\n')) {
+		p++;
+		if (strncmp(p, name, len) == 0 && p[len] == '=') {
+			p += len + 1;
+			end = strchr(p, '\n');
+			if (end == NULL || (size_t)(end - p) >= size) return NULL;
+			memcpy(value, p, end - p);
+			value[end - p] = '\0';
+			return value;
+			}
+		}
+	return NULL;
+	}
+
+// Message from acme-console.test for the device to receive at time, see test_inject_from
+void test_inject(uint64 time, const char *type, const char *target, const char *schema, const char *body) {
+	test_inject_from(time, type, "acme-console.test", target, schema, body);
+	}
+
+// Message for the device to receive at time. The body is name=value lines, each ending with \n.
+void test_inject_from(uint64 time, const char *type, const char *source, const char *target, const char *schema, const char *body) {
+	char msg[1024];
+	int len = snprintf(msg, sizeof(msg), "%s\n{\nhop=1\nsource=%s\ntarget=%s\n}\n%s\n{\n%s}\n", type, source, target, schema, body);
+
+	CHECK(len < sizeof(msg), "message to inject too long");
+	sim_inject(time, msg);
+	}
+
+// Timeline of what was sent, to stdout, for working out what a scenario should expect
+void test_dump(uint64 start, uint64 end) {
+	const struct sim_packet *packet;
+	const char *body;
+	unsigned i;
+
+	for (i = 0; (packet = sim_sent(i)) != NULL; i++) {
+		if (packet->time < start || packet->time >= end) continue;
+		body = strstr(packet->data, "}\n");
+		printf("%10llu.%06llu %.8s %.*s\n", packet->time / SIM_S, packet->time % SIM_S, packet->data,
+			body != NULL ? (int)strcspn(body + 2, "\n") : 0, body != NULL ? body + 2 : "");
+		}
+	}
@@ -0,0 +1,42 @@
+/*
+* xPL for ESP8266
+*
+* Scenario tests: checks and helpers on the packets the device sent
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef test_h
+#define test_h
+
+#include "port/sim.h"
+
+// Record a failure, with the line it came from
+#define CHECK(cond, ...)	test_check(cond, __FILE__, __LINE__, __VA_ARGS__)
+
+void test_check(int ok, const char *file, int line, const char *fmt, ...) __attribute__((format(printf, 4, 5)));
+int test_done(const char *name);
+
+int test_find(int from, const char *type, const char *schema);
+int test_count(uint64 start, uint64 end, const char *type, const char *schema);
+const char *test_field(const struct sim_packet *packet, const char *name, char *value, size_t size);
+void test_dump(uint64 start, uint64 end);
+
+void test_inject(uint64 time, const char *type, const char *target, const char *schema, const char *body);
+void test_inject_from(uint64 time, const char *type, const char *source, const char *target, const char *schema, const char *body);
+
+#endif
@@ -0,0 +1,107 @@
+/*
+* xPL for ESP8266
+*
+* Scenario: sensor readings packed into as few messages as fit a datagram, and held for each other
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "test.h"
+#include "UserConfig.h"
+#include "xPL.h"
+#include "Sensor.h"
+
+void user_init(void);
+
+static sint32 values[3] = { 215, 180, 0 };
+static char devices[3][61], types[3][61];
+
+static sint32 reader(uint8 arg) {
+	return values[arg];
+	}
+
+static void warmer(void *arg) {
+	values[0] = 220;
+	}
+
+static void cooler(void *arg) {
+	values[1] = 190;
+	}
+
+static const char hold[] =
+	"xpl-cmnd\n{\nhop=1\nsource=acme-console.test\ntarget=peteben-ESP8266.ESP-01\n}\n"
+	"config.response\n{\nsensor-hold=2000\n}\n";
+
+// Field of the nth sensor.basic trigger, "" if it has none
+static const char *field(int n, const char *name) {
+	static char value[XPL_CONFIG_VALUE_MAX + 1];
+	int i = test_find(0, "xpl-trig", "sensor.basic");
+
+	while (i >= 0 && n-- > 0) i = test_find(i + 1, "xpl-trig", "sensor.basic");
+	if (i < 0 || test_field(sim_sent(i), name, value, sizeof(value)) == NULL) return "";
+	return value;
+	}
+
+int main(void) {
+	static struct sensor_channel channels[3];
+	xPL_Message *msg;
+	int i, n;
+
+	sim_init();
+	user_init();
+
+	// Three more sensors, with names long enough that the four readings don't fit one datagram
+	for (i = 0; i < 3; i++) {
+		sprintf(devices[i], "t%d-%057d", i + 1, 0);
+		sprintf(types[i], "temp-%055d", 0);
+		channels[i] = (struct sensor_channel){ devices[i], types[i], reader, i, 0, 1, 0, 300 };
+		CHECK(sensor_add(&channels[i]), "sensor %d", i);
+		}
+
+	sim_inject(1500 * SIM_MS, hold);
+	sim_at(2500 * SIM_MS, warmer, NULL);			// Due at the 3 s sample
+	sim_at(4500 * SIM_MS, cooler, NULL);			// Due at the 5 s sample, together with the first
+	sim_run_until(6 * SIM_S);
+	test_dump(0, 6 * SIM_S);
+
+	// All four are due at the first sample: three in the first message, the last one on its own, with plain names
+	CHECK(test_count(1 * SIM_S, 2 * SIM_S, "xpl-trig", "sensor.basic") == 2, "%d messages", test_count(1 * SIM_S, 2 * SIM_S, "xpl-trig", "sensor.basic"));
+	CHECK(strcmp(field(0, "device0"), "adc0") == 0 && strcmp(field(0, "device2"), devices[1]) == 0, "first message");
+	CHECK(strcmp(field(0, "current1"), "21.5") == 0, "current1=%s", field(0, "current1"));
+	CHECK(strcmp(field(1, "device"), devices[2]) == 0 && strcmp(field(1, "current"), "0.0") == 0 && *field(1, "device0") == '\0', "second message");
+
+	// Over 256 bytes, and still within what we read back
+	n = test_find(0, "xpl-trig", "sensor.basic");
+	CHECK(n >= 0 && strlen(sim_sent(n)->data) > 256 && strlen(sim_sent(n)->data) < XPL_MESSAGE_BUFFER_MAX, "size");
+	if (n >= 0) {
+		msg = new_xPL_Message();
+		xPL_Parse(msg, sim_sent(n)->data);
+		CHECK(msg->command_count == 9 && strcmp(msg->command[8].name, "current2") == 0, "parsed %d lines", msg->command_count);
+		free_xPL_Message(msg);
+		}
+
+	// The 3 s reading is held for 2 s, and goes with the 5 s one
+	CHECK(test_count(2 * SIM_S, 5 * SIM_S, "xpl-trig", "sensor.basic") == 0, "not held");
+	CHECK(test_count(5 * SIM_S, 6 * SIM_S, "xpl-trig", "sensor.basic") == 1, "held readings");
+	CHECK(strcmp(field(2, "current0"), "22.0") == 0 && strcmp(field(2, "current1"), "19.0") == 0
+		&& strcmp(field(2, "device1"), devices[1]) == 0, "held message");
+
+	// A negative hold would wrap around to forever
+	CHECK(!sensor_set_hold(-1) && sensor_set_hold(0), "hold");
+
+	return test_done("aggregate");
+	}
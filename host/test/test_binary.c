@@ -0,0 +1,238 @@
+/*
+* xPL for ESP8266
+*
+* Scenario: compact binary frames between our nodes, and the gateway back to text
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "test.h"
+#include "UserConfig.h"
+#include "xPL.h"
+#include "xPL_Stats.h"
+#include "xPL_Binary.h"
+
+void user_init(void);
+
+static const char gateway[] =
+	"xpl-stat\n{\nhop=1\nsource=acme-gw.test\ntarget=*\n}\n"
+	"hbeat.app\n{\ninterval=5\nport=3865\nremote-ip=10.0.0.2\nversion=1.0\nbin=2\n}\n";
+
+static const char node[] =
+	"xpl-stat\n{\nhop=1\nsource=acme-node.test\ntarget=*\n}\n"
+	"hbeat.app\n{\ninterval=5\nport=3865\nremote-ip=10.0.0.3\nversion=1.0\nbin=1\n}\n";
+
+// The gateway's text copies of the frames below
+static const char copy_off[] =
+	"xpl-cmnd\n{\nhop=2\nsource=acme-node.test\ntarget=peteben-ESP8266.ESP-01\n}\n"
+	"x10.basic\n{\ncommand=off\ndevice=C1\n}\n";
+
+static const char copy_request[] =
+	"xpl-cmnd\n{\nhop=2\nsource=acme-node.test\ntarget=peteben-ESP8266.ESP-01\n}\n"
+	"esp.request\n{\nquery=counters\n}\n";
+
+// One whose binary original never got here, from another of our nodes
+static const char copy_lost[] =
+	"xpl-cmnd\n{\nhop=2\nsource=peteben-ESP8266.ESP-02\ntarget=peteben-ESP8266.ESP-01\n}\n"
+	"x10.basic\n{\ncommand=on\ndevice=C1\n}\n";
+
+static xPL_Message *message(short type, const char *source, const char *schema, const char *type_id) {
+	xPL_Message *msg = new_xPL_Message();
+
+	msg->type = type;
+	msg->hop = 1;
+	xPL_Message_SetSource(msg, "acme", source, "test");
+	xPL_Message_SetTarget(msg, "*", NULL, NULL);
+	xPL_Message_SetSchema(msg, schema, type_id);
+	return msg;
+	}
+
+// Index of the first binary frame sent from start on, -1 if none
+static int find_binary(uint64 start) {
+	const struct sim_packet *packet;
+	int i;
+
+	for (i = 0; (packet = sim_sent(i)) != NULL; i++) {
+		if (packet->time >= start && (unsigned char)packet->data[0] == XPL_BIN_VERSION) return i;
+		}
+	return -1;
+	}
+
+// Binary frames of a schema sent between start and end
+static int count_binary(uint64 start, uint64 end, const char *class_id, const char *type_id) {
+	const struct sim_packet *packet;
+	xPL_Message *msg;
+	int i, n = 0;
+
+	for (i = 0; (packet = sim_sent(i)) != NULL; i++) {
+		if (packet->time < start || packet->time >= end || (unsigned char)packet->data[0] != XPL_BIN_VERSION) continue;
+		msg = new_xPL_Message();
+		if (xPL_BinDecode(msg, packet->data) && xPL_Message_IsSchema(msg, class_id, type_id)) n++;
+		free_xPL_Message(msg);
+		}
+	return n;
+	}
+
+// Index of the first packet sent from start on
+static int first_sent(uint64 start) {
+	int i;
+
+	for (i = 0; sim_sent(i) != NULL && sim_sent(i)->time < start; i++)
+		;
+	return i;
+	}
+
+static bool led_on(void) {
+	return (host_gpio_reg_read(GPIO_OUT_ADDRESS) & LED_GPIO) == 0;
+	}
+
+int main(void) {
+	char text[XPL_MESSAGE_BUFFER_MAX], frame[XPL_MESSAGE_BUFFER_MAX], cut[XPL_MESSAGE_BUFFER_MAX], bin[4];
+	xPL_Message *msg, *out;
+	bool prefix, off3, on4;
+	int len, i, j, n, accepted;
+
+	sim_init();
+	user_init();
+
+	// Same message back, with the integers and the interned names and schema taking a byte or two
+	msg = message(XPL_TRIG, "sensor", "sensor", "basic");
+	xPL_Message_AddCommand(msg, "device", "C1");
+	xPL_Message_AddCommand(msg, "current", "-1234");
+	xPL_Message_AddCommand(msg, "delta", "007");			// Not canonical, goes as a string
+	xPL_Message_toString(msg, text, sizeof(text));
+	len = xPL_BinEncode(msg, frame, sizeof(frame));
+	CHECK(len > 0 && len * 2 < strlen(text), "%d bytes for %d of text", len, (int)strlen(text));
+	CHECK(strlen(frame) == len, "0 in the frame");
+
+	out = new_xPL_Message();
+	CHECK(xPL_BinDecode(out, frame), "decode");
+	xPL_Message_toString(out, cut, sizeof(cut));
+	CHECK(strcmp(cut, text) == 0, "round trip\n%s", cut);
+	free_xPL_Message(out);
+
+	// Cut anywhere, the frame is rejected, or reads as the first lines of the message: after the schema and each line
+	for (i = 1, accepted = 0; i < len; i++) {
+		out = new_xPL_Message();
+		memcpy(cut, frame, i);
+		cut[i] = '\0';
+		if (xPL_BinDecode(out, cut)) {
+			accepted++;
+			prefix = out->command_count < msg->command_count && xPL_Message_IsSchema(out, "sensor", "basic");
+			for (j = 0; prefix && j < out->command_count; j++) {
+				prefix = strcmp(out->command[j].name, msg->command[j].name) == 0 && strcmp(out->command[j].value, msg->command[j].value) == 0;
+				}
+			CHECK(prefix, "cut at %d", i);
+			}
+		free_xPL_Message(out);
+		}
+	CHECK(accepted == 3, "%d cuts accepted", accepted);
+
+	// A string longer than its field is an error
+	frame[2] = XPL_VENDOR_ID_MAX + 2;
+	out = new_xPL_Message();
+	CHECK(!xPL_BinDecode(out, frame), "long vendor id");
+	free_xPL_Message(out);
+	free_xPL_Message(msg);
+
+	// A node says it reads binary, the input trigger still goes out as text. Then a gateway, and the next one is binary, to everyone.
+	sim_inject(500 * SIM_MS, node);
+	sim_gpio(1 * SIM_S, INPUT_GPIO, 0);
+	sim_inject(1500 * SIM_MS, gateway);
+	sim_gpio(2 * SIM_S, INPUT_GPIO, INPUT_GPIO);
+
+	// The node turns our LED off and asks for the counters, binary, and the gateway's text copies are dropped
+	msg = message(XPL_CMND, "node", "x10", "basic");
+	xPL_Message_SetTarget(msg, "peteben", "ESP8266", "ESP-01");
+	xPL_Message_AddCommand(msg, "command", "off");
+	xPL_Message_AddCommand(msg, "device", "C1");
+	CHECK(xPL_BinEncode(msg, frame, sizeof(frame)) > 0, "encode");
+	free_xPL_Message(msg);
+	sim_inject(3 * SIM_S, frame);
+	sim_inject(3 * SIM_S + 10 * SIM_MS, copy_off);
+
+	msg = message(XPL_CMND, "node", "esp", "request");
+	xPL_Message_SetTarget(msg, "peteben", "ESP8266", "ESP-01");
+	xPL_Message_AddCommand(msg, "query", "counters");
+	xPL_BinEncode(msg, frame, sizeof(frame));
+	free_xPL_Message(msg);
+	sim_inject(3200 * SIM_MS, frame);
+	sim_inject(3200 * SIM_MS + 10 * SIM_MS, copy_request);
+
+	sim_run_until(3 * SIM_S + 500 * SIM_MS);
+	off3 = !led_on();
+
+	// A copy with no original gets through, even from our own vendor and device
+	sim_inject(3700 * SIM_MS, copy_lost);
+	sim_run_until(4 * SIM_S);
+	on4 = led_on();
+
+	// Now we are the gateway, and turn what the node sends into text for everyone
+	test_inject(4500 * SIM_MS, "xpl-cmnd", "peteben-ESP8266.ESP-01", "config.response", "bin-gateway=1\n");
+	msg = message(XPL_TRIG, "node", "x10", "basic");
+	xPL_Message_AddCommand(msg, "command", "on");
+	xPL_Message_AddCommand(msg, "device", "B2");
+	xPL_BinEncode(msg, frame, sizeof(frame));
+	free_xPL_Message(msg);
+	sim_inject(5 * SIM_S, frame);
+
+	// As many lines as a message holds, a small frame, but too much text to pass on
+	msg = message(XPL_TRIG, "node", "sensor", "basic");
+	for (i = 0; i < XPL_MESSAGE_COMMAND_MAX; i++) {
+		xPL_Message_AddCommand(msg, "interval", "123456789");
+		}
+	CHECK(!xPL_Message_AddCommand(msg, "interval", "1") && msg->command_count == XPL_MESSAGE_COMMAND_MAX, "%d lines", msg->command_count);
+	CHECK(!xPL_Message_toString(msg, text, sizeof(text)) && text[0] == '\0', "long text");
+	CHECK(xPL_BinEncode(msg, frame, sizeof(frame)) > 0, "encode long");
+	free_xPL_Message(msg);
+	sim_inject(5500 * SIM_MS, frame);
+	sim_run_until(6 * SIM_S);
+	test_dump(0, 6 * SIM_S);
+
+	// Heartbeats stay text, and say we read binary
+	n = test_find(0, "xpl-stat", "hbeat.app");
+	CHECK(n >= 0 && test_field(sim_sent(n), "bin", bin, sizeof(bin)) != NULL && strcmp(bin, "1") == 0, "hbeat bin=");
+
+	n = test_find(0, "xpl-trig", "x10.basic");
+	CHECK(n >= 0 && sim_sent(n)->time >= 1 * SIM_S && sim_sent(n)->time < 1100 * SIM_MS, "no text trigger before the gateway");
+	CHECK(find_binary(0) >= 0 && sim_sent(find_binary(0))->time >= 2 * SIM_S, "binary before the gateway");
+
+	n = find_binary(2 * SIM_S);
+	CHECK(n >= 0 && sim_sent(n)->time < 2100 * SIM_MS, "no binary trigger");
+	if (n >= 0) {
+		out = new_xPL_Message();
+		CHECK(xPL_BinDecode(out, sim_sent(n)->data), "decode trigger");
+		CHECK(out->type == XPL_TRIG && xPL_Message_IsSchema(out, "x10", "basic") && strcmp(out->source.vendor_id, "peteben") == 0, "trigger");
+		free_xPL_Message(out);
+		}
+	CHECK(test_count(2 * SIM_S, 3 * SIM_S, "xpl-trig", "x10.basic") == 0, "text trigger");
+
+	CHECK(off3 && on4, "LED %d %d", off3, on4);
+	CHECK(test_count(3 * SIM_S, 3500 * SIM_MS, "xpl-stat", "x10.basic") == 1, "LED stat");
+	CHECK(count_binary(3 * SIM_S, 3500 * SIM_MS, "esp", "counters") == 1, "%d counters", count_binary(3 * SIM_S, 3500 * SIM_MS, "esp", "counters"));
+
+	n = test_find(first_sent(5 * SIM_S), "xpl-trig", "x10.basic");
+	CHECK(n >= 0 && strstr(sim_sent(n)->data, "hop=2\nsource=acme-node.test\n") != NULL
+		&& test_field(sim_sent(n), "device", bin, sizeof(bin)) != NULL && strcmp(bin, "B2") == 0, "gateway copy");
+	n = test_find(first_sent(5 * SIM_S), "xpl-stat", "hbeat.app");
+	CHECK(n < 0 || (test_field(sim_sent(n), "bin", bin, sizeof(bin)) != NULL && strcmp(bin, "2") == 0), "gateway hbeat bin=");
+	CHECK(find_binary(4 * SIM_S) < 0, "gateway sent binary");
+	CHECK(test_count(5 * SIM_S, 6 * SIM_S, "xpl-trig", "sensor.basic") == 0 && xPL_stats.send_err == 1, "long copy sent, %d errors", xPL_stats.send_err);
+	CHECK(xPL_stats.bin_rx == 4 && xPL_stats.bin_fail == 0, "received %d, %d bad", xPL_stats.bin_rx, xPL_stats.bin_fail);
+
+	return test_done("binary");
+	}
@@ -0,0 +1,73 @@
+/*
+* xPL for ESP8266
+*
+* Scenario: a contact that chatters for 2 s as it closes, then opens cleanly
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "test.h"
+#include "UserConfig.h"
+#include "Debounce.h"
+
+void user_init(void);
+
+int main(void) {
+	uint64 t;
+	uint32 seed = 1;
+	int n;
+	char value[16];
+
+	sim_init();
+	user_init();
+
+	// From 1 s to 3 s the contact is closed for 1 to 4 ms at a time, with opens of 50 to 300 us
+	// in between. The opens are shorter than a sample period, so it should close once, 4 samples
+	// after the first edge, a little later if a sample falls in an open, and stay closed.
+	// It is really closed from 3 s, and opens at 5 s.
+	for (t = 1 * SIM_S; t < 3 * SIM_S; ) {
+		sim_gpio(t, INPUT_GPIO, 0);
+		seed = seed * 1103515245 + 12345;
+		t += 1000 + (seed >> 16) % 3000;
+		if (t >= 3 * SIM_S)
+			break;
+		sim_gpio(t, INPUT_GPIO, INPUT_GPIO);
+		seed = seed * 1103515245 + 12345;
+		t += 50 + (seed >> 16) % 250;
+		}
+	sim_gpio(3 * SIM_S, INPUT_GPIO, 0);
+	sim_gpio(5 * SIM_S, INPUT_GPIO, INPUT_GPIO);
+	sim_run_until(6 * SIM_S);
+	test_dump(0, 6 * SIM_S);
+
+	CHECK(test_count(0, 6 * SIM_S, "xpl-trig", "x10.basic") == 2, "%d triggers", test_count(0, 6 * SIM_S, "xpl-trig", "x10.basic"));
+
+	n = test_find(0, "xpl-trig", "x10.basic");
+	CHECK(n >= 0 && sim_sent(n)->time >= 1 * SIM_S + 4 * DEBOUNCE_SAMPLE_MS * SIM_MS && sim_sent(n)->time <= 1 * SIM_S + 8 * DEBOUNCE_SAMPLE_MS * SIM_MS,
+		"closed at %llu", n >= 0 ? sim_sent(n)->time : 0);
+	CHECK(n >= 0 && test_field(sim_sent(n), "command", value, sizeof(value)) && strcmp(value, "on") == 0, "not on");
+
+	n = test_find(n + 1, "xpl-trig", "x10.basic");
+	CHECK(n >= 0 && sim_sent(n)->time == 5 * SIM_S + 4 * DEBOUNCE_SAMPLE_MS * SIM_MS, "opened at %llu", n >= 0 ? sim_sent(n)->time : 0);
+	CHECK(n >= 0 && test_field(sim_sent(n), "command", value, sizeof(value)) && strcmp(value, "off") == 0, "not off");
+
+	// Devices outside of A1 to P16 are refused, not wrapped around into a byte
+	CHECK(!debounce_config("4,C0") && !debounce_config("4,C17") && !debounce_config("4,C257") && !debounce_config("4,Q1"), "bad device");
+	CHECK(debounce_config("4,P16"), "P16");
+
+	return test_done("debounce");
+	}
@@ -0,0 +1,95 @@
+/*
+* xPL for ESP8266
+*
+* Scenario: receive filters set through config.response
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "test.h"
+#include "xPL.h"
+#include "xPL_Filter.h"
+#include "xPL_Stats.h"
+#include "Rules.h"
+
+void user_init(void);
+
+static int calls;
+
+static void handler(xPL_Message *msg, unsigned char instance) {
+	if (!xPL_Message_IsSchema(msg, "config", "response")) calls++;
+	}
+
+// Calls to the handler for a message sent at time
+static int passed(uint64 time, const char *type, const char *source, const char *schema) {
+	int before = calls;
+
+	test_inject_from(time, type, source, "*", schema, "command=on\n");
+	sim_run_until(time + SIM_MS);
+	return calls - before;
+	}
+
+int main(void) {
+	sim_init();
+	user_init();
+	xPL_AddInstance("relay-2", handler);
+
+	CHECK(!xPL_FilterAdd("xpl-cmnd.acme.*.*.x10"), "short filter accepted");
+	CHECK(!xPL_FilterAdd("xpl-cmnd.acme.*.*.x10.basic.more"), "long filter accepted");
+	CHECK(!xPL_FilterAdd("xpl-cmd.acme.*.*.x10.basic"), "bad message type accepted");
+	CHECK(!xPL_FilterAdd("xpl-cmnd.acmeacmeacme.*.*.x10.basic"), "long vendor accepted");
+	CHECK(!xPL_FilterAdd("xpl-cmnd..*.*.x10.basic"), "empty vendor accepted");
+	CHECK(xPL_FilterAdd("xpl-cmnd.acmeacme.abcdefgh.0123456789abcdef.sensorxx.basicxxx"), "longest filter refused");
+	xPL_FilterClear();
+
+	CHECK(passed(1 * SIM_S, "xpl-cmnd", "other-console.test", "x10.basic") == 1, "no filters, not passed");
+
+	test_inject_from(2 * SIM_S, "xpl-cmnd", "acme-console.test", "*", "config.response",
+		"filter=xpl-cmnd.acme.*.*.x10.basic\nfilter=xpl-trig.*.*.*.sensor.basic\nfilter=*.acme.console.kitchen.*.*\n"
+		"filter=xpl-stat.acmeacme.abcdefgh.0123456789abcdef.sensor.basic\n");
+	CHECK(rule_add("xpl-cmnd.x10.basic", "gpio,4,high"), "rule");
+	sim_run_until(3 * SIM_S);
+
+	CHECK(passed(3 * SIM_S, "xpl-cmnd", "acme-console.test", "x10.basic") == 1, "acme x10 command filtered");
+	CHECK(passed(4 * SIM_S, "xpl-cmnd", "other-console.test", "x10.basic") == 0, "other x10 command passed");
+	CHECK(passed(5 * SIM_S, "xpl-trig", "acme-console.test", "x10.basic") == 0, "x10 trigger passed");
+	CHECK(passed(6 * SIM_S, "xpl-trig", "other-sensor.hall", "sensor.basic") == 1, "sensor trigger filtered");
+	CHECK(passed(7 * SIM_S, "xpl-cmnd", "acme-console.test", "control.basic") == 0, "control command passed");
+	CHECK(passed(8 * SIM_S, "xpl-stat", "acme-console.kitchen", "control.basic") == 1, "kitchen console filtered");
+	CHECK(passed(8 * SIM_S + 500 * SIM_MS, "xpl-stat", "acmeacme-abcdefgh.0123456789abcdef", "sensor.basic") == 1, "long filter line");
+	CHECK(xPL_stats.filtered == 3, "%u filtered", xPL_stats.filtered);
+	CHECK(rule_fired(0) == 1, "rule fired %u times", rule_fired(0));		// Not on the filtered x10 command
+
+	// Heartbeat requests still get answered
+	test_inject_from(9 * SIM_S, "xpl-cmnd", "other-console.test", "*", "hbeat.request", "command=request\n");
+	sim_run_until(10 * SIM_S);
+	CHECK(test_count(9 * SIM_S, 10 * SIM_S, "xpl-stat", "hbeat.app") == 2, "hbeat.request filtered");
+
+	// The set comes back from flash
+	xPL_FilterClear();
+	CHECK(passed(10 * SIM_S, "xpl-cmnd", "other-console.test", "x10.basic") == 1, "cleared, not passed");
+	xPL_FilterLoad();
+	CHECK(passed(11 * SIM_S, "xpl-cmnd", "other-console.test", "x10.basic") == 0, "not saved");
+
+	// An empty filter line lets everything through again
+	test_inject_from(12 * SIM_S, "xpl-cmnd", "acme-console.test", "*", "config.response", "filter=\n");
+	sim_run_until(13 * SIM_S);
+	test_dump(0, 13 * SIM_S);
+	CHECK(passed(13 * SIM_S, "xpl-cmnd", "other-console.test", "x10.basic") == 1, "filters not cleared");
+
+	return test_done("filter");
+	}
@@ -0,0 +1,86 @@
+/*
+* xPL for ESP8266
+*
+* Scenario: 200 devices answer an hbeat.request at once
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "test.h"
+#include "xPL_Stats.h"
+
+void user_init(void);
+
+#define PEERS		200
+
+static const char request[] =
+	"xpl-cmnd\n{\nhop=1\nsource=acme-console.test\ntarget=*\n}\n"
+	"hbeat.request\n{\ncommand=request\n}\n";
+
+// Answer from peer i
+static void peer_hbeat(uint64 time, int i) {
+	char source[24];
+
+	sprintf(source, "acme-peer.p%d", i);
+	test_inject_from(time, "xpl-stat", source, "*", "hbeat.app", "interval=5\nport=50000\nremote-ip=127.0.0.2\n");
+	}
+
+int main(void) {
+	char value[XPL_STATS_VALUE_MAX + 1] = "";
+	uint32 drops;
+	int i, n;
+
+	sim_init();
+	user_init();
+
+	// The request and all the answers arrive together. The receive queue holds 4 packets,
+	// the rest are dropped before the receive task gets to run.
+	sim_inject(1 * SIM_S, request);
+	for (i = 0; i < PEERS; i++)
+		peer_hbeat(1 * SIM_S, i);
+	sim_run_until(2 * SIM_S);
+
+	n = test_find(test_find(0, "xpl-stat", "hbeat.app") + 1, "xpl-stat", "hbeat.app");
+	CHECK(n >= 0 && sim_sent(n)->time == 1 * SIM_S, "answered at %llu", n >= 0 ? sim_sent(n)->time : 0);
+	CHECK(xPL_stats.received == PEERS + 1, "%u received", xPL_stats.received);
+	CHECK(xPL_stats.drop_full == PEERS + 1 - 4, "%u dropped", xPL_stats.drop_full);
+
+	// Same again with the answers spread out by 50 us, the receive task keeps up
+	drops = xPL_stats.drop_full;
+	sim_inject(2 * SIM_S, request);
+	for (i = 0; i < PEERS; i++)
+		peer_hbeat(2 * SIM_S + (i + 1) * 50, i);
+	sim_run_until(3 * SIM_S);
+	test_dump(0, 3 * SIM_S);
+
+	CHECK(test_count(2 * SIM_S, 3 * SIM_S, "xpl-stat", "hbeat.app") == 1, "not answered");
+	CHECK(xPL_stats.received == 2 * (PEERS + 1), "%u received", xPL_stats.received);
+	CHECK(xPL_stats.drop_full == drops, "%u more dropped", xPL_stats.drop_full - drops);
+	CHECK(xPL_stats.handled == 4 + PEERS + 1, "%u handled", xPL_stats.handled);
+
+	// Counters of a node that has been up for long, all 10 digits, still go out whole
+	xPL_stats.received = xPL_stats.queued = xPL_stats.handled = xPL_stats.filtered = 4000000000u;
+	xPL_stats.parse_fail[7] = 4000000001u;
+	test_inject(3500 * SIM_MS, "xpl-cmnd", "peteben-ESP8266.ESP-01", "esp.request", "query=counters\n");
+	sim_run_until(4 * SIM_S);
+	n = test_find(0, "xpl-stat", "esp.counters");
+	CHECK(n >= 0 && test_field(sim_sent(n), "rx", value, sizeof(value)) != NULL
+		&& strlen(value) == XPL_STATS_VALUE_MAX && strcmp(value + 33, "4000000000") == 0, "rx=%s", n >= 0 ? value : "");
+	CHECK(n >= 0 && test_field(sim_sent(n), "parse5", value, sizeof(value)) != NULL && strcmp(value, "0,0,0,4000000001") == 0, "parse5=%s", value);
+
+	return test_done("flood");
+	}
@@ -0,0 +1,69 @@
+/*
+* xPL for ESP8266
+*
+* Scenario: xpl-group targets, memberships set through config.response
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "test.h"
+#include "xPL.h"
+
+void user_init(void);
+
+static int calls[XPL_INSTANCE_MAX];
+
+static void handler(xPL_Message *msg, unsigned char instance) {
+	if (xPL_Message_IsSchema(msg, "x10", "basic")) calls[instance]++;
+	}
+
+int main(void) {
+	int r2, r3;
+
+	sim_init();
+	user_init();
+	r2 = xPL_AddInstance("relay-2", handler);
+	r3 = xPL_AddInstance("relay-3", handler);
+
+	test_inject(1 * SIM_S, "xpl-cmnd", "peteben-ESP8266.relay-2", "config.response", "group=xpl-group.floor1\ngroup=xpl-group.lights\n");
+	test_inject(1 * SIM_S, "xpl-cmnd", "peteben-ESP8266.relay-3", "config.response", "group=xpl-group.floor1\n");
+	test_inject(2 * SIM_S, "xpl-cmnd", "xpl-group.floor1", "x10.basic", "command=on\n");
+	test_inject(3 * SIM_S, "xpl-cmnd", "xpl-group.lights", "x10.basic", "command=on\n");
+	test_inject(4 * SIM_S, "xpl-cmnd", "xpl-group.attic", "x10.basic", "command=on\n");
+	test_inject(5 * SIM_S, "xpl-cmnd", "xpl-group.floor1", "hbeat.request", "command=request\n");
+	sim_run_until(6 * SIM_S);
+
+	CHECK(calls[0] == 0 && calls[r2] == 2 && calls[r3] == 1, "calls %d %d %d", calls[0], calls[r2], calls[r3]);
+	CHECK(xPL_GroupMembers("floor1") == ((1 << r2) | (1 << r3)), "floor1 members %x", xPL_GroupMembers("floor1"));
+	CHECK(test_count(5 * SIM_S, 6 * SIM_S, "xpl-stat", "hbeat.app") == 2, "group heartbeat request");
+
+	// An empty group line leaves them all, the empty group frees its slot
+	test_inject(6 * SIM_S, "xpl-cmnd", "peteben-ESP8266.relay-2", "config.response", "group=\n");
+	test_inject(7 * SIM_S, "xpl-cmnd", "xpl-group.lights", "x10.basic", "command=off\n");
+	sim_run_until(8 * SIM_S);
+	test_dump(0, 8 * SIM_S);
+
+	CHECK(calls[r2] == 2, "relay-2 still in lights");
+	CHECK(xPL_GroupMembers("floor1") == 1 << r3 && xPL_GroupMembers("lights") == 0, "memberships after leaving");
+
+	// What was saved comes back
+	xPL_JoinGroup(0, "scratch");
+	xPL_LoadGroups();
+	CHECK(xPL_GroupMembers("floor1") == 1 << r3 && xPL_GroupMembers("scratch") == 0, "saved memberships");
+
+	return test_done("groups");
+	}
@@ -0,0 +1,102 @@
+/*
+* xPL for ESP8266
+*
+* Scenario: three logical instances on one device, targeted messages, * fan out and heartbeats
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "test.h"
+#include "xPL.h"
+#include "xPL_Stats.h"
+
+void user_init(void);
+
+static int calls[XPL_INSTANCE_MAX];
+static xPL_Message *last[XPL_INSTANCE_MAX];
+
+// Count the calls, and answer with a trigger from the instance
+static void handler(xPL_Message *msg, unsigned char instance) {
+	xPL_Message *trig;
+
+	calls[instance]++;
+	last[instance] = msg;
+
+	trig = new_xPL_Message();
+	trig->type = XPL_TRIG;
+	trig->hop = 1;
+	xPL_Message_SetTarget(trig, "*", NULL, NULL);
+	xPL_Message_SetSchema(trig, "test", "basic");
+	xPL_SendInstanceMessage(trig, instance);
+	free_xPL_Message(trig);
+	}
+
+// Sent from the instance with this id
+static int from(int n, const char *instance_id) {
+	char source[64];
+
+	sprintf(source, "\nsource=peteben-ESP8266.%s\n", instance_id);
+	return n >= 0 && strstr(sim_sent(n)->data, source) != NULL;
+	}
+
+int main(void) {
+	int r2, r3, n, i;
+
+	sim_init();
+	user_init();
+	r2 = xPL_AddInstance("relay-2", handler);
+	r3 = xPL_AddInstance("relay-3", handler);
+	CHECK(r2 == 1 && r3 == 2, "instances %d and %d", r2, r3);
+	CHECK(xPL_AddInstance("relay-2", handler) < 0, "same id added twice");
+	xPL_device.instance[r3].hbeat_interval = 30;
+
+	test_inject(1 * SIM_S, "xpl-cmnd", "peteben-ESP8266.relay-3", "x10.basic", "command=on\n");
+	test_inject(2 * SIM_S, "xpl-cmnd", "peteben-ESP8266.nobody", "x10.basic", "command=on\n");
+	test_inject(3 * SIM_S, "xpl-cmnd", "*", "x10.basic", "command=on\n");
+	test_inject(4 * SIM_S, "xpl-cmnd", "peteben-ESP8266.relay-2", "hbeat.request", "command=on\n");
+	test_inject(5 * SIM_S, "xpl-cmnd", "*", "hbeat.request", "command=on\n");
+	sim_run_until(65 * SIM_S);
+	test_dump(0, 65 * SIM_S);
+
+	// Only relay-3 got the first one, nobody the second, both the third, from the same parse.
+	// The handlers see the heartbeat requests as well.
+	CHECK(calls[r2] == 3 && calls[r3] == 3, "relay-2 called %d times, relay-3 %d", calls[r2], calls[r3]);
+	CHECK(last[r2] == last[r3], "* message parsed once per instance");
+	n = test_find(0, "xpl-trig", "test.basic");
+	CHECK(n >= 0 && sim_sent(n)->time == 1 * SIM_S && from(n, "relay-3"), "no answer from relay-3");
+	CHECK(test_count(2 * SIM_S, 3 * SIM_S, "xpl-trig", NULL) == 0, "answer to nobody");
+	CHECK(test_count(3 * SIM_S, 4 * SIM_S, "xpl-trig", "test.basic") == 2, "* did not fan out");
+
+	// Heartbeat requests: the targeted one gets one answer, * one per instance
+	n = test_find(0, "xpl-stat", "hbeat.app");
+	for (i = 0; n >= 0 && sim_sent(n)->time < 4 * SIM_S; i++)
+		n = test_find(n + 1, "xpl-stat", "hbeat.app");
+	CHECK(i == 3, "%d heartbeats at start", i);
+	CHECK(test_count(4 * SIM_S, 5 * SIM_S, "xpl-stat", "hbeat.app") == 1 && from(n, "relay-2"), "relay-2 did not answer");
+	CHECK(test_count(5 * SIM_S, 6 * SIM_S, "xpl-stat", "hbeat.app") == 3, "* heartbeat request not answered by all");
+
+	// Each instance on its own interval
+	CHECK(test_count(6 * SIM_S, 65 * SIM_S, "xpl-stat", "hbeat.app") == 4, "heartbeats on their own intervals");
+	n = test_find(0, "xpl-stat", "hbeat.app");
+	for (i = 0; i < 7; i++)
+		n = test_find(n + 1, "xpl-stat", "hbeat.app");
+	CHECK(n >= 0 && sim_sent(n)->time == 30010000 && from(n, "relay-3"), "relay-3 heartbeat at %llu",
+		n >= 0 ? sim_sent(n)->time : 0);
+
+	CHECK(xPL_stats.handled == 5, "%u handled", xPL_stats.handled);
+	return test_done("instances");
+	}
@@ -0,0 +1,76 @@
+/*
+* xPL for ESP8266
+*
+* Scenario: heartbeat timing, and the link going away for 15 s
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "test.h"
+#include "WifiMgr.h"
+
+void user_init(void);
+
+static void link_down(void *arg) {
+	host_wifi_link(false);
+	}
+
+static void link_back(void *arg) {
+	host_wifi_link(true);
+	}
+
+// Heartbeats expected, in us
+static const uint64 hbeats[] = {
+	10000,					// Link up, 10 ms after the connect
+	60010000,				// Every minute from then on, to the tick
+	120010000,
+	180010000,
+	215810006,				// Back, see below. Each wait on the event queue rounds up by 1 us.
+	240010000,				// The heartbeat task kept its schedule through the outage
+	};
+
+int main(void) {
+	struct wifi_mgr_stats stats;
+	const struct sim_packet *packet;
+	int i, n;
+
+	sim_init();
+	user_init();
+
+	// Link lost at 200 s. Attempts at +0.25, +0.76, +1.77, +3.78, +7.79 and +15.80 s, 10 ms each
+	// as the backoff doubles. The AP is back at 215 s, so the last one gets through.
+	sim_at(200 * SIM_S, link_down, NULL);
+	sim_at(215 * SIM_S, link_back, NULL);
+	sim_run_until(300 * SIM_S);
+	test_dump(0, 300 * SIM_S);
+
+	for (i = 0, n = -1; i < sizeof(hbeats) / sizeof(hbeats[0]); i++) {
+		n = test_find(n + 1, "xpl-stat", "hbeat.app");
+		packet = sim_sent(n);
+		CHECK(packet != NULL && packet->time == hbeats[i], "heartbeat %d at %llu, expected %llu", i,
+			packet != NULL ? packet->time : 0, hbeats[i]);
+		}
+	CHECK(test_count(240010001, 300 * SIM_S, "xpl-stat", "hbeat.app") == 0, "too many heartbeats");
+	CHECK(test_count(200 * SIM_S, 215810006, NULL, NULL) == 0, "sent while the link was down");
+
+	wifi_mgr_get_stats(&stats);
+	CHECK(stats.outages == 1, "%lu outages", stats.outages);
+	CHECK(stats.attempts == 6, "%lu reconnect attempts", stats.attempts);
+	CHECK(stats.last_recover == 1581, "recovered in %u ticks", stats.last_recover);
+
+	return test_done("link");
+	}
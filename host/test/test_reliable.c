@@ -0,0 +1,116 @@
+/*
+* xPL for ESP8266
+*
+* Scenario: acknowledged triggers, one never acked and one acked after 20 ms
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "test.h"
+#include "UserConfig.h"
+#include "Reliable.h"
+
+void user_init(void);
+
+static int acking;
+
+// Plays the controller: acks the x10 triggers 20 ms after they went out
+static void controller(const struct sim_packet *packet) {
+	char msgid[8], body[24];
+
+	if (!acking || strncmp(packet->data, "xpl-trig", 8) != 0 || test_field(packet, "msgid", msgid, sizeof(msgid)) == NULL)
+		return;
+
+	sprintf(body, "msgid=%s\n", msgid);
+	test_inject(packet->time + 20 * SIM_MS, "xpl-cmnd", "peteben-ESP8266.ESP-01", "esp.ack", body);
+	}
+
+static const char config[] =
+	"xpl-cmnd\n{\nhop=1\nsource=acme-console.test\ntarget=peteben-ESP8266.ESP-01\n}\n"
+	"config.response\n{\nreliable=x10.basic\n}\n";
+
+// Resends of the first trigger in ms from the time it went out: RTO of 500 ms, doubling up to 3 s
+static const uint64 resends[] = { 500, 1500, 3500 };
+
+int main(void) {
+	struct reliable_stats stats;
+	struct {
+		uint32 magic;
+		char list[XPL_CONFIG_VALUE_MAX + 1];
+		} saved;
+	char first[8], msgid[8], value[XPL_CONFIG_VALUE_MAX + 1] = "";
+	uint64 start;
+	int i, n;
+
+	sim_init();
+	user_init();
+	sim_on_send(controller);
+
+	sim_inject(1 * SIM_S, config);
+	sim_gpio(2 * SIM_S, INPUT_GPIO, 0);				// Nobody acks this one
+	sim_run_until(12 * SIM_S);
+
+	n = test_find(0, "xpl-trig", "x10.basic");
+	CHECK(n >= 0 && test_field(sim_sent(n), "msgid", first, sizeof(first)) != NULL, "no msgid");
+	start = n >= 0 ? sim_sent(n)->time : 0;
+	for (i = 0; n >= 0 && i < sizeof(resends) / sizeof(resends[0]); i++) {
+		n = test_find(n + 1, "xpl-trig", "x10.basic");
+		CHECK(n >= 0 && (sim_sent(n)->time - start) / SIM_MS == resends[i], "resend %d at +%llu us", i, n >= 0 ? sim_sent(n)->time - start : 0);
+		CHECK(n >= 0 && test_field(sim_sent(n), "msgid", msgid, sizeof(msgid)) && strcmp(msgid, first) == 0, "msgid changed");
+		}
+	CHECK(test_find(n + 1, "xpl-trig", "x10.basic") < 0, "sent after the last retry");
+
+	reliable_get_stats(&stats);
+	CHECK(stats.sent == 1 && stats.retries == 3 && stats.gave_up == 1 && stats.acked == 0,
+		"sent %u retries %u gave up %u acked %u", stats.sent, stats.retries, stats.gave_up, stats.acked);
+
+	// This one is acked, 2 ticks of round trip
+	acking = 1;
+	sim_gpio(12 * SIM_S, INPUT_GPIO, INPUT_GPIO);
+	sim_run_until(20 * SIM_S);
+
+	CHECK(test_count(12 * SIM_S, 20 * SIM_S, "xpl-trig", "x10.basic") == 1, "acked trigger sent again");
+	reliable_get_stats(&stats);
+	CHECK(stats.acked == 1 && stats.retries == 3, "acked %u retries %u", stats.acked, stats.retries);
+	CHECK(stats.srtt >> 3 == 2 && stats.rto == RELIABLE_RTO_MIN, "srtt %u rto %u", stats.srtt >> 3, stats.rto);
+
+	// Triggers from others with a msgid get acked back, each copy
+	test_inject(20 * SIM_S, "xpl-trig", "*", "x10.basic", "device=A1\ncommand=on\nmsgid=42\n");
+	test_inject(20 * SIM_S + 500 * SIM_MS, "xpl-trig", "*", "x10.basic", "device=A1\ncommand=on\nmsgid=42\n");
+	sim_run_until(21 * SIM_S);
+	n = test_find(0, "xpl-cmnd", "esp.ack");
+	CHECK(n >= 0 && strstr(sim_sent(n)->data, "\ntarget=acme-console.test\n") != NULL
+		&& test_field(sim_sent(n), "msgid", msgid, sizeof(msgid)) && strcmp(msgid, "42") == 0, "no ack");
+	CHECK(test_count(20 * SIM_S, 21 * SIM_S, "xpl-cmnd", "esp.ack") == 2, "%d acks", test_count(20 * SIM_S, 21 * SIM_S, "xpl-cmnd", "esp.ack"));
+
+	// The list of schemas is kept in flash
+	CHECK(system_param_load(RELIABLE_SECTOR, 0, &saved, sizeof(saved)) && saved.magic == RELIABLE_MAGIC && strcmp(saved.list, "x10.basic") == 0, "not saved");
+
+	// The counters
+	test_inject(21 * SIM_S, "xpl-cmnd", "peteben-ESP8266.ESP-01", "esp.request", "query=reliable\n");
+	sim_run_until(22 * SIM_S);
+	reliable_get_stats(&stats);
+	snprintf(first, sizeof(first), "%u,%u,", stats.sent, stats.acked);
+	n = test_find(0, "xpl-stat", "esp.reliable");
+	CHECK(n >= 0 && test_field(sim_sent(n), "count", value, sizeof(value)) != NULL && strncmp(value, first, strlen(first)) == 0, "count=%s", value);
+
+	// Sensor triggers were not selected
+	n = test_find(0, "xpl-trig", "sensor.basic");
+	CHECK(n < 0 || test_field(sim_sent(n), "msgid", msgid, sizeof(msgid)) == NULL, "sensor trigger with a msgid");
+
+	return test_done("reliable");
+	}
@@ -0,0 +1,90 @@
+/*
+* xPL for ESP8266
+*
+* Scenario: local rules on a trigger the device sends and on received messages
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "test.h"
+#include "UserConfig.h"
+#include "Rules.h"
+
+void user_init(void);
+
+#define CONFIG	"xpl-cmnd\n{\nhop=1\nsource=acme-console.test\ntarget=peteben-ESP8266.ESP-01\n}\nconfig.response\n{\n"
+
+// Rules are added a few at a time, a message has to fit in 255 bytes
+static const char config1[] = CONFIG
+	"rule=xpl-trig.x10.basic,device=C1,command=on\n"
+	"action=xpl-cmnd,acme-lamp.hall,x10.basic,device=C2,command=on\n"
+	"rule=*.sensor.basic,device=hall\n"
+	"action=gpio,4,low\n"
+	"}\n";
+static const char config2[] = CONFIG
+	"rule=xpl-cmnd.x10.basic,device=C7,command=on\n"
+	"action=gpio,0,high\n"
+	"rule=x10.basic,device=C7\n"						// No message type, skipped
+	"action=gpio,4,high\n"
+	"rule=*.sensor.basic,device=hall\n"				// Replaces the action
+	"action=gpio,4,high\n"
+	"}\n";
+
+int main(void) {
+	char value[24];
+	int n, trig;
+
+	sim_init();
+	user_init();
+
+	sim_inject(1 * SIM_S, config1);
+	sim_inject(1 * SIM_S + 100 * SIM_MS, config2);
+	sim_gpio(2 * SIM_S, INPUT_GPIO, 0);
+	test_inject(3 * SIM_S, "xpl-cmnd", "*", "x10.basic", "device=C7\ncommand=on\n");
+	test_inject(4 * SIM_S, "xpl-trig", "*", "x10.basic", "device=C7\ncommand=on\n");		// Wrong type
+	test_inject(5 * SIM_S, "xpl-trig", "acme-other.test", "sensor.basic", "device=hall\ncurrent=1\n");
+	sim_run_until(6 * SIM_S);
+	test_dump(0, 6 * SIM_S);
+
+	// The local trigger drives the lamp on the other node, at once
+	trig = test_find(0, "xpl-trig", "x10.basic");
+	n = test_find(0, "xpl-cmnd", "x10.basic");
+	CHECK(n >= 0 && trig >= 0 && sim_sent(n)->time == sim_sent(trig)->time, "command not sent with the trigger");
+	CHECK(n >= 0 && test_field(sim_sent(n), "device", value, sizeof(value)) && strcmp(value, "C2") == 0, "device %s", value);
+	CHECK(n >= 0 && strstr(sim_sent(n)->data, "\ntarget=acme-lamp.hall\n") != NULL, "target");
+	CHECK(test_count(0, 6 * SIM_S, "xpl-cmnd", "x10.basic") == 1, "rule ran on its own command");
+
+	// The command for C7 turns the LED off, its stat goes out
+	CHECK(host_gpio_reg_read(GPIO_OUT_ADDRESS) & LED_GPIO, "LED pin low");
+	n = test_find(0, "xpl-stat", "x10.basic");
+	CHECK(n >= 0 && sim_sent(n)->time == 3 * SIM_S && test_field(sim_sent(n), "command", value, sizeof(value)) && strcmp(value, "off") == 0,
+		"no stat for the LED");
+
+	// Messages for someone else go through the rules too
+	CHECK(host_gpio_reg_read(GPIO_OUT_ADDRESS) & BIT4, "pin 4 low");
+	CHECK(rule_fired(0) == 1 && rule_fired(1) == 1 && rule_fired(2) == 1, "fired %u %u %u", rule_fired(0), rule_fired(1), rule_fired(2));	// Trigger, sensor, C7
+
+	// The rules come back from flash
+	rule_clear();
+	CHECK(rule_fired(0) == 0, "cleared");
+	rule_load();
+	test_inject(6 * SIM_S, "xpl-trig", "*", "sensor.basic", "device=hall\n");
+	sim_run_until(7 * SIM_S);
+	CHECK(rule_fired(1) == 1, "rule not loaded");
+
+	return test_done("rules");
+	}
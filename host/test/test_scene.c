@@ -0,0 +1,72 @@
+/*
+* xPL for ESP8266
+*
+* Scenario: batch commands and scenes switching several outputs at once
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "test.h"
+#include "UserConfig.h"
+#include "State.h"
+
+void user_init(void);
+
+// Level of the three output pins
+static uint32 pins(void) {
+	return host_gpio_reg_read(GPIO_OUT_ADDRESS) & (LED_GPIO | BIT4 | BIT5);
+	}
+
+int main(void) {
+	uint32 at2, at3, at4;
+
+	sim_init();
+	user_init();
+	sim_run_until(1 * SIM_S);
+
+	// Two more outputs, active high
+	state_add(STATE_OUTPUT, 0, 'D', 1, BIT4, false);
+	state_add(STATE_OUTPUT, 0, 'D', 2, BIT5, false);
+
+	test_inject(2 * SIM_S, "xpl-cmnd", "peteben-ESP8266.ESP-01", "esp.batch", "C1=off\nD1=on\nD2=on\nC9=on\n");		// C9 is not ours
+	test_inject(3 * SIM_S, "xpl-cmnd", "peteben-ESP8266.ESP-01", "config.response", "scene=1,D1=off,C1=on\nscene=2,D2=off\n");
+	test_inject(3 * SIM_S + 500 * SIM_MS, "xpl-cmnd", "peteben-ESP8266.ESP-01", "esp.batch", "scene=1\nscene=2\nD1=on\n");
+	test_inject(4 * SIM_S, "xpl-cmnd", "peteben-ESP8266.ESP-01", "esp.batch", "scene=1\nscene=2\nD1=on\n");			// Already there
+	test_inject(5 * SIM_S, "xpl-cmnd", "peteben-ESP8266.ESP-01", "config.response", "scene=2\n");						// Removed
+	test_inject(6 * SIM_S, "xpl-cmnd", "peteben-ESP8266.ESP-01", "esp.batch", "scene=2\n");
+	test_inject(6500 * SIM_MS, "xpl-cmnd", "peteben-ESP8266.ESP-01", "esp.batch", "scene=257\n");						// Not scene 1, D1 would go off
+	sim_run_until(2 * SIM_S + 100 * SIM_MS);
+	at2 = pins();
+	sim_run_until(3 * SIM_S + 600 * SIM_MS);
+	at3 = pins();
+	sim_run_until(4 * SIM_S + 100 * SIM_MS);
+	at4 = pins();
+	sim_run_until(7 * SIM_S);
+	test_dump(0, 7 * SIM_S);
+
+	// All three switched in one go, and each one sent its stat
+	CHECK(at2 == (LED_GPIO | BIT4 | BIT5), "pins %x", at2);
+	CHECK(test_count(2 * SIM_S, 2 * SIM_S + 1, "xpl-stat", "x10.basic") == 3, "stats");
+
+	// Scene 1 turns D1 off and the LED on, scene 2 D2 off, then D1 back on: only the LED and D2 change
+	CHECK(at3 == BIT4, "pins %x", at3);
+	CHECK(test_count(3 * SIM_S, 4 * SIM_S, "xpl-stat", "x10.basic") == 2, "scene stats");
+	CHECK(at4 == at3 && test_count(4 * SIM_S, 5 * SIM_S, "xpl-stat", "x10.basic") == 0, "nothing changed");
+	CHECK(pins() == at3, "removed or out of range scene applied");
+
+	return test_done("scene");
+	}
@@ -0,0 +1,68 @@
+/*
+* xPL for ESP8266
+*
+* Unit test: integer conversions of the firmware sscanf
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "test.h"
+#include "xPL_utils.h"
+
+// One %d style conversion into an int, checks the count and the value
+#define INT(fmt, in, expect) do { \
+	int v = 12345; \
+	CHECK(sscanf(in, fmt, &v) == 1 && v == (expect), "%s on \"%s\": %d", fmt, in, v); \
+	} while (0)
+
+int main(void) {
+	long long q;
+	unsigned u;
+	short h;
+	int v;
+
+	INT(XPL_HOP_COUNT_PARSER, "hop=1", 1);
+	INT(XPL_HOP_COUNT_PARSER, "hop=  9", 9);
+	INT("%d", "-42", -42);
+	INT("%d", "+7x", 7);
+	INT("%d", "2147483647", 2147483647);
+	INT("%d", "2147483648", 2147483647);		// Saturates at the int range
+	INT("%d", "-2147483648", -2147483647 - 1);
+	INT("%d", "-99999999999", -2147483647 - 1);
+	INT("%i", "0x1F", 31);
+	INT("%i", "017", 15);
+	INT("%i", "0", 0);
+	INT("%x", "0xfF", 255);
+	INT("%x", "ffffffff", -1);
+	INT("%o", "777", 511);
+	INT("%2d", "1234", 12);
+
+	CHECK(sscanf("4294967295", "%u", &u) == 1 && u == 4294967295U, "%%u max: %u", u);
+	CHECK(sscanf("4294967296", "%u", &u) == 1 && u == 4294967295U, "%%u over: %u", u);
+	CHECK(sscanf("-1", "%u", &u) == 1 && u == 4294967295U, "%%u negative: %u", u);
+	CHECK(sscanf("-300", "%hd", &h) == 1 && h == -300, "%%hd: %d", h);
+
+	// 64 bits, still through strtoq
+	CHECK(sscanf("-8589934592", "%qd", &q) == 1 && q == -8589934592LL, "%%qd: %lld", q);
+	CHECK(sscanf("8589934592", "%lld", &q) == 1 && q == 8589934592LL, "%%lld: %lld", q);
+
+	CHECK(sscanf("hop=", XPL_HOP_COUNT_PARSER, &v) == -1, "empty hop");
+	CHECK(sscanf("hop=x", XPL_HOP_COUNT_PARSER, &v) == 0, "bad hop");
+	CHECK(sscanf("12 34", "%d %d", &v, &u) == 2 && v == 12 && u == 34, "two fields");
+
+	return test_done("sscanf");
+	}
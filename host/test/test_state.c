@@ -0,0 +1,79 @@
+/*
+* xPL for ESP8266
+*
+* Scenario: stats sent on output changes only, status requests answered from the state table
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "test.h"
+#include "UserConfig.h"
+#include "State.h"
+
+void user_init(void);
+
+// Value of a field in the only message of that type and schema sent in the second starting at s
+static const char *one(int s, const char *type, const char *schema, const char *name, char *value) {
+	int n = test_find(0, type, schema);
+
+	while (n >= 0 && sim_sent(n)->time < s * SIM_S) n = test_find(n + 1, type, schema);
+	if (n < 0 || test_count(s * SIM_S, (s + 1) * SIM_S, type, schema) != 1)
+		return "none";
+	return test_field(sim_sent(n), name, value, 8) ? value : "none";
+	}
+
+int main(void) {
+	const struct state_entry *e;
+	char value[8];
+	signed char idx;
+
+	sim_init();
+	user_init();
+
+	test_inject(1 * SIM_S, "xpl-cmnd", "peteben-ESP8266.ESP-01", "x10.basic", "device=C1\ncommand=off\n");
+	test_inject(2 * SIM_S, "xpl-cmnd", "peteben-ESP8266.ESP-01", "x10.basic", "device=C1\ncommand=off\n");			// Already off
+	test_inject(3 * SIM_S, "xpl-cmnd", "peteben-ESP8266.ESP-01", "x10.basic", "device=C1\ncommand=on\n");
+	test_inject(4 * SIM_S, "xpl-cmnd", "peteben-ESP8266.ESP-01", "x10.basic", "device=C1\ncommand=status_request\n");
+	test_inject(5 * SIM_S, "xpl-cmnd", "peteben-ESP8266.ESP-01", "config.response", "input=4,C5,sensor\n");
+	test_inject(6 * SIM_S, "xpl-cmnd", "peteben-ESP8266.ESP-01", "sensor.request", "device=C5\n");
+	sim_gpio(7 * SIM_S, BIT4, 0);
+	test_inject(8 * SIM_S, "xpl-cmnd", "peteben-ESP8266.ESP-01", "sensor.request", "device=C5\n");
+	sim_run_until(9 * SIM_S);
+	test_dump(0, 9 * SIM_S);
+
+	CHECK(strcmp(one(1, "xpl-stat", "x10.basic", "command", value), "off") == 0, "off: %s", value);
+	CHECK(test_count(2 * SIM_S, 3 * SIM_S, "xpl-stat", "x10.basic") == 0, "stat without a change");
+	CHECK(strcmp(one(3, "xpl-stat", "x10.basic", "command", value), "on") == 0, "on: %s", value);
+	CHECK(strcmp(one(4, "xpl-stat", "x10.basic", "command", value), "on") == 0, "status: %s", value);
+	CHECK(strcmp(one(4, "xpl-stat", "x10.basic", "device", value), "C1") == 0, "status device: %s", value);
+
+	// The new input is in the table, open to start with
+	CHECK(strcmp(one(6, "xpl-stat", "sensor.basic", "current", value), "high") == 0, "open input: %s", value);
+	CHECK(strcmp(one(7, "xpl-trig", "sensor.basic", "current", value), "low") == 0, "trigger: %s", value);
+	CHECK(test_count(7 * SIM_S, 8 * SIM_S, "xpl-stat", "sensor.basic") == 0, "stat along with the trigger");
+	CHECK(strcmp(one(8, "xpl-stat", "sensor.basic", "current", value), "low") == 0, "closed input: %s", value);
+
+	idx = state_find(0, 'C', 5, true);
+	e = idx >= 0 ? state_get(idx) : NULL;
+	CHECK(e != NULL && e->kind == STATE_SENSOR && e->on, "input entry");
+	CHECK(e != NULL && e->changed == (7 * SIM_S + 4 * DEBOUNCE_SAMPLE_MS * SIM_MS) / (portTICK_RATE_MS * SIM_MS), "changed at tick %u", e ? e->changed : 0);
+
+	// The output and the input at C1 are two entries
+	CHECK(state_find(0, 'C', 1, false) >= 0 && state_find(0, 'C', 1, true) >= 0, "C1 entries");
+
+	return test_done("state");
+	}
@@ -0,0 +1,507 @@
+/*
+* xPL for ESP8266
+*
+* Load generator and round trip timer, for a module or the host build
+*
+* xpl-load [-t addr[:port]] [-l port] [-r rate] [-d seconds | -n count] [-m mix]
+*          [-D source] [-u device] [-s sensor] [-x] [-w ms] [-q]
+*   -t		where to send, 255.255.255.255:3865 by default
+*   -l		port the replies come back on, 3865 by default
+*   -r		messages per second, 100 by default
+*   -d, -n	run for that many seconds, 10 by default, or send that many messages
+*   -m		message mix, e.g. x10=4,hbeat=1,sensor=1,bad=1
+*   -D		only count replies from this source, vendor-device.instance
+*   -u		X10 device to command, C1 by default
+*   -s		sensor device to request, adc0 by default
+*   -x		send X10 status requests, which dimmer builds answer, instead of on/off
+*   -w		reply timeout in ms, 1000 by default
+*   -q		don't ask the device for its counters before and after the run
+*
+* xPL has no message id, so the replies of each kind are matched to the requests in order.
+* The device answers in the order the requests came in, so once a later request of another kind
+* has been answered, the unanswered ones before it are lost. So are the ones with no reply
+* within the timeout.
+* Plain X10 commands and malformed messages get no reply. Their fate shows in the device
+* counters (esp.counters), read before and after the run.
+*
+* Against the host build:
+*   xpl-host -l 13865 -s 127.0.0.1:13866 &
+*   xpl-load -t 127.0.0.1:13865 -l 13866 -r 1000 -d 5
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#define KIND_X10		0
+#define KIND_HBEAT		1
+#define KIND_SENSOR		2
+#define KIND_BAD		3
+#define KINDS			4
+
+#define PENDING_MAX		65536			// Requests waiting for a reply, per kind
+#define SOURCE			"xpl-load.host"
+
+struct pending {
+	uint64_t sent;						// ns
+	unsigned long seq;
+	};
+
+struct kind {
+	const char *name;
+	int weight;
+	int current;						// Smooth weighted round robin
+	unsigned char replied;				// A reply is expected
+	unsigned long sent;
+	unsigned long replies;
+	unsigned long lost;
+	struct pending pending[PENDING_MAX];
+	unsigned long head;
+	unsigned long count;
+	uint32_t *rtt;						// Round trip times, us
+	unsigned long samples;
+	unsigned long capacity;
+	};
+
+// Device counters from esp.counters
+struct counters {
+	unsigned char valid;
+	unsigned long rx[3];				// received, queued, handled
+	unsigned long drop[4];
+	unsigned long parse;
+	unsigned long tx[2];
+	};
+
+static struct kind kinds[KINDS] = {
+	{ "x10", 1 },
+	{ "hbeat", 1, 0, 1 },
+	{ "sensor", 1, 0, 1 },
+	{ "bad", 1 },
+	};
+
+static int fd;
+static struct sockaddr_in dest;
+static const char *source;
+static const char *x10_device = "C1";
+static const char *sensor_device = "adc0";
+static unsigned char x10_status;
+static uint64_t timeout_ns = 1000000000ULL;
+static struct counters last_counters;
+static unsigned long seq;
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	}
+
+static void usage(void) {
+	fprintf(stderr, "usage: xpl-load [-t addr[:port]] [-l port] [-r rate] [-d seconds | -n count] [-m mix]\n"
+		"                [-D source] [-u device] [-s sensor] [-x] [-w ms] [-q]\n");
+	exit(2);
+	}
+
+// Pick the next kind to send, spread as evenly as the weights allow
+static int next_kind(void) {
+	int i, best = -1, total = 0;
+
+	for (i = 0; i < KINDS; i++) {
+		if (kinds[i].weight == 0) continue;
+		kinds[i].current += kinds[i].weight;
+		total += kinds[i].weight;
+		if (best < 0 || kinds[i].current > kinds[best].current) best = i;
+		}
+	kinds[best].current -= total;
+	return best;
+	}
+
+static int header(char *buf, const char *type) {
+	return sprintf(buf, "%s\n{\nhop=1\nsource=" SOURCE "\ntarget=*\n}\n", type);
+	}
+
+// Malformed messages, one of each in turn. They exercise the parser error paths and the size check.
+static int render_bad(char *buf) {
+	int len;
+
+	switch (seq % 5) {
+		case 0: return sprintf(buf, "xpl-cmnd\n{\nhop=1\n");							// Cut short
+		case 1: return sprintf(buf, "this is not xPL\n");
+		case 2: return sprintf(buf, "xpl-cmnd\n{\nhop=1\nsource=\ntarget=*\n}\nhbeat.request\n{\n}\n");
+		case 3: return sprintf(buf, "xpl-cmnd\n{\nhop=1\nsource=" SOURCE "\ntarget=*\n}\nnoschema\n{\n}\n");
+		default:																		// Over the device buffer
+			len = header(buf, "xpl-cmnd");
+			len += sprintf(buf + len, "log.basic\n{\ntext=");
+			memset(buf + len, 'x', 600);
+			len += 600;
+			return len + sprintf(buf + len, "\n}\n");
+		}
+	}
+
+static int render(int kind, char *buf) {
+	int len;
+
+	switch (kind) {
+		case KIND_X10:
+			len = header(buf, "xpl-cmnd");
+			return len + sprintf(buf + len, "x10.basic\n{\ncommand=%s\ndevice=%s\n}\n",
+				x10_status ? "status_request" : seq & 1 ? "off" : "on", x10_device);
+		case KIND_HBEAT:
+			len = header(buf, "xpl-cmnd");
+			return len + sprintf(buf + len, "hbeat.request\n{\ncommand=request\n}\n");
+		case KIND_SENSOR:
+			len = header(buf, "xpl-cmnd");
+			return len + sprintf(buf + len, "sensor.request\n{\nrequest=current\ndevice=%s\n}\n", sensor_device);
+		default:
+			return render_bad(buf);
+		}
+	}
+
+static void send_kind(int kind) {
+	char buf[1024];
+	struct kind *k = &kinds[kind];
+	int len = render(kind, buf);
+	unsigned long id = seq++;
+
+	if (sendto(fd, buf, len, 0, (struct sockaddr *)&dest, sizeof(dest)) < 0) {
+		perror("sendto");
+		return;
+		}
+	k->sent++;
+
+	if (!k->replied) return;
+	if (k->count == PENDING_MAX) {			// Way behind, give up on the oldest
+		k->head = (k->head + 1) % PENDING_MAX;
+		k->count--;
+		k->lost++;
+		}
+	k->pending[(k->head + k->count) % PENDING_MAX].sent = now_ns();
+	k->pending[(k->head + k->count) % PENDING_MAX].seq = id;
+	k->count++;
+	}
+
+// Requests with no reply in time are lost
+static void expire(uint64_t now) {
+	int i;
+
+	for (i = 0; i < KINDS; i++) {
+		struct kind *k = &kinds[i];
+
+		while (k->count && (int64_t)(now - k->pending[k->head].sent) > (int64_t)timeout_ns) {
+			k->head = (k->head + 1) % PENDING_MAX;
+			k->count--;
+			k->lost++;
+			}
+		}
+	}
+
+static void matched(int kind, uint64_t now) {
+	struct kind *k = &kinds[kind];
+	unsigned long answered;
+	int i;
+
+	if (k->count == 0) return;				// Late, or not ours
+	if (k->samples == k->capacity) {
+		k->capacity = k->capacity ? k->capacity * 2 : 4096;
+		if ((k->rtt = realloc(k->rtt, k->capacity * sizeof(*k->rtt))) == NULL) {
+			perror("realloc");
+			exit(1);
+			}
+		}
+	k->rtt[k->samples++] = (now - k->pending[k->head].sent) / 1000;
+	answered = k->pending[k->head].seq;
+	k->head = (k->head + 1) % PENDING_MAX;
+	k->count--;
+	k->replies++;
+
+	for (i = 0; i < KINDS; i++) {
+		k = &kinds[i];
+		while (k->count && (long)(k->pending[k->head].seq - answered) < 0) {
+			k->head = (k->head + 1) % PENDING_MAX;
+			k->count--;
+			k->lost++;
+			}
+		}
+	}
+
+// Value of a name=value line in a message body, or NULL
+static const char *field(const char *msg, const char *name, char *value, size_t size) {
+	size_t len = strlen(name);
+	const char *p = msg, *end;
+
+	while ((p = strstr(p, name)) != NULL) {
+		if ((p == msg || p[-1] == '\n') && p[len] == '=') {
+			p += len + 1;
+			end = strchr(p, '\n');
+			if (end == NULL) end = p + strlen(p);
+			if ((size_t)(end - p) >= size) return NULL;
+			memcpy(value, p, end - p);
+			value[end - p] = '\0';
+			return value;
+			}
+		p += len;
+		}
+	return NULL;
+	}
+
+static void parse_counters(const char *msg) {
+	char value[64], *p;
+	int i;
+
+	memset(&last_counters, 0, sizeof(last_counters));
+	if (field(msg, "rx", value, sizeof(value)))
+		sscanf(value, "%lu,%lu,%lu", &last_counters.rx[0], &last_counters.rx[1], &last_counters.rx[2]);
+	if (field(msg, "drop", value, sizeof(value)))
+		sscanf(value, "%lu,%lu,%lu,%lu", &last_counters.drop[0], &last_counters.drop[1], &last_counters.drop[2], &last_counters.drop[3]);
+	for (i = 0; i < 2; i++) {					// Header lines 1 to 4, then 5 to 8
+		if (field(msg, i ? "parse5" : "parse", value, sizeof(value)) == NULL) continue;
+		for (p = value; p != NULL; ) {
+			last_counters.parse += strtoul(p, NULL, 10);
+			if ((p = strchr(p, ',')) != NULL) p++;
+			}
+		}
+	if (field(msg, "tx", value, sizeof(value)))
+		sscanf(value, "%lu,%lu", &last_counters.tx[0], &last_counters.tx[1]);
+	last_counters.valid = 1;
+	}
+
+// Sort out one packet from the device
+static void receive(const char *msg, uint64_t now) {
+	char value[64];
+	const char *schema;
+
+	if (strncmp(msg, "xpl-stat\n", 9) != 0 && strncmp(msg, "xpl-trig\n", 9) != 0) return;
+	if (field(msg, "source", value, sizeof(value)) == NULL) return;
+	if (strcmp(value, SOURCE) == 0) return;					// Our own broadcast
+	if (source != NULL && strcasecmp(value, source) != 0) return;
+
+	if ((schema = strstr(msg, "}\n")) == NULL) return;
+	schema += 2;
+
+	if (strncmp(schema, "hbeat.app\n", 10) == 0) {
+		matched(KIND_HBEAT, now);
+		}
+	else if (strncmp(schema, "sensor.basic\n", 13) == 0) {
+		if (field(schema, "device", value, sizeof(value)) && strcasecmp(value, sensor_device) == 0 && msg[4] == 's')
+			matched(KIND_SENSOR, now);						// Triggers are samples, not answers
+		}
+	else if (strncmp(schema, "x10.basic\n", 10) == 0) {
+		if (field(schema, "device", value, sizeof(value)) && strcasecmp(value, x10_device) == 0)
+			matched(KIND_X10, now);
+		}
+	else if (strncmp(schema, "esp.counters\n", 13) == 0) {
+		parse_counters(schema);
+		}
+	}
+
+// Read whatever has come in, waiting up to wait_ns for the first packet
+static void poll_replies(uint64_t wait_ns) {
+	struct pollfd pfd = { fd, POLLIN, 0 };
+	struct timespec ts = { wait_ns / 1000000000ULL, wait_ns % 1000000000ULL };
+	char buf[2048];
+	ssize_t len;
+
+	if (ppoll(&pfd, 1, &ts, NULL) <= 0) return;
+	while ((len = recv(fd, buf, sizeof(buf) - 1, MSG_DONTWAIT)) >= 0) {
+		buf[len] = '\0';
+		receive(buf, now_ns());
+		}
+	}
+
+// Ask the device for esp.counters, false if it did not answer
+static int read_counters(struct counters *counters) {
+	char buf[256];
+	int len = header(buf, "xpl-cmnd");
+	uint64_t end;
+
+	len += sprintf(buf + len, "esp.request\n{\nquery=counters\n}\n");
+	last_counters.valid = 0;
+	sendto(fd, buf, len, 0, (struct sockaddr *)&dest, sizeof(dest));
+
+	for (end = now_ns() + timeout_ns; !last_counters.valid && now_ns() < end; )
+		poll_replies(10000000);
+	*counters = last_counters;
+	return counters->valid;
+	}
+
+static int compare(const void *a, const void *b) {
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+	}
+
+static uint32_t percentile(struct kind *k, double p) {
+	unsigned long i = (unsigned long)(p * k->samples + 0.999999);
+
+	return k->rtt[i ? i - 1 : 0];
+	}
+
+static void report(double seconds, struct counters *before, struct counters *after) {
+	unsigned long sent = 0, replies = 0;
+	int i;
+
+	for (i = 0; i < KINDS; i++) {
+		sent += kinds[i].sent;
+		replies += kinds[i].replies;
+		}
+	printf("sent %lu in %.2f s (%.1f/s), %lu replies (%.1f/s)\n", sent, seconds, sent / seconds, replies, replies / seconds);
+	printf("kind        sent  replies     lost   loss%%   p50 us   p99 us  p999 us      max\n");
+
+	for (i = 0; i < KINDS; i++) {
+		struct kind *k = &kinds[i];
+
+		if (k->sent == 0) continue;
+		if (!k->replied) {
+			printf("%-6s %9lu        -        -       -\n", k->name, k->sent);
+			continue;
+			}
+		printf("%-6s %9lu %8lu %8lu %7.2f", k->name, k->sent, k->replies, k->lost, 100.0 * k->lost / k->sent);
+		if (k->samples) {
+			qsort(k->rtt, k->samples, sizeof(*k->rtt), compare);
+			printf(" %8u %8u %8u %8u", percentile(k, 0.50), percentile(k, 0.99), percentile(k, 0.999), k->rtt[k->samples - 1]);
+			}
+		printf("\n");
+		}
+
+	if (before->valid && after->valid) {
+		// The counters request in between is one more received
+		printf("device: received %lu of %lu, handled %lu, dropped %lu/%lu/%lu/%lu (empty/size/nomem/full), parse failures %lu, sent %lu, send errors %lu\n",
+			after->rx[0] - before->rx[0] - 1, sent, after->rx[2] - before->rx[2] - 1,
+			after->drop[0] - before->drop[0], after->drop[1] - before->drop[1],
+			after->drop[2] - before->drop[2], after->drop[3] - before->drop[3],
+			after->parse - before->parse, after->tx[0] - before->tx[0], after->tx[1] - before->tx[1]);
+		}
+	}
+
+// Weights of the kinds, none negative and not all 0
+static void parse_mix(char *mix) {
+	char *item, *eq;
+	int i, total = 0;
+
+	for (i = 0; i < KINDS; i++) kinds[i].weight = 0;
+	for (item = strtok(mix, ","); item != NULL; item = strtok(NULL, ",")) {
+		if ((eq = strchr(item, '=')) == NULL) usage();
+		*eq = '\0';
+		for (i = 0; i < KINDS && strcmp(item, kinds[i].name) != 0; i++)
+			;
+		if (i == KINDS) usage();
+		kinds[i].weight = atoi(eq + 1);
+		if (kinds[i].weight < 0) usage();
+		}
+	for (i = 0; i < KINDS; i++) total += kinds[i].weight;
+	if (total == 0) usage();
+	}
+
+int main(int argc, char **argv) {
+	double rate = 100, duration = 10;
+	unsigned long count = 0, n;
+	unsigned short port = 3865;
+	unsigned char query = 1;
+	struct sockaddr_in sin;
+	struct counters before = { 0 }, after = { 0 };
+	uint64_t start, next, period, end, now;
+	char *p;
+	int opt, on = 1, i;
+
+	dest.sin_family = AF_INET;
+	dest.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+	dest.sin_port = htons(3865);
+
+	while ((opt = getopt(argc, argv, "t:l:r:d:n:m:D:u:s:xw:q")) != -1) {
+		switch (opt) {
+			case 't':
+				if ((p = strchr(optarg, ':')) != NULL) {
+					*p++ = '\0';
+					dest.sin_port = htons(atoi(p));
+					}
+				if (inet_pton(AF_INET, optarg, &dest.sin_addr) != 1) usage();
+				break;
+			case 'l': port = atoi(optarg); break;
+			case 'r': rate = atof(optarg); break;
+			case 'd': duration = atof(optarg); break;
+			case 'n': count = strtoul(optarg, NULL, 10); break;
+			case 'm': parse_mix(optarg); break;
+			case 'D': source = optarg; break;
+			case 'u': x10_device = optarg; break;
+			case 's': sensor_device = optarg; break;
+			case 'x': x10_status = 1; break;
+			case 'w': timeout_ns = strtoull(optarg, NULL, 10) * 1000000ULL; break;
+			case 'q': query = 0; break;
+			default: usage();
+			}
+		}
+	if (rate <= 0) usage();
+	kinds[KIND_X10].replied = x10_status;
+
+	if ((fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+		perror("socket");
+		return 1;
+		}
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+	setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(port);
+	if (bind(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0) {
+		perror("bind");
+		return 1;
+		}
+
+	if (query && !read_counters(&before)) {
+		fprintf(stderr, "no answer to esp.request, carrying on without the device counters\n");
+		}
+
+	// Send on a fixed schedule, catching up in bursts if we fall behind
+	period = 1000000000.0 / rate;
+	start = next = now_ns();
+	end = start + (uint64_t)(duration * 1e9);
+	for (n = 0; count ? n < count : next < end; ) {
+		now = now_ns();
+		for (i = 0; next <= now && i < 64 && (count ? n < count : next < end); i++, n++) {
+			send_kind(next_kind());
+			next += period;
+			}
+		expire(now_ns());
+		if (next > now) poll_replies(next - now);
+		else poll_replies(0);
+		}
+	now = now_ns();
+
+	// Give the stragglers time to come in
+	for (end = now_ns() + timeout_ns; now_ns() < end; ) {
+		poll_replies(10000000);
+		expire(now_ns());
+		}
+	for (i = 0; i < KINDS; i++) {
+		kinds[i].lost += kinds[i].count;
+		kinds[i].count = 0;
+		}
+
+	if (query) read_counters(&after);
+	report((now - start) / 1e9, &before, &after);
+	return 0;
+	}
@@ -0,0 +1,125 @@
+/*
+* xPL for ESP8266
+*
+* Battery trigger mode
+*
+* The device spends its life in deep sleep. It wakes up either on the sleep timer
+* (GPIO16 tied to RST) or when the contact pulses RST through the usual RC network.
+* On an input wake up we send an x10.basic trigger for the current state of INPUT_GPIO,
+* on a timer wake up a heartbeat. Then it is straight back to sleep.
+* None of the xPL tasks are started, and the link comes up through the fast boot path.
+*
+* The trigger frame is rendered once, on a cold boot, and kept in RTC memory.
+* On a wake up only the state is appended to it before it goes out.
+*
+* Wake to packet latency and awake time are measured on each wake up and kept in RTC memory.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "esp_common.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "UserConfig.h"
+#include "xPL.h"
+#include "WifiMgr.h"
+#include "Battery.h"
+#include "Telemetry.h"
+
+#if BATTERY_MODE && !FAST_BOOT
+#error "BATTERY_MODE needs FAST_BOOT"
+#endif
+
+static struct battery_state bat;
+static unsigned char send_trigger;		// Input wake up, as opposed to a timer one
+
+// Render the trigger frame up to the command value
+static void ICACHE_FLASH_ATTR battery_render(void) {
+	bat.frame_len = sprintf(bat.frame,
+		"xpl-trig\n{\n"
+		"hop=1\n"
+		"source=%s-%s.%s\n"
+		"target=*\n}\n"
+		"x10.basic\n{\n"
+		"device=%c%d\n"
+		"command="
+		, xPL_VENDORID, xPL_DEVICEID, xPL_INSTANCEID, MYHOUSE, MYUNIT);
+	}
+
+// Record our timings and go to sleep
+static void ICACHE_FLASH_ATTR battery_sleep(void) {
+	vTaskDelay(BATTERY_TX_DELAY);			// Give the Wi-Fi driver time to get the packet out
+
+	bat.last_awake = system_get_time();
+	bat.sum_awake += bat.last_awake;
+	system_rtc_mem_write(BATTERY_RTC_BLOCK, &bat, sizeof(bat));
+
+	printf("Wake %d: packet after %d us, awake %d us\n", bat.wakes, bat.last_latency, bat.last_awake);
+	system_deep_sleep(BATTERY_SLEEP_TIME * 1000000);
+	}
+
+// Link is up, send our message
+static void ICACHE_FLASH_ATTR battery_link_up(bool first) {
+	if (send_trigger) {
+		bat.last_state = (GPIO_REG_READ(GPIO_IN_ADDRESS) & INPUT_GPIO) == 0;		// Closed contact is "on"
+		strcpy(bat.frame + bat.frame_len, bat.last_state ? "on\n}\n" : "off\n}\n");
+		xPL_SendMessageBuf(bat.frame);
+		}
+	else {
+		xPL_SendHBeat();
+		}
+
+	bat.last_latency = system_get_time();
+	bat.sum_latency += bat.last_latency;
+	bat.wakes++;
+	battery_sleep();
+	}
+
+static void ICACHE_FLASH_ATTR battery_link_down(void) {
+	}
+
+// Watchdog, in case the link never comes up
+static void ICACHE_FLASH_ATTR battery_task(void *pvParameters) {
+	vTaskDelay(BATTERY_AWAKE_MAX);
+	printf("No link, back to sleep\n");
+	bat.last_latency = 0;
+	battery_sleep();
+	}
+
+// Entry point in battery mode, replaces the normal start up
+void ICACHE_FLASH_ATTR battery_init(void) {
+	struct rst_info *reset = system_get_rst_info();
+
+	system_rtc_mem_read(BATTERY_RTC_BLOCK, &bat, sizeof(bat));
+	if (bat.magic != BATTERY_MAGIC) {				// Cold boot
+		memset(&bat, 0, sizeof(bat));
+		bat.magic = BATTERY_MAGIC;
+		battery_render();
+		}
+
+	send_trigger = reset->reason != REASON_DEEP_SLEEP_AWAKE;		// Anything but the sleep timer means the input woke us
+
+	xPL_SetSource(xPL_VENDORID, xPL_DEVICEID, xPL_INSTANCEID);
+	xPL_device.instance[0].hbeat_interval = BATTERY_SLEEP_TIME;
+
+	wifi_mgr_init(battery_link_up, battery_link_down);
+	telem_task_create(battery_task, "bat", 128);
+	}
+
+void ICACHE_FLASH_ATTR battery_get_stats(struct battery_state *stats) {
+	*stats = bat;
+	}
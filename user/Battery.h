@@ -0,0 +1,50 @@
+/*
+* xPL for ESP8266
+*
+* Battery trigger mode: wake up, send one message, go back to deep sleep
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef Battery_h
+#define Battery_h
+
+#include "esp_common.h"
+#include "FastBoot.h"
+
+#define BATTERY_RTC_BLOCK		(FASTBOOT_RTC_BLOCK + sizeof(struct fastboot_state) / 4)
+#define BATTERY_MAGIC			0x78504C42	// "xPLB"
+#define BATTERY_FRAME_MAX		160			// Room for the pre-rendered trigger
+
+// Kept in RTC memory across deep sleeps. Must stay a multiple of 4 bytes.
+struct battery_state {
+	uint32 magic;
+	uint32 wakes;					// Number of wake ups with a message sent
+	uint32 last_latency;			// Wake to packet handed to the stack, us, last wake up
+	uint32 last_awake;				// Total awake time, us, last wake up
+	uint32 sum_latency;				// Totals, to compute averages
+	uint32 sum_awake;
+	uint16 frame_len;				// Length of the rendered frame, up to and including "command="
+	uint8 last_state;				// Last input state we reported
+	uint8 pad;
+	char frame[BATTERY_FRAME_MAX];
+	};
+
+void battery_init(void);
+void battery_get_stats(struct battery_state *stats);
+
+#endif
@@ -1,13 +1,24 @@
 /*
 * xPL for ESP8266
 *
-* This file holds a simple debouncing routine
-* See below for original author
+* This file holds the input debouncing routines
 * 
-* It runs as a task under FreeRTOS, and gets called every 100ms 
-* A counter is incremented or decremented depending on the value of the input GPIO pin
-* When the counter reaches 0, or a Maximun count, the input is deemed to have changed and
-* a trigger is sent.
+* All the inputs listed in the input map are debounced together. The GPIO input register
+* is read once per sample, and each bit goes through its own 2 bit vertical counter.
+* An input is deemed to have changed once it has read the same new level 4 samples in a row,
+* and the trigger configured for it in the map is sent.
+*
+* Without DEBOUNCE_IRQ, this runs as a task under FreeRTOS, and gets called every 100ms.
+*
+* With DEBOUNCE_IRQ set, nothing runs until the GPIO interrupt sees an edge on one of the inputs.
+* The edge starts a software timer which samples the inputs every DEBOUNCE_SAMPLE_MS.
+* Once they have been stable for DEBOUNCE_IDLE_SAMPLES, the timer is stopped and
+* the interrupt enabled again. The task only wakes up to send the triggers.
+*
+* With EVENT_LOOP set, the task is replaced by handlers and timers in the event loop.
+*
+* The input map defaults to INPUT_MAP, and can be changed at run time with an xPL
+* config.response message. It is then saved to flash.
 
 * Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
 *
@@ -33,84 +44,434 @@
 #include <stdio.h>
 #include <string.h>
 #include "UserConfig.h"
+#include "xPL.h"
+#include "Debounce.h"
+#include "State.h"
+#include "EventLoop.h"
+#include "Telemetry.h"
 
+#define INPUT_MAP_MAGIC	0x78504C49		// "xPLI"
 
-/******************************************************************************
-
-debounce.c
-written by Kenneth A. Kuhn
-version 1.00
-
-This is an algorithm that debounces or removes random or spurious
-transistions of a digital signal read as an input by a computer.  This is
-particularly applicable when the input is from a mechanical contact.  An
-integrator is used to perform a time hysterisis so that the signal must
-persistantly be in a logical state (0 or 1) in order for the output to change
-to that state.  Random transitions of the input will not affect the output
-except in the rare case where statistical clustering is longer than the
-specified integration time.
+// The input map, as saved in flash
+struct input_map {
+	uint32 magic;
+	struct input_channel inputs[INPUT_MAX];
+	};
 
-The following example illustrates how this algorithm works.  The sequence
-labeled, real signal, represents the real intended signal with no noise.  The
-sequence labeled, corrupted, has significant random transitions added to the
-real signal.  The sequence labled, integrator, represents the algorithm
-integrator which is constrained to be between 0 and 3.  The sequence labeled,
+// IO mux register and GPIO function for each pin, 0 for the ones we can't use
+static const struct {
+	uint32 reg;
+	uint8 func;
+	} pin_mux[16] = {
+	{ PERIPHS_IO_MUX_GPIO0_U, FUNC_GPIO0 },
+	{ PERIPHS_IO_MUX_U0TXD_U, FUNC_GPIO1 },
+	{ PERIPHS_IO_MUX_GPIO2_U, FUNC_GPIO2 },
+	{ PERIPHS_IO_MUX_U0RXD_U, FUNC_GPIO3 },
+	{ PERIPHS_IO_MUX_GPIO4_U, FUNC_GPIO4 },
+	{ PERIPHS_IO_MUX_GPIO5_U, FUNC_GPIO5 },
+	{ 0, 0 }, { 0, 0 }, { 0, 0 },				// 6 to 8 are used by the flash
+	{ PERIPHS_IO_MUX_SD_DATA2_U, FUNC_GPIO9 },
+	{ PERIPHS_IO_MUX_SD_DATA3_U, FUNC_GPIO10 },
+	{ 0, 0 },
+	{ PERIPHS_IO_MUX_MTDI_U, FUNC_GPIO12 },
+	{ PERIPHS_IO_MUX_MTCK_U, FUNC_GPIO13 },
+	{ PERIPHS_IO_MUX_MTMS_U, FUNC_GPIO14 },
+	{ PERIPHS_IO_MUX_MTDO_U, FUNC_GPIO15 },
+	};
 
-output, only makes a transition when the integrator reaches either 0 or 3.
-Note that the output signal lags the input signal by the integration time but
-is free of spurious transitions.
+static struct input_map map = { INPUT_MAP_MAGIC, INPUT_MAP };
+static uint32 input_mask;				// All the GPIO bits in the map
 
-real signal 0000111111110000000111111100000000011111111110000000000111111100000
-
-corrupted   0100111011011001000011011010001001011100101111000100010111011100010
-integrator  0100123233233212100012123232101001012321212333210100010123233321010
-output      0000001111111111100000001111100000000111111111110000000001111111000
-
-I have been using this algorithm for years and I show it here as a code
-fragment in C.  The algorithm has been around for many years but does not seem
-to be widely known.  Once in a rare while it is published in a tech note.  It
-is notable that the algorithm uses integration as opposed to edge logic
-(differentiation).  It is the integration that makes this algorithm so robust
-in the presence of noise.
-******************************************************************************/
-
-
-// Threshold for trigger detection
-#define THRESHOLD 4
+// Vertical counters, one bit per GPIO
+static uint32 cnt0, cnt1;
+static uint32 debounced = 0xFFFF;		// Debounced level of each input, contacts start open (pulled up)
+static uint32 counts[INPUT_MAX];		// Closures of the INPUT_COUNTER inputs
 
 extern void xPL_send_trigger(unsigned char house, unsigned char unit, unsigned char state);
+extern void xPL_send_input(unsigned char house, unsigned char unit, unsigned char state);
+
+// Take one sample of all the inputs, returns the bits that changed state
+// No ICACHE_FLASH_ATTR here, we want this routine to reside in RAM since it gets called so often
+static uint32 debounce_sample(void) {
+	uint32 delta = (GPIO_REG_READ(GPIO_IN_ADDRESS) ^ debounced) & input_mask;
+	uint32 changed;
+
+	cnt1 = (cnt1 ^ cnt0) & delta;			// Count the samples that differ from the debounced level,
+	cnt0 = ~cnt0 & delta;					// back to 0 as soon as one agrees with it
+	changed = delta & ~(cnt0 | cnt1);		// Counter wrapped, 4 samples in a row
+	debounced ^= changed;
+	return changed;
+	}
+
+// Send the messages for the inputs that changed
+static void ICACHE_FLASH_ATTR debounce_send(uint32 changed, uint32 state) {
+	unsigned char i;
+
+	for (i = 0; i < INPUT_MAX; i++) {
+		if (changed & map.inputs[i].gpio) {
+			unsigned char closed = (state & map.inputs[i].gpio) == 0;
+			signed char idx = state_find(0, map.inputs[i].house, map.inputs[i].unit, true);
+
+			if (idx >= 0) state_set(idx, closed, 0);
+
+			if (map.inputs[i].schema == INPUT_COUNTER) {
+				if (closed) counts[i]++;
+				}
+			else if (map.inputs[i].schema == INPUT_SENSOR) {
+				xPL_send_input(map.inputs[i].house, map.inputs[i].unit, closed);
+				}
+			else {
+				xPL_send_trigger(map.inputs[i].house, map.inputs[i].unit, closed);
+				}
+			}
+		}
+	}
+
+// Switch a pin to its GPIO function, with or without the pull up. Returns false for the pins we can't use.
+bool ICACHE_FLASH_ATTR pin_select_gpio(unsigned char pin, bool pullup) {
+	if (pin > 15 || pin_mux[pin].reg == 0)
+		return false;
+
+	PIN_FUNC_SELECT(pin_mux[pin].reg, pin_mux[pin].func);
+	if (pullup) {
+		PIN_PULLUP_EN(pin_mux[pin].reg);
+		}
+	else {
+		PIN_PULLUP_DIS(pin_mux[pin].reg);
+		}
+	return true;
+	}
+
+// Set up the pins in mask as inputs with their pull ups
+static void ICACHE_FLASH_ATTR debounce_pins(uint32 mask) {
+	unsigned char pin;
+
+	for (pin = 0; pin < 16; pin++) {
+		if (mask & (1 << pin)) {
+			pin_select_gpio(pin, true);
+			}
+		}
+	gpio_output_set(0, 0, 0, mask);			// Set pins for input
+	}
+
+// Rebuild the mask after a change to the map, and make sure the state table knows about the inputs
+static void ICACHE_FLASH_ATTR debounce_map_changed(void) {
+	unsigned char i;
+
+	input_mask = 0;
+	for (i = 0; i < INPUT_MAX; i++) {
+		input_mask |= map.inputs[i].gpio;
+		if (map.inputs[i].gpio && map.inputs[i].schema != INPUT_COUNTER) {
+			state_add(map.inputs[i].schema == INPUT_SENSOR ? STATE_SENSOR : STATE_INPUT, 0,
+				map.inputs[i].house, map.inputs[i].unit, 0, (debounced & map.inputs[i].gpio) == 0);
+			}
+		}
+	debounce_pins(input_mask);
+	}
 
-// No ICACHE_FLASH_ATTR here, we want this routine to reside in RAM since it gets called so often
-
+#if EVENT_LOOP
+
+static struct ev_timer retry_timer;
+static uint32 unsent;					// Changes we could not send while the link was down
+
+// The loop can't block until the link is back, keep the changes and retry later
+static void ICACHE_FLASH_ATTR debounce_deliver(uint32 changed) {
+	unsent |= changed;
+	if (!xPL_LinkUp()) {
+		ev_timer_add(&retry_timer, DEBOUNCE_RETRY_TICKS);
+		return;
+		}
+
+	debounce_send(unsent, debounced);
+	unsent = 0;
+	}
+
+static void ICACHE_FLASH_ATTR debounce_retry(struct ev_timer *timer) {
+	debounce_deliver(0);
+	}
+
+#endif
+
+#if DEBOUNCE_IRQ
+
+// Event passed to the task. A changed mask of 0 is an edge from the interrupt.
+struct deb_event {
+	uint32 changed;
+	uint32 state;
+	};
+
+#if !EVENT_LOOP
+static xQueueHandle debQ;
+#endif
+static os_timer_t sample_timer;
+static unsigned char idle = 0;
+
+// Enable or disable the edge interrupt on all the pins in mask
+static void debounce_irq(uint32 mask, bool enable) {
+	unsigned char pin;
+
+	for (pin = 0; pin < 16; pin++) {
+		if (mask & (1 << pin)) {
+			gpio_pin_intr_state_set(GPIO_ID_PIN(pin), enable ? GPIO_PIN_INTR_ANYEDGE : GPIO_PIN_INTR_DISABLE);
+			}
+		}
+	}
+
+// GPIO interrupt. Stop listening to the bounces and wake up the task, it will start the sampling.
+static void debounce_isr(void *arg) {
+	uint32 status = GPIO_REG_READ(GPIO_STATUS_ADDRESS);
+	portBASE_TYPE woken = pdFALSE;
+#if !EVENT_LOOP
+	struct deb_event event = { 0, 0 };
+#endif
+
+	GPIO_REG_WRITE(GPIO_STATUS_W1TC_ADDRESS, status);
+
+	if (status & input_mask) {
+		debounce_irq(input_mask, false);
+#if EVENT_LOOP
+		ev_post_from_isr(EV_INPUT, 0, NULL, &woken);
+#else
+		xQueueSendFromISR(debQ, &event, &woken);
+#endif
+		}
+	portEND_SWITCHING_ISR(woken);
+	}
+
+// Sample timer
+static void debounce_tick(void *arg) {
+	struct deb_event event;
+
+	event.changed = debounce_sample();
+	if (event.changed) {
+		event.state = debounced;
+#if EVENT_LOOP
+		ev_post(EV_INPUT, event.changed, NULL);		// Let the loop send the triggers
+#else
+		xQueueSendToBack(debQ, &event, 0);			// Let the task send the triggers
+#endif
+		}
+
+	if (cnt0 | cnt1) {								// Still bouncing
+		idle = 0;
+		return;
+		}
+
+	if (++idle < DEBOUNCE_IDLE_SAMPLES)
+		return;
+
+	// Inputs settled, stop sampling until the next edge
+	os_timer_disarm(&sample_timer);
+	idle = 0;
+	debounce_irq(input_mask, true);
+
+	if ((GPIO_REG_READ(GPIO_IN_ADDRESS) ^ debounced) & input_mask) {	// Changed before the interrupt was back on, keep going
+		debounce_irq(input_mask, false);
+		os_timer_arm(&sample_timer, DEBOUNCE_SAMPLE_MS, 1);
+		}
+	}
+
+#if EVENT_LOOP
+
+static void ICACHE_FLASH_ATTR debounce_event(uint32 changed, void *data) {
+	if (changed == 0) {
+		os_timer_arm(&sample_timer, DEBOUNCE_SAMPLE_MS, 1);
+		}
+	else {
+		debounce_deliver(changed);
+		}
+	}
+
+#else
+
+void ICACHE_FLASH_ATTR DebounceTask(void *Stuff) {
+	struct deb_event event;
+
+	for (;;) {
+		xQueueReceive(debQ, &event, portMAX_DELAY);
+
+		if (event.changed == 0) {
+			os_timer_arm(&sample_timer, DEBOUNCE_SAMPLE_MS, 1);
+			}
+		else {
+			uint32 busy;
+
+			xPL_WaitLink();							// No point sending triggers while the link is down
+			busy = telem_start();
+			debounce_send(event.changed, event.state);
+			telem_stop(busy);
+			}
+		}
+	}
+
+#endif
+
+static void ICACHE_FLASH_ATTR debounce_start(void) {
+#if EVENT_LOOP
+	ev_set_handler(EV_INPUT, debounce_event);
+#else
+	debQ = xQueueCreate(4, sizeof(struct deb_event));
+#endif
+	os_timer_setfn(&sample_timer, debounce_tick, NULL);
+
+	_xt_isr_attach(ETS_GPIO_INUM, debounce_isr, NULL);
+	debounce_irq(input_mask, true);
+	_xt_isr_unmask(1 << ETS_GPIO_INUM);
+
+	if ((GPIO_REG_READ(GPIO_IN_ADDRESS) ^ debounced) & input_mask) {		// Already closed, debounce it now
+		os_timer_arm(&sample_timer, DEBOUNCE_SAMPLE_MS, 1);
+		}
+	}
+
+#elif EVENT_LOOP
+
+static struct ev_timer sample_timer;
+
+static void ICACHE_FLASH_ATTR debounce_tick(struct ev_timer *timer) {
+	uint32 changed = debounce_sample();
+
+	if (changed) {
+		debounce_deliver(changed);
+		}
+	ev_timer_add(timer, 10);					// 1/10 s
+	}
+
+static void ICACHE_FLASH_ATTR debounce_start(void) {
+	sample_timer.fn = debounce_tick;
+	ev_timer_add(&sample_timer, 10);
+	}
+
+#else
+
 void DebounceTask(void *Stuff) {
-	unsigned char b0 = 0, Button0 = 0;
 	portTickType xLastWakeTime = xTaskGetTickCount();
-
-	gpio_output_set(0, 0, 0, INPUT_GPIO);			// Set pin for input
+	uint32 changed, busy;
 
 	for (;;) {
 		// Wait for the next cycle.
 		vTaskDelayUntil(&xLastWakeTime, 10);		// 1/10 s
 
-		if (GPIO_REG_READ(GPIO_IN_ADDRESS) & INPUT_GPIO) {
-			if (b0 > 0) b0--;						// Decrement the counter if contact is open
-			}
-		else {
-			if (b0 < THRESHOLD) b0++;				// Increment if closed
-			}
-
-		if (b0 == 0 && Button0 != 0) {				
-			Button0 = 0;
-			xPL_send_trigger(MYHOUSE, MYUNIT, 0);			// Send off trigger
-			}
-
-		if (b0 >= THRESHOLD && Button0 != 1) {
-			Button0 = 1;
-			xPL_send_trigger(MYHOUSE, MYUNIT, 1);			// Send on trigger
+		if (xPL_WaitLink()) {						// No point sending triggers while the link is down
+			xLastWakeTime = xTaskGetTickCount();
+			}
+
+		busy = telem_start();
+		changed = debounce_sample();
+		if (changed) {
+			debounce_send(changed, debounced);
 			}
+		telem_stop(busy);
 		}
-    }
-    
-void ICACHE_FLASH_ATTR debounce_init(void) {
-	xTaskCreate(DebounceTask, "Deb", 256, NULL, 2, NULL);
+	}
+
+static void ICACHE_FLASH_ATTR debounce_start(void) {
 	}
+
+#endif
+
+/**
+* \brief     Map an input pin to an xPL device
+* \details   The map is saved to flash, and the pin set up right away
+* \param     pin       GPIO number
+* \param     schema    INPUT_X10 or INPUT_SENSOR
+* \param     house     X10 house code A to P, 0 to remove the pin from the map
+* \param     unit      X10 unit, 1 to 16
+*/
+bool ICACHE_FLASH_ATTR debounce_set_input(unsigned char pin, unsigned char schema, char house, unsigned char unit) {
+	struct input_channel *slot = NULL;
+	unsigned char i;
+
+	if (pin > 15 || pin_mux[pin].reg == 0)
+		return false;
+
+	if (house && (house < 'A' || house > 'P' || unit < 1 || unit > 16))
+		return false;
+
+	for (i = 0; i < INPUT_MAX; i++) {
+		if (map.inputs[i].gpio == (1 << pin)) {
+			slot = &map.inputs[i];
+			break;
+			}
+		if (map.inputs[i].gpio == 0 && slot == NULL) {
+			slot = &map.inputs[i];
+			}
+		}
+
+	if (slot == NULL)
+		return false;
+
+	slot->gpio = house ? 1 << pin : 0;
+	slot->schema = schema;
+	slot->house = house;
+	slot->unit = unit;
+
+	debounce_map_changed();
+#if DEBOUNCE_IRQ
+	debounce_irq(input_mask, true);
+#endif
+	system_param_save_with_protect(INPUT_MAP_SECTOR, &map, sizeof(map));
+	return true;
+	}
+
+/**
+* \brief     Apply an input=... line from a config.response message
+* \details   Format is pin,device[,sensor|counter], e.g. "4,C2" or "5,C3,sensor". "4,-" removes pin 4.
+*/
+bool ICACHE_FLASH_ATTR debounce_config(const char *value) {
+	const char *device = strchr(value, ',');
+	unsigned char schema;
+	char house;
+	int unit;
+
+	if (device == NULL)
+		return false;
+
+	device++;
+	if (*device == '-')
+		return debounce_set_input(atoi(value), INPUT_X10, 0, 0);
+
+	house = *device >= 'a' && *device <= 'z' ? *device - 'a' + 'A' : *device;
+	if (house < 'A' || house > 'P')
+		return false;
+
+	unit = atoi(device + 1);
+	if (unit < 1 || unit > 16)					// Checked before it gets cut down to a byte
+		return false;
+
+	schema = strstr(device, ",sensor") ? INPUT_SENSOR : strstr(device, ",counter") ? INPUT_COUNTER : INPUT_X10;
+	return debounce_set_input(atoi(value), schema, house, unit);
+	}
+
+// Debounced level of the inputs, a 0 bit is a closed contact
+uint32 ICACHE_FLASH_ATTR debounce_state(void) {
+	return debounced & input_mask;
+	}
+
+// Closures counted on an INPUT_COUNTER pin, for the sensor code
+sint32 ICACHE_FLASH_ATTR debounce_count(uint8 pin) {
+	unsigned char i;
+
+	for (i = 0; i < INPUT_MAX; i++) {
+		if (map.inputs[i].gpio == (1 << pin)) {
+			return counts[i];
+			}
+		}
+	return 0;
+	}
+
+void ICACHE_FLASH_ATTR debounce_init(void) {
+	struct input_map saved;
+
+	if (system_param_load(INPUT_MAP_SECTOR, 0, &saved, sizeof(saved)) && saved.magic == INPUT_MAP_MAGIC) {
+		map = saved;							// Use the map set through xPL over the built in one
+		}
+
+	debounce_map_changed();
+	debounce_start();
+
+#if EVENT_LOOP
+	retry_timer.fn = debounce_retry;
+#else
+	telem_task_create(DebounceTask, "Deb", 256);
+#endif
+	}
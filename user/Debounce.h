@@ -0,0 +1,50 @@
+/*
+* xPL for ESP8266
+*
+* Input debouncing and input to xPL device mapping
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef Debounce_h
+#define Debounce_h
+
+#include "esp_common.h"
+
+#define INPUT_MAX		8
+
+// What gets sent when an input changes
+#define INPUT_X10		0		// x10.basic trigger, on when the contact is closed
+#define INPUT_SENSOR	1		// sensor.basic trigger, type=input, current=high or low
+#define INPUT_COUNTER	2		// Nothing sent, contact closures are counted for the sensor code
+
+// One entry of the input map
+struct input_channel {
+	uint16 gpio;				// GPIO bit (BITn)
+	uint8 schema;				// INPUT_X10, INPUT_SENSOR or INPUT_COUNTER
+	uint8 unit;					// X10 unit
+	char house;					// X10 house code
+	};
+
+void debounce_init(void);
+bool debounce_set_input(unsigned char pin, unsigned char schema, char house, unsigned char unit);
+bool debounce_config(const char *value);
+uint32 debounce_state(void);
+sint32 debounce_count(uint8 pin);
+bool pin_select_gpio(unsigned char pin, bool pullup);
+
+#endif
@@ -0,0 +1,205 @@
+/*
+* xPL for ESP8266
+*
+* Dimmers
+*
+* The outputs in DIM_MAP are driven by a software PWM, timed by the FRC1 hardware timer.
+* At the start of each DIM_PWM_US period, all the outputs with a level above 0 are turned on,
+* and the timer is loaded for the first of the sorted off edges. Each interrupt turns off the
+* outputs due at that edge and reloads the timer for the next one.
+*
+* Fades also run in the interrupt: once per period, each output moves DIM_FADE_STEP levels
+* closer to its target. The tasks only ever set the target, so a fade carries on at the same
+* pace whatever the network and the other tasks are doing.
+* The timer stops once all the outputs are off and settled.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "esp_common.h"
+#include <string.h>
+#include "UserConfig.h"
+#include "Debounce.h"
+#include "Dimmer.h"
+
+#if DIMMER
+
+#define DIM_PERIOD		(DIM_PWM_US * 5)		// In FRC1 ticks, 80 MHz / 16
+#define DIM_TICKS		(DIM_PERIOD / DIM_FULL)	// Ticks per level
+#define DIM_MIN_TICKS	50						// Edges closer than 10 us are merged
+
+static const struct dim_channel channels[] = DIM_MAP;
+#define DIM_COUNT		(sizeof(channels) / sizeof(channels[0]))
+
+static struct {
+	volatile uint8 level;			// Current level, only changed by the interrupt
+	volatile uint8 target;			// Level we are fading to
+	uint8 last_on;					// Level to go back to on ON
+	} dim[DIM_COUNT];
+
+// Off edges for the current period, sorted
+static uint32 edge_ticks[DIM_COUNT];
+static uint16 edge_mask[DIM_COUNT];
+static unsigned char edge_count, edge_next;
+static volatile bool running;
+
+// Move each output one step closer to its target. Returns false once everything is off and settled.
+static bool dimmer_fade(void) {
+	unsigned char i;
+	bool busy = false;
+
+	for (i = 0; i < DIM_COUNT; i++) {
+		uint8 level = dim[i].level, target = dim[i].target;
+
+		if (level < target) {
+			level = target - level > DIM_FADE_STEP ? level + DIM_FADE_STEP : target;
+			}
+		else if (level > target) {
+			level = level - target > DIM_FADE_STEP ? level - DIM_FADE_STEP : target;
+			}
+		dim[i].level = level;
+		busy |= level != 0 || target != 0;
+		}
+	return busy;
+	}
+
+// Build the off edges for the next period, returns the outputs to turn on
+static uint32 dimmer_schedule(void) {
+	uint32 on = 0, ticks;
+	unsigned char i, j;
+
+	edge_count = edge_next = 0;
+	for (i = 0; i < DIM_COUNT; i++) {
+		if (dim[i].level == 0)
+			continue;
+
+		on |= channels[i].gpio;
+		if (dim[i].level == DIM_FULL)			// Never turned off
+			continue;
+
+		ticks = dim[i].level * DIM_TICKS;
+		if (ticks < DIM_MIN_TICKS) ticks = DIM_MIN_TICKS;
+
+		for (j = 0; j < edge_count && edge_ticks[j] + DIM_MIN_TICKS <= ticks; j++);
+
+		if (j < edge_count && edge_ticks[j] < ticks + DIM_MIN_TICKS) {		// Close enough to an existing edge
+			edge_mask[j] |= channels[i].gpio;
+			continue;
+			}
+
+		memmove(&edge_ticks[j + 1], &edge_ticks[j], (edge_count - j) * sizeof(edge_ticks[0]));
+		memmove(&edge_mask[j + 1], &edge_mask[j], (edge_count - j) * sizeof(edge_mask[0]));
+		edge_ticks[j] = ticks;
+		edge_mask[j] = channels[i].gpio;
+		edge_count++;
+		}
+	return on;
+	}
+
+// FRC1 interrupt, at each off edge and at the start of each period
+// No ICACHE_FLASH_ATTR here, interrupt code has to be in RAM
+static void dimmer_isr(void *arg) {
+	uint32 at;
+
+	RTC_CLR_REG_MASK(FRC1_INT_ADDRESS, FRC1_INT_CLR_MASK);
+
+	if (edge_next < edge_count) {				// Off edge
+		GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, edge_mask[edge_next]);
+		at = edge_ticks[edge_next++];
+		RTC_REG_WRITE(FRC1_LOAD_ADDRESS, (edge_next < edge_count ? edge_ticks[edge_next] : DIM_PERIOD) - at);
+		return;
+		}
+
+	// Start of a period
+	if (!dimmer_fade()) {
+		running = false;						// All off, leave the timer stopped
+		return;
+		}
+
+	GPIO_REG_WRITE(GPIO_OUT_W1TS_ADDRESS, dimmer_schedule());
+	RTC_REG_WRITE(FRC1_LOAD_ADDRESS, edge_count ? edge_ticks[0] : DIM_PERIOD);
+	}
+
+// Restart the timer if it was stopped. Called after changing a target.
+static void ICACHE_FLASH_ATTR dimmer_kick(void) {
+	if (!running) {
+		running = true;
+		RTC_REG_WRITE(FRC1_LOAD_ADDRESS, DIM_MIN_TICKS);
+		}
+	}
+
+/**
+* \brief     Find the dimmer for an X10 device
+* \return    Channel number, -1 if the device is not one of our dimmers
+*/
+int ICACHE_FLASH_ATTR dimmer_find(char house, unsigned char unit) {
+	unsigned char i;
+
+	for (i = 0; i < DIM_COUNT; i++) {
+		if (channels[i].house == house && channels[i].unit == unit)
+			return i;
+		}
+	return -1;
+	}
+
+/// Fade to level, 0 to DIM_FULL
+void ICACHE_FLASH_ATTR dimmer_set(unsigned char ch, unsigned char level) {
+	dim[ch].target = level;
+	dimmer_kick();
+	}
+
+/// Fade by delta levels from the current target, DIM and BRIGHT
+void ICACHE_FLASH_ATTR dimmer_step(unsigned char ch, int delta) {
+	int level = dim[ch].target + delta;
+
+	dimmer_set(ch, level < 0 ? 0 : level > DIM_FULL ? DIM_FULL : level);
+	}
+
+/// Back to the level we had before the last OFF
+void ICACHE_FLASH_ATTR dimmer_on(unsigned char ch) {
+	dimmer_set(ch, dim[ch].last_on ? dim[ch].last_on : DIM_FULL);
+	}
+
+void ICACHE_FLASH_ATTR dimmer_off(unsigned char ch) {
+	if (dim[ch].target) dim[ch].last_on = dim[ch].target;
+	dimmer_set(ch, 0);
+	}
+
+/// Level the output is at or fading to
+unsigned char ICACHE_FLASH_ATTR dimmer_level(unsigned char ch) {
+	return dim[ch].target;
+	}
+
+void ICACHE_FLASH_ATTR dimmer_init(void) {
+	uint32 mask = 0;
+	unsigned char i, pin;
+
+	for (i = 0; i < DIM_COUNT; i++) {
+		mask |= channels[i].gpio;
+		}
+	for (pin = 0; pin < 16; pin++) {
+		if (mask & (1 << pin)) pin_select_gpio(pin, false);
+		}
+	gpio_output_set(0, mask, mask, 0);			// Outputs, all off
+
+	_xt_isr_attach(ETS_FRC_TIMER1_INUM, dimmer_isr, NULL);
+	RTC_REG_WRITE(FRC1_CTRL_ADDRESS, DIVDED_BY_16 | FRC1_ENABLE_TIMER | TM_EDGE_INT);
+	TM1_EDGE_INT_ENABLE();
+	_xt_isr_unmask(1 << ETS_FRC_TIMER1_INUM);
+	}
+
+#endif
@@ -0,0 +1,45 @@
+/*
+* xPL for ESP8266
+*
+* Dimmers, software PWM on the FRC1 hardware timer
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef Dimmer_h
+#define Dimmer_h
+
+#include "esp_common.h"
+
+#define DIM_FULL		255
+
+// One dimmer output, active high
+struct dim_channel {
+	uint16 gpio;				// GPIO bit (BITn)
+	uint8 unit;					// X10 unit
+	char house;					// X10 house code
+	};
+
+void dimmer_init(void);
+int dimmer_find(char house, unsigned char unit);
+void dimmer_set(unsigned char ch, unsigned char level);
+void dimmer_step(unsigned char ch, int delta);
+void dimmer_on(unsigned char ch);
+void dimmer_off(unsigned char ch);
+unsigned char dimmer_level(unsigned char ch);
+
+#endif
@@ -0,0 +1,204 @@
+/*
+* xPL for ESP8266
+*
+* Event loop
+*
+* With EVENT_LOOP set, the heartbeat, receive, debounce, sensor and connection tasks are
+* replaced by this one task. Interrupts and SDK callbacks post events to its queue, and
+* everything periodic (heartbeats, debounce and sensor sampling, retries, Wi-Fi deadlines)
+* is a timer on a hashed wheel. The task sleeps on the queue until the next timer is due.
+*
+* Timers hash into EV_WHEEL_SLOTS lists by expiry tick, so adding, removing and firing
+* only touch one short list. Timers must only be added or removed from the loop task,
+* or before the scheduler starts.
+*
+* The time from posting an event to its handler being called is measured for each event.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "esp_common.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "UserConfig.h"
+#include "EventLoop.h"
+#include "Telemetry.h"
+
+#if EVENT_LOOP
+
+struct ev_event {
+	unsigned char type;
+	uint32 arg;
+	void *data;
+	uint32 stamp;					// system_get_time() when posted
+	};
+
+static xQueueHandle evQ;
+static ev_handler handlers[EV_TYPES];
+
+static struct ev_timer *wheel[EV_WHEEL_SLOTS];
+static portTickType wheel_now;		// Last tick the wheel was run for
+
+static struct ev_stats stats;
+
+void ICACHE_FLASH_ATTR ev_set_handler(unsigned char type, ev_handler handler) {
+	handlers[type] = handler;
+	}
+
+/**
+* \brief     Post an event to the loop, from a task or an SDK callback
+* \return    false if the queue was full and the event dropped
+*/
+bool ICACHE_FLASH_ATTR ev_post(unsigned char type, uint32 arg, void *data) {
+	struct ev_event event = { type, arg, data, system_get_time() };
+
+	if (xQueueSendToBack(evQ, &event, 0) == pdTRUE)
+		return true;
+
+	stats.dropped++;
+	return false;
+	}
+
+/// Same as ev_post, from an interrupt
+// No ICACHE_FLASH_ATTR here, interrupt code has to be in RAM
+bool ev_post_from_isr(unsigned char type, uint32 arg, void *data, portBASE_TYPE *woken) {
+	struct ev_event event = { type, arg, data, system_get_time() };
+
+	if (xQueueSendFromISR(evQ, &event, woken) == pdTRUE)
+		return true;
+
+	stats.dropped++;
+	return false;
+	}
+
+/// Remove a timer, does nothing if it is not running
+void ICACHE_FLASH_ATTR ev_timer_del(struct ev_timer *timer) {
+	struct ev_timer **link = &wheel[timer->expires & (EV_WHEEL_SLOTS - 1)];
+
+	for (; *link != NULL; link = &(*link)->next) {
+		if (*link == timer) {
+			*link = timer->next;
+			return;
+			}
+		}
+	}
+
+/// (Re)start a timer, fn gets called in delay ticks
+void ICACHE_FLASH_ATTR ev_timer_add(struct ev_timer *timer, portTickType delay) {
+	struct ev_timer **slot;
+
+	ev_timer_del(timer);
+
+	timer->expires = xTaskGetTickCount() + delay;
+	if ((sint32)(timer->expires - wheel_now) <= 0) {		// Make sure the wheel gets to it
+		timer->expires = wheel_now + 1;
+		}
+
+	slot = &wheel[timer->expires & (EV_WHEEL_SLOTS - 1)];
+	timer->next = *slot;
+	*slot = timer;
+	}
+
+// Fire the timers of one slot that are due by now
+static void ICACHE_FLASH_ATTR ev_run_slot(unsigned char slot, portTickType now) {
+	struct ev_timer *timer;
+
+	restart:
+	for (timer = wheel[slot]; timer != NULL; timer = timer->next) {
+		if ((sint32)(timer->expires - now) <= 0) {
+			ev_timer_del(timer);
+			stats.timers++;
+			timer->fn(timer);
+			goto restart;						// The callback may have changed the list
+			}
+		}
+	}
+
+// Bring the wheel up to the current tick
+static void ICACHE_FLASH_ATTR ev_run_timers(void) {
+	portTickType now = xTaskGetTickCount();
+	unsigned char slot;
+
+	if (now - wheel_now >= EV_WHEEL_SLOTS) {	// Long sleep, every slot may have something due
+		for (slot = 0; slot < EV_WHEEL_SLOTS; slot++) {
+			ev_run_slot(slot, now);
+			}
+		wheel_now = now;
+		return;
+		}
+
+	while (wheel_now != now) {
+		wheel_now++;
+		ev_run_slot(wheel_now & (EV_WHEEL_SLOTS - 1), wheel_now);
+		}
+	}
+
+// Ticks until the next timer is due
+static portTickType ICACHE_FLASH_ATTR ev_next_timer(void) {
+	portTickType now = xTaskGetTickCount(), wait = portMAX_DELAY;
+	struct ev_timer *timer;
+	unsigned char slot;
+
+	for (slot = 0; slot < EV_WHEEL_SLOTS; slot++) {
+		for (timer = wheel[slot]; timer != NULL; timer = timer->next) {
+			if ((sint32)(timer->expires - now) <= 0)
+				return 0;
+			if (timer->expires - now < wait)
+				wait = timer->expires - now;
+			}
+		}
+	return wait;
+	}
+
+static void ICACHE_FLASH_ATTR ev_task(void *pvParameters) {
+	struct ev_event event;
+	uint32 latency, busy;
+
+	for (;;) {
+		if (xQueueReceive(evQ, &event, ev_next_timer())) {
+			busy = telem_start();
+			latency = system_get_time() - event.stamp;
+			if (latency > stats.max_latency) stats.max_latency = latency;
+			stats.sum_latency += latency;
+			stats.events++;
+
+			if (event.type < EV_TYPES && handlers[event.type] != NULL) {
+				handlers[event.type](event.arg, event.data);
+				}
+			telem_stop(busy);
+			}
+
+		busy = telem_start();
+		ev_run_timers();
+		telem_stop(busy);
+		}
+	}
+
+void ICACHE_FLASH_ATTR ev_get_stats(struct ev_stats *_stats) {
+	*_stats = stats;
+	}
+
+// Create the queue and the loop task. Called from user_init, before anything posts events.
+void ICACHE_FLASH_ATTR ev_init(void) {
+	evQ = xQueueCreate(EV_QUEUE_LEN, sizeof(struct ev_event));
+	wheel_now = xTaskGetTickCount();
+
+	telem_task_create(ev_task, "loop", EV_STACK);
+	}
+
+#endif
@@ -0,0 +1,62 @@
+/*
+* xPL for ESP8266
+*
+* Single task event loop with a timer wheel
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef EventLoop_h
+#define EventLoop_h
+
+#include "esp_common.h"
+#include "freertos/FreeRTOS.h"
+
+// Event types
+#define EV_UDP			0		// Received packet, data is the buffer
+#define EV_WIFI			1		// Wi-Fi event, arg is a WIFI_EV_xxx
+#define EV_INPUT		2		// Debounce, arg is the changed inputs, 0 for an edge
+#define EV_TYPES		3
+
+#define EV_WHEEL_SLOTS	16		// Power of 2
+
+// A timer. Lives in the module that uses it, the wheel only links them together.
+struct ev_timer {
+	struct ev_timer *next;
+	portTickType expires;
+	void (*fn)(struct ev_timer *timer);
+	};
+
+typedef void (*ev_handler)(uint32 arg, void *data);
+
+struct ev_stats {
+	uint32 events;				// Events handled
+	uint32 timers;				// Timers fired
+	uint32 max_latency;			// Post to handler, us
+	uint32 sum_latency;
+	uint32 dropped;				// Queue full
+	};
+
+void ev_init(void);
+void ev_set_handler(unsigned char type, ev_handler handler);
+bool ev_post(unsigned char type, uint32 arg, void *data);
+bool ev_post_from_isr(unsigned char type, uint32 arg, void *data, portBASE_TYPE *woken);
+void ev_timer_add(struct ev_timer *timer, portTickType delay);
+void ev_timer_del(struct ev_timer *timer);
+void ev_get_stats(struct ev_stats *stats);
+
+#endif
@@ -0,0 +1,114 @@
+/*
+* xPL for ESP8266
+*
+* Fast warm boot support
+*
+* After the first successful connection, the BSSID and channel of the access point,
+* our IP configuration and the state of the outputs are stored in RTC user memory.
+* On the next reset, we connect straight to that AP with a static IP, skipping
+* the scan and the DHCP exchange, and put the outputs back as they were.
+* RTC memory is lost on a cold power-up, in which case we go through the normal path.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "esp_common.h"
+#include "FastBoot.h"
+
+static struct fastboot_state rtc_state;		// RAM copy of the RTC area
+
+static uint32 ICACHE_FLASH_ATTR fastboot_checksum(const struct fastboot_state *state) {
+	const uint32 *p = (const uint32 *)state;
+	uint32 sum = 0x5A5A5A5A;
+	unsigned char i;
+
+	for (i = 0; i < sizeof(struct fastboot_state) / 4 - 1; i++) {		// Everything but the checksum itself
+		sum = (sum << 1 | sum >> 31) ^ p[i];
+		}
+	return sum;
+	}
+
+static void ICACHE_FLASH_ATTR fastboot_write(void) {
+	rtc_state.magic = FASTBOOT_MAGIC;
+	rtc_state.checksum = fastboot_checksum(&rtc_state);
+	system_rtc_mem_write(FASTBOOT_RTC_BLOCK, &rtc_state, sizeof(rtc_state));
+	}
+
+// Read the saved state from RTC memory. Returns true if the link parameters can be used.
+bool ICACHE_FLASH_ATTR fastboot_load(void) {
+	system_rtc_mem_read(FASTBOOT_RTC_BLOCK, &rtc_state, sizeof(rtc_state));
+
+	if (rtc_state.magic != FASTBOOT_MAGIC || rtc_state.checksum != fastboot_checksum(&rtc_state)) {
+		memset(&rtc_state, 0, sizeof(rtc_state));		// Cold boot, RTC memory holds garbage
+		return false;
+		}
+
+	return (rtc_state.valid & FASTBOOT_LINK) != 0;
+	}
+
+// Point the station config at the saved AP and set our saved IP as a static one.
+// The wifi manager starts DHCP again once the link is up, so the lease gets renewed.
+bool ICACHE_FLASH_ATTR fastboot_apply(struct station_config *config) {
+	if ((rtc_state.valid & FASTBOOT_LINK) == 0)
+		return false;
+
+	memcpy(config->bssid, rtc_state.bssid, sizeof(config->bssid));
+	config->bssid_set = 1;
+	wifi_station_set_config(config);
+	wifi_set_channel(rtc_state.channel);
+
+	wifi_station_dhcpc_stop();
+	wifi_set_ip_info(STATION_IF, &rtc_state.ip);
+	return true;
+	}
+
+// Save the parameters of the link we just brought up
+void ICACHE_FLASH_ATTR fastboot_save_link(const struct ip_info *ip) {
+	struct station_config config;
+
+	wifi_station_get_config(&config);				// Holds the BSSID of the current AP once associated
+	memcpy(rtc_state.bssid, config.bssid, sizeof(rtc_state.bssid));
+	rtc_state.channel = wifi_get_channel();
+	rtc_state.ip = *ip;
+	rtc_state.valid |= FASTBOOT_LINK;
+	fastboot_write();
+	}
+
+// The saved link did not come up, forget it so that the next boot does a full connect
+void ICACHE_FLASH_ATTR fastboot_invalidate(void) {
+	rtc_state.valid &= ~FASTBOOT_LINK;
+	fastboot_write();
+	}
+
+// Record the current state of the output pins in mask
+void ICACHE_FLASH_ATTR fastboot_save_outputs(uint32 mask) {
+	uint32 outputs = GPIO_REG_READ(GPIO_OUT_ADDRESS) & mask;
+
+	if ((rtc_state.valid & FASTBOOT_OUTPUTS) && rtc_state.outputs == outputs)
+		return;
+
+	rtc_state.outputs = outputs;
+	rtc_state.valid |= FASTBOOT_OUTPUTS;
+	fastboot_write();
+	}
+
+// Drive the output pins in mask back to their saved state, if we have one
+void ICACHE_FLASH_ATTR fastboot_restore_outputs(uint32 mask) {
+	if (rtc_state.valid & FASTBOOT_OUTPUTS) {
+		gpio_output_set(rtc_state.outputs & mask, ~rtc_state.outputs & mask, mask, 0);
+		}
+	}
@@ -0,0 +1,54 @@
+/*
+* xPL for ESP8266
+*
+* Fast warm boot support.
+* The link parameters and the output states are kept in RTC user memory,
+* which survives a reset, so we can skip the scan and the DHCP exchange on the next boot.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef FastBoot_h
+#define FastBoot_h
+
+#include "esp_common.h"
+
+#define FASTBOOT_RTC_BLOCK		64			// First RTC block available to user code
+#define FASTBOOT_MAGIC			0x78504C31	// "xPL1"
+
+#define FASTBOOT_LINK			0x01
+#define FASTBOOT_OUTPUTS		0x02
+
+// Layout of our RTC memory area. Must stay a multiple of 4 bytes.
+struct fastboot_state {
+	uint32 magic;
+	uint8 bssid[6];				// BSSID of the last AP we were associated with
+	uint8 channel;				// and its channel
+	uint8 valid;				// Which parts are valid, FASTBOOT_LINK | FASTBOOT_OUTPUTS
+	struct ip_info ip;			// Last IP configuration (address, netmask, gateway)
+	uint32 outputs;				// Last state of the output pins
+	uint32 checksum;
+	};
+
+bool fastboot_load(void);
+bool fastboot_apply(struct station_config *config);
+void fastboot_save_link(const struct ip_info *ip);
+void fastboot_invalidate(void);
+void fastboot_save_outputs(uint32 mask);
+void fastboot_restore_outputs(uint32 mask);
+
+#endif
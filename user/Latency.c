@@ -0,0 +1,154 @@
+/*
+* xPL for ESP8266
+*
+* Receive pipeline latency
+*
+* Packets are stamped with the CPU cycle counter in the UDP callback. The receive task
+* (or the event loop) then marks when it dequeued the packet, when parsing is done,
+* when the user routine is entered and when it applied an output.
+* The time spent in each stage goes into a log2 histogram, in us.
+* Only one packet is handled at a time, so the marks of the current packet are kept here.
+*
+* esp.request query=latency sends p50/p90/p99/max for each stage as an esp.latency status
+* message, and prints the full histograms on the serial port.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "esp_common.h"
+#include <stdio.h>
+#include "UserConfig.h"
+#include "xPL.h"
+#include "Latency.h"
+
+#if LATENCY
+
+#define CYCLES_PER_US	80
+
+static const char *stage_names[LAT_STAGES] = { "queue", "parse", "dispatch", "handler", "total" };
+
+static uint32 histo[LAT_STAGES][LAT_BUCKETS];
+static uint32 max_us[LAT_STAGES];
+
+// Marks of the packet being handled, 0 when not reached
+static uint32 marks[LAT_STAGES];
+static uint32 arrived;
+
+// Add one time to a stage's histogram
+static void ICACHE_FLASH_ATTR latency_add(unsigned char stage, uint32 cycles) {
+	uint32 us = cycles / CYCLES_PER_US;
+	unsigned char bucket = 0;
+
+	while (bucket < LAT_BUCKETS - 1 && (us >> (bucket + 1)) != 0) bucket++;
+
+	histo[stage][bucket]++;
+	if (us > max_us[stage]) max_us[stage] = us;
+	}
+
+/// A packet was dequeued, arrival is its latency_now() stamp from the UDP callback
+void ICACHE_FLASH_ATTR latency_begin(uint32 arrival) {
+	memset(marks, 0, sizeof(marks));
+	arrived = arrival;
+	marks[LAT_QUEUE] = latency_now();
+	}
+
+/// The current packet reached the end of a stage
+void ICACHE_FLASH_ATTR latency_mark(unsigned char stage) {
+	if (arrived != 0) {
+		marks[stage] = latency_now();
+		}
+	}
+
+/// Done with the current packet, add the stages it went through to the histograms
+void ICACHE_FLASH_ATTR latency_end(void) {
+	uint32 from = arrived;
+	unsigned char stage;
+
+	if (arrived == 0)
+		return;
+
+	for (stage = LAT_QUEUE; stage <= LAT_HANDLER; stage++) {
+		if (marks[stage] == 0)
+			break;
+		latency_add(stage, marks[stage] - from);
+		from = marks[stage];
+		}
+
+	if (marks[LAT_HANDLER] != 0) {				// Only packets that changed an output have a total
+		latency_add(LAT_TOTAL, marks[LAT_HANDLER] - arrived);
+		}
+	arrived = 0;
+	}
+
+/// Copy the histogram of a stage
+void ICACHE_FLASH_ATTR latency_get(unsigned char stage, uint32 *buckets) {
+	memcpy(buckets, histo[stage], sizeof(histo[stage]));
+	}
+
+// Upper bound, in us, of the bucket holding the given percentile
+static uint32 ICACHE_FLASH_ATTR latency_percentile(unsigned char stage, uint32 count, unsigned char percent) {
+	uint32 seen = 0, want = (count * percent + 99) / 100;
+	unsigned char bucket;
+
+	if (count == 0)
+		return 0;
+
+	for (bucket = 0; bucket < LAT_BUCKETS - 1; bucket++) {
+		seen += histo[stage][bucket];
+		if (seen >= want)
+			break;
+		}
+	return bucket < LAT_BUCKETS - 1 ? (2 << bucket) - 1 : max_us[stage];
+	}
+
+/**
+* \brief     Send the latencies as an esp.latency status message
+* \details   One line per stage: count,p50,p90,p99,max with the percentiles rounded up to their bucket, in us.
+*            A line takes up to 54 characters, and spills over, see xPL_Message_AddCommand.
+*            The full histograms go to the serial port.
+*/
+void ICACHE_FLASH_ATTR latency_send(void) {
+	xPL_Message *msg = new_xPL_Message();
+	char value[XPL_CONFIG_VALUE_MAX + 1];
+	unsigned char stage, bucket;
+	uint32 count;
+
+	msg->type = XPL_STAT;
+	msg->hop = 1;
+
+	xPL_Message_SetTarget(msg, "*", NULL, NULL);
+	xPL_Message_SetSchema(msg, "esp", "latency");
+
+	for (stage = 0; stage < LAT_STAGES; stage++) {
+		printf("%-8s", stage_names[stage]);
+		for (count = 0, bucket = 0; bucket < LAT_BUCKETS; bucket++) {
+			count += histo[stage][bucket];
+			printf(" %u", histo[stage][bucket]);
+			}
+		printf("\n");
+
+		snprintf(value, sizeof(value), "%u,%u,%u,%u,%u", count,
+			latency_percentile(stage, count, 50), latency_percentile(stage, count, 90),
+			latency_percentile(stage, count, 99), max_us[stage]);
+		xPL_Message_AddCommand(msg, stage_names[stage], value);
+		}
+
+	xPL_SendMessage(msg, true);
+	free_xPL_Message(msg);
+	}
+
+#endif
@@ -0,0 +1,65 @@
+/*
+* xPL for ESP8266
+*
+* Receive pipeline latency histograms
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef Latency_h
+#define Latency_h
+
+#include "esp_common.h"
+#include "UserConfig.h"
+
+// Stages of the receive pipeline, each one timed from the previous one
+#define LAT_QUEUE		0		// Packet arrival to dequeue by the receive task
+#define LAT_PARSE		1		// Dequeue to parse complete
+#define LAT_DISPATCH	2		// Parse complete to handler entry
+#define LAT_HANDLER		3		// Handler entry to output applied
+#define LAT_TOTAL		4		// Packet arrival to output applied
+#define LAT_STAGES		5
+
+#define LAT_BUCKETS		16		// Bucket n counts times from 2^n to 2^(n+1)-1 us, the last one everything above
+
+#if LATENCY
+
+// CPU cycle counter, 80 per us
+static inline uint32 latency_now(void) {
+#if defined(__xtensa__)
+	uint32 ccount;
+
+	__asm__ __volatile__("rsr %0, ccount" : "=a"(ccount));
+	return ccount;
+#else
+	return system_get_time() * 80;		// Host build, same units
+#endif
+	}
+
+void latency_begin(uint32 arrival);
+void latency_mark(unsigned char stage);
+void latency_end(void);
+void latency_get(unsigned char stage, uint32 *buckets);
+void latency_send(void);
+#else
+#define latency_now()			0
+#define latency_begin(arrival)	((void)(arrival))
+#define latency_mark(stage)
+#define latency_end()
+#endif
+
+#endif
@@ -0,0 +1,354 @@
+/*
+* xPL for ESP8266
+*
+* Acknowledged delivery of triggers
+*
+* xPL has no acknowledgements, a trigger lost to a Wi-Fi collision is just gone. For the schemas
+* selected, reliable_send adds a msgid= line to the message, sends it and keeps the rendered frame.
+* The frame goes out again until an esp.ack command with the same msgid comes back, or RELIABLE_RETRIES
+* retries went unanswered. The timeout follows the measured round trip, as TCP does it:
+* smoothed round trip plus 4 times its variation, only sampled on messages that were not sent again,
+* and doubled on each retry. Receivers must expect the same msgid more than once.
+* We are a receiver too: a message for us with a msgid= line gets an esp.ack back to its source, every copy of it.
+* The list of schemas set with reliable= lines is saved in flash.
+*
+* At most RELIABLE_MAX messages wait for their ack, when the table is full a message goes out once.
+* The sender never waits: the retransmissions are done by the "rel" task, or by a timer in the event loop.
+* Only that task frees the frames, an ack only marks its entry.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "esp_common.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include "UserConfig.h"
+#include "xPL.h"
+#include "Reliable.h"
+#include "EventLoop.h"
+#include "Telemetry.h"
+
+#if RELIABLE
+
+// Entry states
+#define REL_FREE		0
+#define REL_WAITING		1			// Sent, no ack yet
+#define REL_ACKED		2			// Ack received, the frame is freed on the next run
+
+struct reliable_entry {
+	char *frame;					// Rendered message
+	portTickType sent;				// First transmission, for the round trip sample
+	portTickType due;				// Next retransmission
+	portTickType rto;				// Current timeout, doubles on each retry
+	uint16 msgid;
+	uint8 retries;
+	uint8 state;
+	};
+
+static struct reliable_entry table[RELIABLE_MAX];
+static struct reliable_stats stats = { 0, 0, 0, 0, 0, 0, 0, RELIABLE_RTO_INIT };
+static uint16 next_msgid;
+
+// The schemas that get acknowledged delivery, as saved in flash
+static struct {
+	uint32 magic;
+	char list[XPL_CONFIG_VALUE_MAX + 1];		// class.type,class.type...
+	} selected = { RELIABLE_MAGIC, RELIABLE_SCHEMAS };
+
+#if EVENT_LOOP
+static struct ev_timer rel_timer;
+#else
+static xSemaphoreHandle rel_sem;		// Given to wake the task up when the table changed
+#endif
+
+// Have the retransmission timer look at the table again
+static void ICACHE_FLASH_ATTR reliable_wake(void) {
+#if EVENT_LOOP
+	ev_timer_add(&rel_timer, 0);
+#else
+	xSemaphoreGive(rel_sem);
+#endif
+	}
+
+/// Set the schemas that get acknowledged delivery, from a config.response reliable= line, e.g. x10.basic,sensor.basic
+void ICACHE_FLASH_ATTR reliable_config(const char *value) {
+	strlcpy(selected.list, value, sizeof(selected.list));
+	system_param_save_with_protect(RELIABLE_SECTOR, &selected, sizeof(selected));
+	}
+
+// Is the schema of the message in the list
+static bool ICACHE_FLASH_ATTR reliable_selected(xPL_Message *msg) {
+	char schema[XPL_CLASS_ID_MAX + XPL_TYPE_ID_MAX + 2];
+	const char *p = selected.list;
+	int len;
+
+	len = sprintf(schema, "%s.%s", msg->schema.class_id, msg->schema.type_id);
+	while ((p = strstr(p, schema)) != NULL) {
+		if ((p == selected.list || p[-1] == ',') && (p[len] == ',' || p[len] == '\0'))
+			return true;
+		p += len;
+		}
+	return false;
+	}
+
+/**
+* \brief     Send a message from the device, acknowledged if its schema was selected
+* \details   Returns once the first copy is out, the retries are left to the "rel" task
+*/
+void ICACHE_FLASH_ATTR reliable_send(xPL_Message *msg) {
+	char id[6], *frame;
+	portTickType now;
+	unsigned char i;
+
+	if (!reliable_selected(msg) || (frame = malloc(XPL_MESSAGE_BUFFER_MAX)) == NULL) {
+		xPL_SendMessage(msg, true);
+		return;
+		}
+
+	sprintf(id, "%u", ++next_msgid);
+	xPL_Message_AddCommand(msg, "msgid", id);
+	xPL_Message_SetSource(msg, xPL_device.source.vendor_id, xPL_device.source.device_id, xPL_device.source.instance_id);
+	if (!xPL_RenderMessage(msg, frame)) {
+		free(frame);
+		return;
+		}
+
+	now = xTaskGetTickCount();
+	xPL_SendMessageBuf(frame);
+	stats.sent++;
+
+	// Only now into the table. An ack that beats us to it is ignored, the receiver acks the retry as well.
+	taskENTER_CRITICAL();
+	for (i = 0; i < RELIABLE_MAX && table[i].state != REL_FREE; i++)
+		;
+	if (i < RELIABLE_MAX) {
+		table[i].frame = frame;
+		table[i].sent = now;
+		table[i].rto = stats.rto;
+		table[i].due = now + stats.rto;
+		table[i].msgid = next_msgid;
+		table[i].retries = 0;
+		table[i].state = REL_WAITING;
+		}
+	taskEXIT_CRITICAL();
+
+	if (i == RELIABLE_MAX) {
+		stats.full++;
+		free(frame);
+		return;
+		}
+	reliable_wake();
+	}
+
+// New round trip sample, in ticks
+static void ICACHE_FLASH_ATTR reliable_sample(portTickType rtt) {
+	sint32 delta;
+	portTickType rto;
+
+	if (stats.srtt == 0) {
+		stats.srtt = (rtt << 3) | 1;			// Never 0 again, that means no sample yet
+		stats.rttvar = rtt << 1;
+		}
+	else {
+		delta = (sint32)rtt - (sint32)(stats.srtt >> 3);
+		stats.srtt += delta;
+		if (delta < 0) delta = -delta;
+		stats.rttvar += delta - (sint32)(stats.rttvar >> 2);
+		}
+
+	rto = (stats.srtt >> 3) + stats.rttvar;
+	stats.rto = rto < RELIABLE_RTO_MIN ? RELIABLE_RTO_MIN : rto > RELIABLE_RTO_MAX ? RELIABLE_RTO_MAX : rto;
+	}
+
+// Send an esp.ack back to the source of a message
+static void ICACHE_FLASH_ATTR reliable_send_ack(xPL_Message *msg, const char *msgid) {
+	xPL_Message *ack = new_xPL_Message();
+
+	ack->type = XPL_CMND;
+	ack->hop = 1;
+
+	xPL_Message_SetTarget(ack, msg->source.vendor_id, msg->source.device_id, msg->source.instance_id);
+	xPL_Message_SetSchema(ack, "esp", "ack");
+	xPL_Message_AddCommand(ack, "msgid", msgid);
+	xPL_SendMessage(ack, true);
+	free_xPL_Message(ack);
+	}
+
+/**
+* \brief     Check a received message for acknowledgements
+* \details   An esp.ack with the msgid of one we are waiting on marks it as acked. Any other message
+*            for us with a msgid= line, that we did not send ourselves, gets its esp.ack back.
+*/
+void ICACHE_FLASH_ATTR reliable_ack(xPL_Message *msg) {
+	portTickType rtt = 0;
+	unsigned char i, j;
+	bool sample;
+	uint16 msgid;
+
+	if (msg->targets == 0)
+		return;
+
+	if (msg->type != XPL_CMND || !xPL_Message_IsSchema(msg, "esp", "ack")) {
+		if (strcmp(msg->source.vendor_id, xPL_device.source.vendor_id) == 0 && strcmp(msg->source.device_id, xPL_device.source.device_id) == 0
+			&& strcmp(msg->source.instance_id, xPL_device.source.instance_id) == 0)
+			return;									// Our own, the ack would look like one from the receiver
+
+		for (i = 0; i < msg->command_count; i++) {
+			if (strcasecmp(msg->command[i].name, "msgid") == 0 && msg->command[i].value[0] != '\0')
+				reliable_send_ack(msg, msg->command[i].value);
+			}
+		return;
+		}
+
+	for (i = 0; i < msg->command_count; i++) {
+		if (strcasecmp(msg->command[i].name, "msgid") != 0)
+			continue;
+
+		msgid = atoi(msg->command[i].value);
+		sample = false;
+		taskENTER_CRITICAL();
+		for (j = 0; j < RELIABLE_MAX; j++) {
+			if (table[j].state == REL_WAITING && table[j].msgid == msgid) {
+				table[j].state = REL_ACKED;
+				sample = table[j].retries == 0;		// Can't tell which copy a retry's ack is for
+				rtt = xTaskGetTickCount() - table[j].sent;
+				break;
+				}
+			}
+		taskEXIT_CRITICAL();
+
+		if (j < RELIABLE_MAX) {
+			stats.acked++;
+			if (sample) reliable_sample(rtt);
+			reliable_wake();
+			}
+		}
+	}
+
+// Free the acked entries, send the retries that are due and give up on the ones out of retries.
+// Returns the ticks until the next retry, portMAX_DELAY if there is nothing left to wait for.
+static portTickType ICACHE_FLASH_ATTR reliable_run(void) {
+	portTickType now = xTaskGetTickCount(), wait = portMAX_DELAY;
+	struct reliable_entry *entry;
+	char *frame;
+	unsigned char i;
+
+	for (i = 0, entry = table; i < RELIABLE_MAX; i++, entry++) {
+		frame = NULL;
+
+		taskENTER_CRITICAL();
+		if (entry->state == REL_ACKED || (entry->state == REL_WAITING && (sint32)(now - entry->due) >= 0 && entry->retries >= RELIABLE_RETRIES)) {
+			if (entry->state == REL_WAITING) stats.gave_up++;
+			entry->state = REL_FREE;
+			frame = entry->frame;
+			}
+		taskEXIT_CRITICAL();
+
+		if (frame != NULL) {
+			free(frame);
+			continue;
+			}
+
+		if (entry->state == REL_FREE)
+			continue;
+
+		if ((sint32)(now - entry->due) >= 0) {				// We are the only ones to free it, the frame stays
+			xPL_SendMessageBuf(entry->frame);
+			stats.retries++;
+			entry->retries++;
+			entry->rto = entry->rto * 2 > RELIABLE_RTO_MAX ? RELIABLE_RTO_MAX : entry->rto * 2;
+			entry->due = now + entry->rto;
+			}
+		if (entry->due - now < wait) wait = entry->due - now;
+		}
+	return wait;
+	}
+
+void ICACHE_FLASH_ATTR reliable_get_stats(struct reliable_stats *_stats) {
+	*_stats = stats;
+	}
+
+/**
+* \brief     Send the counters as an esp.reliable status message
+* \details   count=sent,acked,retries,gave_up,full rtt=smoothed round trip,timeout in ms
+*            count takes up to 54 characters, and spills over, see xPL_Message_AddCommand.
+*/
+void ICACHE_FLASH_ATTR reliable_send_stats(void) {
+	xPL_Message *msg = new_xPL_Message();
+	char value[XPL_CONFIG_VALUE_MAX + 1];
+
+	msg->type = XPL_STAT;
+	msg->hop = 1;
+
+	xPL_Message_SetTarget(msg, "*", NULL, NULL);
+	xPL_Message_SetSchema(msg, "esp", "reliable");
+
+	snprintf(value, sizeof(value), "%u,%u,%u,%u,%u", stats.sent, stats.acked, stats.retries, stats.gave_up, stats.full);
+	xPL_Message_AddCommand(msg, "count", value);
+
+	snprintf(value, sizeof(value), "%u,%u", (uint32)(stats.srtt >> 3) * portTICK_RATE_MS, (uint32)stats.rto * portTICK_RATE_MS);
+	xPL_Message_AddCommand(msg, "rtt", value);
+
+	xPL_SendMessage(msg, true);
+	free_xPL_Message(msg);
+	}
+
+#if EVENT_LOOP
+
+static void ICACHE_FLASH_ATTR reliable_expired(struct ev_timer *timer) {
+	portTickType wait = xPL_LinkUp() ? reliable_run() : RELIABLE_RTO_MIN;		// No point sending while the link is down
+
+	if (wait != portMAX_DELAY) ev_timer_add(timer, wait);
+	}
+
+#else
+
+// Retransmission task. Sleeps until the next retry is due, or until the table changes.
+static void ICACHE_FLASH_ATTR reliable_task(void *pvParameters) {
+	portTickType wait = portMAX_DELAY;
+	uint32 busy;
+
+	for (;;) {
+		xSemaphoreTake(rel_sem, wait);
+		xPL_WaitLink();
+
+		busy = telem_start();
+		wait = reliable_run();
+		telem_stop(busy);
+		}
+	}
+
+#endif
+
+void ICACHE_FLASH_ATTR reliable_init(void) {
+	next_msgid = system_get_time();			// Not the same ids again after a reset
+	if (!system_param_load(RELIABLE_SECTOR, 0, &selected, sizeof(selected)) || selected.magic != RELIABLE_MAGIC) {
+		selected.magic = RELIABLE_MAGIC;
+		strcpy(selected.list, RELIABLE_SCHEMAS);
+		}
+	selected.list[XPL_CONFIG_VALUE_MAX] = '\0';
+#if EVENT_LOOP
+	rel_timer.fn = reliable_expired;
+#else
+	vSemaphoreCreateBinary(rel_sem);
+	telem_task_create(reliable_task, "rel", 256);
+#endif
+	}
+
+#endif
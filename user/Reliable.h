@@ -0,0 +1,50 @@
+/*
+* xPL for ESP8266
+*
+* Acknowledged delivery of triggers, with retransmission
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef Reliable_h
+#define Reliable_h
+
+#include "esp_common.h"
+#include "freertos/FreeRTOS.h"
+#include "xPL_Message.h"
+
+#define RELIABLE_MAGIC		0x78504C41	// "xPLA"
+
+struct reliable_stats {
+	uint32 sent;					// Messages sent with a msgid
+	uint32 acked;					// Acknowledged
+	uint32 retries;					// Retransmissions
+	uint32 gave_up;					// Still not acknowledged after RELIABLE_RETRIES retries
+	uint32 full;					// Sent once only, the table was full
+	portTickType srtt;				// Smoothed round trip, ticks x 8, 0 until the first sample
+	portTickType rttvar;			// Round trip variation, ticks x 4
+	portTickType rto;				// Timeout for the next message, ticks
+	};
+
+void reliable_init(void);
+void reliable_send(xPL_Message *msg);
+void reliable_ack(xPL_Message *msg);
+void reliable_config(const char *value);
+void reliable_get_stats(struct reliable_stats *stats);
+void reliable_send_stats(void);
+
+#endif
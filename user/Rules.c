@@ -0,0 +1,360 @@
+/*
+* xPL for ESP8266
+*
+* Local rules
+*
+* A rule binds a message to an action on the device, so a switch on one node drives a light on another
+* without a round trip through a controller, and still does when the controller is down.
+* It matches the message type, the schema and up to RULE_CONDS name=value lines:
+*     rule=xpl-trig.x10.basic,device=C1,command=on
+* and either drives a pin or sends a message, rendered once when the rule is compiled:
+*     action=gpio,4,high
+*     action=xpl-cmnd,acme-lamp.hall,x10.basic,device=C2,command=on
+* The rules are given as rule= and action= line pairs in config.response messages, and saved in flash.
+* A message only holds a few of them, so each pair adds a rule, or replaces the one with the same rule= line.
+*
+* Rules see the messages received that get through the filters, whoever they are for, and the triggers the device sends.
+* The messages sent by actions do not go through the rules again.
+* Rules are chained in a hash table by schema, a message only looks at the rules for its schema.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "esp_common.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include "UserConfig.h"
+#include "xPL.h"
+#include "Debounce.h"
+#include "State.h"
+#include "Rules.h"
+
+#if RULES
+
+#define RULE_HEADER		80			// hop, source, braces and new lines that rendering adds to an action line
+
+// One name=value line the message must have
+struct rule_cond {
+	char name[XPL_NAME_LENGTH_MAX+1];
+	char value[RULE_VALUE_MAX+1];
+	};
+
+// One compiled rule
+struct rule {
+	char schema[XPL_CLASS_ID_MAX+XPL_TYPE_ID_MAX+2];		// class.type
+	uint32 hash;						// xPL_Hash of the schema
+	char *frame;						// Message to send, NULL for a pin action
+	uint16 high, low;					// Pins to drive
+	uint16 fired;						// Times the action was taken
+	unsigned char msgtype;				// XPL_CMND to XPL_TRIG, 0 for any
+	unsigned char conds;
+	unsigned char next;					// Next rule in the same hash bucket plus 1, 0 at the end
+	struct rule_cond cond[RULE_CONDS];
+	};
+
+static struct rule rules[RULE_MAX];
+static unsigned char rule_count;
+static unsigned char bucket[RULE_BUCKETS];	// First rule with this hash plus 1, 0 if none
+static xSemaphoreHandle rule_lock;			// Held while the table is read or changed: rule_run runs in the receive
+											// and the input tasks, and a config.response can compile the rules again
+
+// Forget all the rules, with the lock held
+static void ICACHE_FLASH_ATTR rule_clear_locked(void) {
+	unsigned char i, count = rule_count;
+
+	rule_count = 0;
+	memset(bucket, 0, sizeof(bucket));
+	for (i = 0; i < count; i++) {
+		free(rules[i].frame);
+		}
+	memset(rules, 0, sizeof(rules));
+	}
+
+// xpl-cmnd to XPL_CMND..., * to 0. 0xFF if it is none of them.
+static unsigned char ICACHE_FLASH_ATTR rule_msgtype(const char *s) {
+	if (strcmp(s, "*") == 0) return 0;
+	if (strcasecmp(s, "xpl-cmnd") == 0) return XPL_CMND;
+	if (strcasecmp(s, "xpl-stat") == 0) return XPL_STAT;
+	if (strcasecmp(s, "xpl-trig") == 0) return XPL_TRIG;
+	return 0xFF;
+	}
+
+// Cut s at the next comma, returns what follows it or NULL
+static char ICACHE_FLASH_ATTR *rule_next(char *s) {
+	char *p = strchr(s, ',');
+
+	if (p != NULL) *p++ = '\0';
+	return p;
+	}
+
+// Compile the action line into the rule. The line is cut up in place.
+static bool ICACHE_FLASH_ATTR rule_action(struct rule *r, char *action) {
+	char *type = action, *target, *schema, *level, *p;
+	size_t len = strlen(action);
+	unsigned char msgtype;
+	int pin;
+
+	target = rule_next(type);
+	if (target == NULL)
+		return false;
+
+	if (strcasecmp(type, "gpio") == 0) {
+		level = rule_next(target);
+		pin = atoi(target);
+		if (level == NULL || !pin_select_gpio(pin, false))
+			return false;
+		if (strcasecmp(level, "high") == 0) r->high = 1 << pin;
+		else if (strcasecmp(level, "low") == 0) r->low = 1 << pin;
+		else return false;
+		return true;
+		}
+
+	msgtype = rule_msgtype(type);
+	schema = rule_next(target);
+	if (msgtype == 0 || msgtype == 0xFF || schema == NULL || *target == '\0' || strchr(schema, '.') == NULL)
+		return false;
+
+	r->frame = malloc(len + RULE_HEADER);
+	if (r->frame == NULL)
+		return false;
+
+	action = rule_next(schema);
+	p = r->frame + sprintf(r->frame, "%s\n{\nhop=1\nsource=%s-%s.%s\ntarget=%s\n}\n%s\n{\n", type,
+		xPL_device.source.vendor_id, xPL_device.source.device_id, xPL_device.source.instance_id, target, schema);
+	while (action != NULL) {
+		char *line = action;
+
+		action = rule_next(line);
+		if (strchr(line, '=') == NULL)
+			return false;
+		p += sprintf(p, "%s\n", line);
+		}
+	strcpy(p, "}\n");
+	return true;
+	}
+
+// Compile one more rule, with the lock held. See rule_add.
+static bool ICACHE_FLASH_ATTR rule_add_locked(const char *match, const char *action) {
+	struct rule *r = &rules[rule_count];
+	char buf[XPL_CONFIG_VALUE_MAX + 1], *p, *next;
+	unsigned char *link;
+
+	if (rule_count >= RULE_MAX || strlcpy(buf, match, sizeof(buf)) >= sizeof(buf))
+		return false;
+
+	memset(r, 0, sizeof(*r));
+	next = rule_next(buf);
+	p = strchr(buf, '.');
+	if (p == NULL)
+		return false;
+	*p++ = '\0';
+	r->msgtype = rule_msgtype(buf);
+	if (r->msgtype == 0xFF || strchr(p, '.') == NULL || strlcpy(r->schema, p, sizeof(r->schema)) >= sizeof(r->schema))
+		return false;
+
+	while (next != NULL) {
+		struct rule_cond *cond = &r->cond[r->conds];
+
+		p = next;
+		next = rule_next(p);
+		if (r->conds == RULE_CONDS || strchr(p, '=') == NULL)
+			return false;
+		*strchr(p, '=') = '\0';
+		if (strlcpy(cond->name, p, sizeof(cond->name)) >= sizeof(cond->name)
+			|| strlcpy(cond->value, p + strlen(p) + 1, sizeof(cond->value)) >= sizeof(cond->value))
+			return false;
+		r->conds++;
+		}
+
+	if (strlcpy(buf, action, sizeof(buf)) >= sizeof(buf) || !rule_action(r, buf)) {
+		free(r->frame);
+		r->frame = NULL;
+		return false;
+		}
+
+	// At the end of its chain, the rules for a schema run in the order they were given
+	r->hash = xPL_Hash(r->schema);
+	for (link = &bucket[r->hash & (RULE_BUCKETS - 1)]; *link != 0; link = &rules[*link - 1].next)
+		;
+	*link = ++rule_count;
+	return true;
+	}
+
+/// Forget all the rules
+void ICACHE_FLASH_ATTR rule_clear(void) {
+	xSemaphoreTake(rule_lock, portMAX_DELAY);
+	rule_clear_locked();
+	xSemaphoreGive(rule_lock);
+	}
+
+/**
+* \brief     Compile one more rule
+* \param     match    msgtype.class.type[,name=value...], msgtype can be *
+* \param     action   gpio,pin,high|low or msgtype,target,class.type[,name=value...]
+* \return    false if a line is malformed or there is no room left
+*/
+bool ICACHE_FLASH_ATTR rule_add(const char *match, const char *action) {
+	bool ok;
+
+	xSemaphoreTake(rule_lock, portMAX_DELAY);
+	ok = rule_add_locked(match, action);
+	xSemaphoreGive(rule_lock);
+	return ok;
+	}
+
+// Does the message have all the lines the rule asks for
+static bool ICACHE_FLASH_ATTR rule_conds(const struct rule *r, const xPL_Message *msg) {
+	unsigned char i, j;
+
+	for (i = 0; i < r->conds; i++) {
+		for (j = 0; j < msg->command_count; j++) {
+			if (strcasecmp(msg->command[j].name, r->cond[i].name) == 0 && strcasecmp(msg->command[j].value, r->cond[i].value) == 0)
+				break;
+			}
+		if (j == msg->command_count)
+			return false;
+		}
+	return true;
+	}
+
+/**
+* \brief     Take the actions of the rules the message matches
+* \details   Called for each message received, and for the triggers the device sends
+*/
+void ICACHE_FLASH_ATTR rule_run(xPL_Message *msg) {
+	char schema[XPL_CLASS_ID_MAX+XPL_TYPE_ID_MAX+2];
+	struct rule *r;
+	uint32 hash;
+	unsigned char i;
+
+	if (rule_count == 0)
+		return;
+
+	sprintf(schema, "%s.%s", msg->schema.class_id, msg->schema.type_id);
+	hash = xPL_Hash(schema);
+	xSemaphoreTake(rule_lock, portMAX_DELAY);		// The frames stay until we are done with them
+	for (i = bucket[hash & (RULE_BUCKETS - 1)]; i != 0; i = r->next) {
+		r = &rules[i - 1];
+		if (r->hash != hash || strcmp(r->schema, schema) != 0 || (r->msgtype != 0 && r->msgtype != msg->type) || !rule_conds(r, msg))
+			continue;
+
+		r->fired++;
+		if (r->frame != NULL) {
+			xPL_SendMessageBuf(r->frame);
+			}
+		else {
+			gpio_output_set(r->high, r->low, r->high | r->low, 0);
+			state_gpio(r->high, r->low);
+			}
+		}
+	xSemaphoreGive(rule_lock);
+	}
+
+/// Times the action of a rule was taken, rules are numbered in the order they were given
+uint16 ICACHE_FLASH_ATTR rule_fired(unsigned char rule) {
+	return rule < rule_count ? rules[rule].fired : 0;
+	}
+
+// Compile a set of rule lines, the bad ones are skipped. rule_run waits until the new set is in.
+static void ICACHE_FLASH_ATTR rule_compile(const struct rule_set *set) {
+	unsigned char i;
+
+	xSemaphoreTake(rule_lock, portMAX_DELAY);
+	rule_clear_locked();
+	for (i = 0; i < set->count; i++) {
+		if (!rule_add_locked(set->line[i].match, set->line[i].action)) {
+			printf("Bad rule: %s -> %s\n", set->line[i].match, set->line[i].action);
+			}
+		}
+	xSemaphoreGive(rule_lock);
+	}
+
+/// Compile the rules saved in flash, if any. The source must be set, the messages sent carry it.
+/// Called once at start up, before any of the other rule_ calls.
+void ICACHE_FLASH_ATTR rule_load(void) {
+	struct rule_set *set;
+
+	vSemaphoreCreateBinary(rule_lock);
+	set = malloc(sizeof(struct rule_set));		// On heap, to save stack space
+	if (set == NULL)
+		return;
+
+	if (system_param_load(RULE_SECTOR, 0, set, sizeof(*set)) && set->magic == RULE_MAGIC && set->count <= RULE_MAX) {
+		rule_compile(set);
+		}
+	free(set);
+	}
+
+/**
+* \brief     Apply the rule= and action= lines of a config.response
+* \details   Each rule= line takes the action= line that follows it, and is added to the rules saved
+*            or replaces the one with the same rule= line. An empty rule= line clears them all first.
+*            The new set is saved in flash.
+*/
+void ICACHE_FLASH_ATTR rule_config(xPL_Message *msg) {
+	struct rule_set *set;
+	char match[XPL_CONFIG_VALUE_MAX + 1];
+	unsigned char i, j, next, found = 0;
+
+	set = malloc(sizeof(struct rule_set));
+	if (set == NULL)
+		return;
+
+	if (!system_param_load(RULE_SECTOR, 0, set, sizeof(*set)) || set->magic != RULE_MAGIC || set->count > RULE_MAX) {
+		memset(set, 0, sizeof(*set));
+		set->magic = RULE_MAGIC;
+		}
+
+	for (i = 0; i < msg->command_count; i++) {
+		if (strcasecmp(msg->command[i].name, "rule") != 0)
+			continue;
+
+		found = 1;
+		if (msg->command[i].value[0] == '\0') {
+			set->count = 0;
+			continue;
+			}
+
+		xPL_Message_GetValue(msg, i, match);
+		for (next = i + 1; next < msg->command_count && msg->command[next].name[0] == '\0'; next++)
+			;									// Past the rest of a long rule= line
+		if (next == msg->command_count || strcasecmp(msg->command[next].name, "action") != 0) {
+			printf("No action for rule %s\n", match);
+			continue;
+			}
+
+		for (j = 0; j < set->count && strcmp(set->line[j].match, match) != 0; j++)
+			;
+		if (j == RULE_MAX) {
+			printf("No room for rule %s\n", match);
+			continue;
+			}
+		if (j == set->count) set->count++;
+		strcpy(set->line[j].match, match);
+		xPL_Message_GetValue(msg, next, set->line[j].action);
+		i = next;
+		}
+
+	if (found) {
+		rule_compile(set);
+		system_param_save_with_protect(RULE_SECTOR, set, sizeof(*set));
+		}
+	free(set);
+	}
+
+#endif
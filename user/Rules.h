@@ -0,0 +1,51 @@
+/*
+* xPL for ESP8266
+*
+* Local rules: messages seen or sent by the device trigger actions on it
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef Rules_h
+#define Rules_h
+
+#include "UserConfig.h"
+#include "xPL_Message.h"
+
+#define RULE_CONDS			3			// name=value conditions per rule
+#define RULE_VALUE_MAX		16			// Longest value a condition can ask for
+#define RULE_BUCKETS		8			// Size of the schema hash table, a power of 2
+#define RULE_MAGIC			0x78504C52	// "xPLR"
+
+// The rule= and action= lines, as saved in flash
+struct rule_set {
+	uint32 magic;
+	unsigned char count;
+	struct {
+		char match[XPL_CONFIG_VALUE_MAX + 1];
+		char action[XPL_CONFIG_VALUE_MAX + 1];
+		} line[RULE_MAX];
+	};
+
+bool rule_add(const char *match, const char *action);
+void rule_clear(void);
+void rule_run(xPL_Message *msg);
+void rule_load(void);
+void rule_config(xPL_Message *msg);
+uint16 rule_fired(unsigned char rule);
+
+#endif
@@ -0,0 +1,180 @@
+/*
+* xPL for ESP8266
+*
+* Batch commands and scenes
+*
+* An esp.batch command switches several outputs in one message, and in the same instant:
+*     C1=on
+*     relay-2=off
+*     scene=3
+* Devices are X10 addresses, or the ids of the relay instances. All the pins end up in one set mask
+* and one clear mask, applied with a single gpio_output_set. Later lines win over earlier ones.
+* Only the outputs with a pin of their own take part, dimmers are left out.
+*
+* A scene is a batch kept on the device under a number, set with a config.response line
+* scene=3,C1=on,relay-2=off and compiled to its masks right away. scene=3 alone removes it, an empty
+* scene= line removes them all. The scenes are saved in flash.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "esp_common.h"
+#include <stdio.h>
+#include "UserConfig.h"
+#include "xPL.h"
+#include "FastBoot.h"
+#include "State.h"
+#include "Scene.h"
+
+#if SCENES
+
+static struct scene_table scenes;
+
+// State entry of the on/off output for a device, an X10 address or a relay instance id. -1 if there is none.
+static signed char ICACHE_FLASH_ATTR scene_output(const char *device) {
+	signed char inst = xPL_FindInstance(device);
+	char house = *device >= 'a' && *device <= 'z' ? *device - 'a' + 'A' : *device;
+
+	if (inst > 0)
+		return state_find(inst, 0, 0, false);
+	if (house < 'A' || house > 'P' || device[1] < '0' || device[1] > '9')
+		return -1;
+	return state_find(0, house, atoi(device + 1), false);
+	}
+
+// Add device=on or off to the masks. Returns false if the device can't be switched in a batch.
+static bool ICACHE_FLASH_ATTR scene_add(const char *device, const char *value, uint32 *high, uint32 *low) {
+	signed char idx = scene_output(device);
+
+	if (idx < 0)
+		return false;
+	if (strcasecmp(value, "on") == 0)
+		return state_pins(idx, true, high, low);
+	if (strcasecmp(value, "off") == 0)
+		return state_pins(idx, false, high, low);
+	return false;
+	}
+
+// Scene with this id, id 0 finds a free slot. NULL if there is none.
+static struct scene ICACHE_FLASH_ATTR *scene_find(unsigned char id) {
+	unsigned char i;
+
+	for (i = 0; i < SCENE_MAX; i++) {
+		if (scenes.scene[i].id == id)
+			return &scenes.scene[i];
+		}
+	return NULL;
+	}
+
+/**
+* \brief     Apply a scene= line of a config.response
+* \details   Format is id,device=on|off,... with id 1 to 255. The table is saved in flash.
+* \return    false if it is malformed, names a device that can't be in a batch, or there is no room left
+*/
+bool ICACHE_FLASH_ATTR scene_config(const char *value) {
+	char buf[XPL_CONFIG_VALUE_MAX + 1], *p, *next, *eq;
+	uint32 high = 0, low = 0;
+	struct scene *s;
+	int id;
+
+	if (strlcpy(buf, value, sizeof(buf)) >= sizeof(buf))
+		return false;
+
+	if (buf[0] == '\0') {
+		memset(scenes.scene, 0, sizeof(scenes.scene));
+		}
+	else {
+		next = strchr(buf, ',');
+		if (next != NULL) *next++ = '\0';
+		id = atoi(buf);
+		if (id < 1 || id > 255)
+			return false;
+
+		while (next != NULL) {
+			p = next;
+			next = strchr(p, ',');
+			if (next != NULL) *next++ = '\0';
+			eq = strchr(p, '=');
+			if (eq == NULL)
+				return false;
+			*eq++ = '\0';
+			if (!scene_add(p, eq, &high, &low))
+				return false;
+			}
+
+		s = scene_find(id);
+		if (s == NULL && (high | low) != 0) s = scene_find(0);
+		if (s == NULL)
+			return (high | low) == 0;			// Removing one we don't have
+
+		s->id = (high | low) != 0 ? id : 0;
+		s->high = high;
+		s->low = low;
+		}
+
+	system_param_save_with_protect(SCENE_SECTOR, &scenes, sizeof(scenes));
+	return true;
+	}
+
+/**
+* \brief     Apply an esp.batch command
+* \details   All the outputs named, and those of the scenes, are switched with one gpio_output_set
+* \return    false if nothing was switched
+*/
+bool ICACHE_FLASH_ATTR scene_batch(xPL_Message *msg) {
+	struct_command *cmd = msg->command;
+	uint32 high = 0, low = 0;
+	struct scene *s;
+	unsigned char i;
+	int id;
+
+	for (i = 0; i < msg->command_count; i++, cmd++) {
+		if (strcasecmp(cmd->name, "scene") == 0) {
+			id = atoi(cmd->value);
+			s = id >= 1 && id <= 255 ? scene_find(id) : NULL;		// Like scene_config, not wrapped into a byte
+			if (s == NULL) {
+				printf("No scene %s\n", cmd->value);
+				continue;
+				}
+			high = (high & ~s->low) | s->high;
+			low = (low & ~s->high) | s->low;
+			}
+		else if (!scene_add(cmd->name, cmd->value, &high, &low)) {
+			printf("Not in a batch: %s=%s\n", cmd->name, cmd->value);
+			}
+		}
+
+	if ((high | low) == 0)
+		return false;
+
+	gpio_output_set(high, low, high | low, 0);
+	state_gpio(high, low);
+#if FAST_BOOT
+	if ((high | low) & LED_GPIO) fastboot_save_outputs(LED_GPIO);		// Keep the new state across a reset
+#endif
+	return true;
+	}
+
+/// Load the scenes saved in flash, if any
+void ICACHE_FLASH_ATTR scene_init(void) {
+	if (!system_param_load(SCENE_SECTOR, 0, &scenes, sizeof(scenes)) || scenes.magic != SCENE_MAGIC) {
+		memset(&scenes, 0, sizeof(scenes));
+		scenes.magic = SCENE_MAGIC;
+		}
+	}
+
+#endif
@@ -0,0 +1,49 @@
+/*
+* xPL for ESP8266
+*
+* Batch commands and scenes, several outputs switched at once
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef Scene_h
+#define Scene_h
+
+#include "UserConfig.h"
+#include "xPL_Message.h"
+
+#define SCENE_MAGIC		0x78504C53	// "xPLS"
+
+// One scene, compiled to the pins it drives
+struct scene {
+	uint16 high;				// Pins driven high
+	uint16 low;					// and low
+	uint8 id;					// 0 for a free slot
+	uint8 pad[3];
+	};
+
+// The scenes, as saved in flash
+struct scene_table {
+	uint32 magic;
+	struct scene scene[SCENE_MAX];
+	};
+
+void scene_init(void);
+bool scene_config(const char *value);
+bool scene_batch(xPL_Message *msg);
+
+#endif
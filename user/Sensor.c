@@ -0,0 +1,349 @@
+/*
+* xPL for ESP8266
+*
+* Sensor reporting
+*
+* Each sensor in SENSOR_MAP is read every SENSOR_SAMPLE_TICKS, and the reading goes through
+* a fixed point exponential moving average. A sensor.basic trigger is only sent when the
+* filtered value has moved by more than the sensor's deadband since the last one sent,
+* or when the sensor has been silent for max_silence seconds.
+* A sensor.request for a device gets the current value back as a status message.
+*
+* Triggers are not sent one per reading. The readings that are due are held, for up to the
+* hold time from the first one, and then packed into as few messages as fit a datagram,
+* with indexed keys: device0=, type0=, current0=, device1=... A message with only one reading
+* keeps the usual device=, type=, current=. The hold is checked at each sample, so it is
+* rounded up to SENSOR_SAMPLE_TICKS, and with no hold the readings due at the same sample
+* still share their messages.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "esp_common.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <string.h>
+#include "UserConfig.h"
+#include "xPL.h"
+#include "Debounce.h"
+#include "Sensor.h"
+#include "EventLoop.h"
+#include "Telemetry.h"
+
+#if SENSORS
+
+#define EMA_FRAC	8				// Fractional bits of the filtered values
+
+static const struct sensor_channel sensor_map[] = SENSOR_MAP;
+#define SENSOR_MAP_COUNT	(sizeof(sensor_map) / sizeof(sensor_map[0]))
+
+static const struct sensor_channel *sensors[SENSOR_MAX];
+static unsigned char sensor_count;		// 0 until the map is loaded
+
+static struct {
+	sint32 filtered;				// EMA, EMA_FRAC fractional bits
+	sint32 sent;					// Last value sent, raw units
+	portTickType sent_at;
+	bool primed;					// Filter has seen its first sample
+	bool due;						// Waiting to go out with the other readings
+	} state[SENSOR_MAX];
+
+static portTickType hold = SENSOR_HOLD_TICKS;
+static portTickType held_since;			// Tick the oldest reading waiting became due
+static unsigned char held;				// Readings waiting
+
+// Filtered value rounded to raw units
+static sint32 ICACHE_FLASH_ATTR sensor_value(unsigned char i) {
+	return (state[i].filtered + (1 << (EMA_FRAC - 1))) >> EMA_FRAC;
+	}
+
+// Print value / 10^decimals
+static void ICACHE_FLASH_ATTR sensor_format(char *buf, sint32 value, uint8 decimals) {
+	sint32 div = 1;
+	uint8 i;
+
+	for (i = 0; i < decimals; i++) div *= 10;
+
+	if (decimals == 0) {
+		sprintf(buf, "%d", value);
+		}
+	else {
+		char frac[12];
+		uint32 abs = value < 0 ? -value : value;
+
+		sprintf(frac, "%d", abs % div + div);		// Leading 1 keeps the zeros
+		sprintf(buf, "%s%d.%s", value < 0 ? "-" : "", abs / div, frac + 1);
+		}
+	}
+
+// The SENSOR_MAP channels come first, whether sensor_add or sensor_init gets here first
+static void ICACHE_FLASH_ATTR sensor_load(void) {
+	if (sensor_count == 0) {
+		for (; sensor_count < SENSOR_MAP_COUNT && sensor_count < SENSOR_MAX; sensor_count++) {
+			sensors[sensor_count] = &sensor_map[sensor_count];
+			}
+		}
+	}
+
+// A new sensor.basic message, and the length of its text with no body lines. NULL if there is no memory for it.
+static xPL_Message ICACHE_FLASH_ATTR *sensor_message(unsigned char type, int *len) {
+	xPL_Message *msg = new_xPL_Message();
+	char *buf = malloc(XPL_MESSAGE_BUFFER_MAX);
+
+	if (buf == NULL) {
+		free_xPL_Message(msg);
+		return NULL;
+		}
+
+	msg->type = type;
+	msg->hop = 1;
+
+	xPL_Message_SetSource(msg, xPL_device.source.vendor_id, xPL_device.source.device_id, xPL_device.source.instance_id);
+	xPL_Message_SetTarget(msg, "*", NULL, NULL);
+	xPL_Message_SetSchema(msg, "sensor", "basic");
+
+	xPL_Message_toString(msg, buf, XPL_MESSAGE_BUFFER_MAX);
+	*len = strlen(buf);
+	free(buf);
+	return msg;
+	}
+
+// Send a message of readings. With only one, its names lose their index.
+static void ICACHE_FLASH_ATTR sensor_send_message(xPL_Message *msg, unsigned char readings) {
+	unsigned char i;
+
+	if (readings == 1) {
+		for (i = 0; i < msg->command_count; i++) {
+			if (msg->command[i].name[0] != '\0')		// Not the rest of a long name
+				msg->command[i].name[strlen(msg->command[i].name) - 1] = '\0';
+			}
+		}
+	xPL_SendMessage(msg, false);
+	free_xPL_Message(msg);
+	}
+
+// Add the lines of a reading, as reading n of the message. Returns false, with nothing added, if they don't fit.
+static bool ICACHE_FLASH_ATTR sensor_add_reading(xPL_Message *msg, int *len, unsigned char n, unsigned char i, const char *current) {
+	const char *value[3] = { sensors[i]->device, sensors[i]->type, current };
+	static const char *names[3] = { "device", "type", "current" };
+	char name[3][XPL_NAME_LENGTH_MAX + 1];
+	int lines = 0, commands = 0;
+	unsigned char k;
+
+	for (k = 0; k < 3; k++) {
+		lines += sprintf(name[k], "%s%d", names[k], n) + strlen(value[k]) + 2;		// name=value\n
+		commands += strlen(value[k]) > XPL_VALUE_LENGTH_MAX ? 2 : 1;				// Long names take two, see xPL_Message_AddCommand
+		}
+	if (*len + lines >= XPL_MESSAGE_BUFFER_MAX || msg->command_count + commands > XPL_MESSAGE_COMMAND_MAX)
+		return false;
+
+	for (k = 0; k < 3; k++) {
+		xPL_Message_AddCommand(msg, name[k], value[k]);
+		}
+	*len += lines;
+	return true;
+	}
+
+// Send the readings that are due, as many to a message as fit in a datagram
+static void ICACHE_FLASH_ATTR sensor_flush(void) {
+	xPL_Message *msg = NULL;
+	portTickType now = xTaskGetTickCount();
+	char current[16];
+	unsigned char i, n = 0;
+	int len;
+
+	for (i = 0; i < sensor_count; i++) {
+		if (!state[i].due)
+			continue;
+
+		state[i].due = false;
+		state[i].sent = sensor_value(i);
+		state[i].sent_at = now;
+		sensor_format(current, state[i].sent, sensors[i]->decimals);
+
+		if (msg != NULL && !sensor_add_reading(msg, &len, n, i, current)) {
+			sensor_send_message(msg, n);
+			msg = NULL;
+			}
+		if (msg == NULL) {
+			if ((msg = sensor_message(XPL_TRIG, &len)) == NULL) {
+				state[i].due = true;			// No memory, this one and the rest go at the next sample
+				return;
+				}
+			n = 0;
+			sensor_add_reading(msg, &len, n, i, current);
+			}
+		n++;
+		}
+	held = 0;
+
+	if (msg != NULL)
+		sensor_send_message(msg, n);
+	}
+
+// Answer for one sensor
+static void ICACHE_FLASH_ATTR sensor_send(unsigned char i, unsigned char type) {
+	char current[16];
+	xPL_Message *msg;
+	int len;
+
+	state[i].sent = sensor_value(i);
+	state[i].sent_at = xTaskGetTickCount();
+	sensor_format(current, state[i].sent, sensors[i]->decimals);
+
+	if ((msg = sensor_message(type, &len)) == NULL)
+		return;
+	sensor_add_reading(msg, &len, 0, i, current);
+	sensor_send_message(msg, 1);
+	}
+
+// Take one sample, returns true if it should be reported
+static bool ICACHE_FLASH_ATTR sensor_sample(unsigned char i) {
+	sint32 sample = sensors[i]->read(sensors[i]->arg) << EMA_FRAC;
+	sint32 delta;
+
+	if (!state[i].primed) {
+		state[i].filtered = sample;					// Start the filter on the first reading
+		state[i].primed = true;
+		return true;
+		}
+
+	state[i].filtered += (sample - state[i].filtered) >> sensors[i]->shift;
+
+	delta = sensor_value(i) - state[i].sent;
+	if (delta < 0) delta = -delta;
+
+	return delta > sensors[i]->deadband
+		|| xTaskGetTickCount() - state[i].sent_at >= sensors[i]->max_silence * (1000 / portTICK_RATE_MS);
+	}
+
+// Sample all the sensors, send the ones that need it once the oldest has been held long enough
+static void ICACHE_FLASH_ATTR sensor_poll(void) {
+	portTickType now = xTaskGetTickCount();
+	unsigned char i;
+
+	for (i = 0; i < sensor_count; i++) {
+		if (sensor_sample(i) && xPL_LinkUp() && !state[i].due) {		// Keep filtering while the link is down, just don't send
+			state[i].due = true;
+			if (held++ == 0) held_since = now;
+			}
+		}
+
+	if (held != 0 && now - held_since >= hold && xPL_LinkUp())
+		sensor_flush();
+	}
+
+#if EVENT_LOOP
+
+static struct ev_timer sample_timer;
+
+static void ICACHE_FLASH_ATTR sensor_tick(struct ev_timer *timer) {
+	ev_timer_add(timer, SENSOR_SAMPLE_TICKS);
+	sensor_poll();
+	}
+
+#else
+
+static void ICACHE_FLASH_ATTR SensorTask(void *pvParameters) {
+	portTickType xLastWakeTime = xTaskGetTickCount();
+	uint32 busy;
+
+	for (;;) {
+		vTaskDelayUntil(&xLastWakeTime, SENSOR_SAMPLE_TICKS);
+		busy = telem_start();
+		sensor_poll();
+		telem_stop(busy);
+		}
+	}
+
+#endif
+
+/**
+* \brief     Answer a sensor.request
+* \details   Sends a status message with the current value of device
+* \return    false if we don't have this device
+*/
+bool ICACHE_FLASH_ATTR sensor_request(const char *device) {
+	unsigned char i;
+
+	for (i = 0; i < sensor_count; i++) {
+		if (state[i].primed && strcasecmp(device, sensors[i]->device) == 0) {
+			sensor_send(i, XPL_STAT);
+			return true;
+			}
+		}
+	return false;
+	}
+
+/**
+* \brief     Add a sensor to the ones in SENSOR_MAP
+* \param     channel   Kept, not copied
+* \return    false if there are already SENSOR_MAX
+*/
+bool ICACHE_FLASH_ATTR sensor_add(const struct sensor_channel *channel) {
+	sensor_load();
+	if (sensor_count == SENSOR_MAX)
+		return false;
+
+	memset(&state[sensor_count], 0, sizeof(state[0]));
+	sensors[sensor_count++] = channel;
+	return true;
+	}
+
+/// Longest a reading is held for others to share its message, in ms, from a config.response sensor-hold= line.
+/// Negative is refused, more than SENSOR_HOLD_MAX_MS is cut down to it.
+bool ICACHE_FLASH_ATTR sensor_set_hold(sint32 ms) {
+	if (ms < 0)
+		return false;
+	hold = (ms > SENSOR_HOLD_MAX_MS ? SENSOR_HOLD_MAX_MS : ms) / portTICK_RATE_MS;
+	return true;
+	}
+
+void ICACHE_FLASH_ATTR sensor_init(void) {
+	sensor_load();
+#if EVENT_LOOP
+	sample_timer.fn = sensor_tick;
+	ev_timer_add(&sample_timer, SENSOR_SAMPLE_TICKS);
+#else
+	telem_task_create(SensorTask, "sens", 256);
+#endif
+	}
+
+#else
+
+bool ICACHE_FLASH_ATTR sensor_request(const char *device) {
+	return false;
+	}
+
+bool ICACHE_FLASH_ATTR sensor_add(const struct sensor_channel *channel) {
+	return false;
+	}
+
+bool ICACHE_FLASH_ATTR sensor_set_hold(sint32 ms) {
+	return ms >= 0;
+	}
+
+void ICACHE_FLASH_ATTR sensor_init(void) {
+	}
+
+#endif
+
+// ADC reader, 0 to 1023 for 0 to 1 V on TOUT
+sint32 ICACHE_FLASH_ATTR sensor_read_adc(uint8 arg) {
+	return system_adc_read();
+	}
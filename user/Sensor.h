@@ -0,0 +1,47 @@
+/*
+* xPL for ESP8266
+*
+* Analog and counter sensors, reported as sensor.basic
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef Sensor_h
+#define Sensor_h
+
+#include "esp_common.h"
+
+// One sensor. The reading goes through an EMA, and is only sent when it moves
+// by more than the deadband, or when nothing was sent for max_silence.
+struct sensor_channel {
+	const char *device;				// xPL device name
+	const char *type;				// sensor.basic type: voltage, temp, count...
+	sint32 (*read)(uint8 arg);		// Raw reading
+	uint8 arg;						// Passed to read, e.g. the GPIO number of a counter
+	uint8 shift;					// EMA weight of a new sample is 1/2^shift, 0 for no filtering
+	uint8 decimals;					// The value is sent as value / 10^decimals
+	uint16 deadband;				// In raw units
+	uint16 max_silence;				// Seconds
+	};
+
+void sensor_init(void);
+bool sensor_add(const struct sensor_channel *channel);
+bool sensor_set_hold(sint32 ms);
+bool sensor_request(const char *device);
+sint32 sensor_read_adc(uint8 arg);
+
+#endif
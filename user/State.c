@@ -0,0 +1,206 @@
+/*
+* xPL for ESP8266
+*
+* State of the outputs and inputs
+*
+* The handlers and the debounce code record each output and input here: on or off, dimmer level
+* and the tick of the last change. Each entry keeps its stat frame rendered up to the value,
+* so a status request only appends the value to it before it goes out.
+* An output that actually changes sends its stat, a command that leaves it as it was sends nothing.
+* Inputs already send a trigger when they change, they are only reported on request.
+*
+* Entries are added once the source is set, the frames carry it. Relays are found by their
+* instance, the other outputs and the inputs by their X10 address. An output and an input may share one.
+* Code that drives the output pins directly reports the change with state_gpio.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "esp_common.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <string.h>
+#include "UserConfig.h"
+#include "xPL.h"
+#include "Dimmer.h"
+#include "State.h"
+
+static struct state_entry table[STATE_MAX];
+static unsigned char count;
+
+#if DIMMER
+static const struct dim_channel dims[] = DIM_MAP;
+#endif
+
+// Render the stat of an entry up to its value
+static void ICACHE_FLASH_ATTR state_render(struct state_entry *e) {
+	char *p = e->frame;
+
+	p += sprintf(p, "xpl-stat\n{\nhop=1\nsource=%s-%s.%s\ntarget=*\n}\n%s\n{\n",
+		xPL_device.source.vendor_id, xPL_device.source.device_id, xPL_device.instance[e->instance].instance_id,
+		e->kind == STATE_SENSOR ? "sensor.basic" : "x10.basic");
+	if (e->house) {
+		p += sprintf(p, "device=%c%d\n", e->house, e->unit);
+		}
+	p += sprintf(p, e->kind == STATE_SENSOR ? "type=input\ncurrent=" : "command=");
+	e->frame_len = p - e->frame;
+	}
+
+/**
+* \brief     Find an output or an input
+* \param     instance  Instance it belongs to
+* \param     house     X10 house code, 0 for a relay
+* \param     input     Look for an input rather than an output
+* \return    Index of the entry, -1 if there is none
+*/
+signed char ICACHE_FLASH_ATTR state_find(unsigned char instance, char house, unsigned char unit, bool input) {
+	unsigned char i;
+
+	for (i = 0; i < count; i++) {
+		if (table[i].instance == instance && table[i].house == house && table[i].unit == unit
+			&& (table[i].kind >= STATE_INPUT) == input)
+			return i;
+		}
+	return -1;
+	}
+
+/**
+* \brief     Add an output or an input to the table, with its current state
+* \details   An entry that is already there only gets its kind and pin updated
+* \return    Index of the entry, -1 if the table is full
+*/
+signed char ICACHE_FLASH_ATTR state_add(unsigned char kind, unsigned char instance, char house, unsigned char unit, uint16 gpio, bool on) {
+	signed char idx = state_find(instance, house, unit, kind >= STATE_INPUT);
+	struct state_entry *e;
+
+	if (idx >= 0) {
+		e = &table[idx];
+		e->gpio = gpio;
+		if (e->kind != kind) {
+			e->kind = kind;
+			state_render(e);
+			}
+		return idx;
+		}
+
+	if (count == STATE_MAX)
+		return -1;
+
+	e = &table[count];
+	memset(e, 0, sizeof(*e));
+	e->kind = kind;
+	e->instance = instance;
+	e->house = house;
+	e->unit = unit;
+	e->gpio = gpio;
+	e->on = on;
+	e->changed = xTaskGetTickCount();
+	state_render(e);
+	return count++;
+	}
+
+/// Send the stat of an entry, with its current state
+void ICACHE_FLASH_ATTR state_send(unsigned char idx) {
+	const struct state_entry *e = &table[idx];
+	char frame[STATE_FRAME_MAX];
+	char *p = frame + e->frame_len;
+
+	memcpy(frame, e->frame, e->frame_len);
+	switch (e->kind) {
+		case STATE_SENSOR: strcpy(p, e->on ? "low\n}\n" : "high\n}\n"); break;		// Closed contact pulls the pin low
+		case STATE_DIMMER: sprintf(p, "%s\nlevel=%d\n}\n", e->on ? "on" : "off", e->level); break;
+		default: strcpy(p, e->on ? "on\n}\n" : "off\n}\n"); break;
+		}
+	xPL_SendMessageBuf(frame);
+	}
+
+/**
+* \brief     Record the state of an entry
+* \details   Outputs send their stat if it changed
+* \param     level     Dimmers, in %
+* \return    true if the state changed
+*/
+bool ICACHE_FLASH_ATTR state_set(unsigned char idx, bool on, unsigned char level) {
+	struct state_entry *e = &table[idx];
+
+	if (e->on == on && e->level == level)
+		return false;
+
+	e->on = on;
+	e->level = level;
+	e->changed = xTaskGetTickCount();
+	if (e->kind < STATE_INPUT) {
+		state_send(idx);
+		}
+	return true;
+	}
+
+/**
+* \brief     Record the pins that were just driven high or low
+* \details   The on/off outputs on those pins send their stat if they changed
+*/
+void ICACHE_FLASH_ATTR state_gpio(uint32 high, uint32 low) {
+	unsigned char i;
+
+	for (i = 0; i < count; i++) {
+		if (table[i].kind > STATE_OUTPUT_LOW || ((high | low) & table[i].gpio) == 0)
+			continue;
+		state_set(i, ((high & table[i].gpio) != 0) == (table[i].kind == STATE_OUTPUT), 0);
+		}
+	}
+
+/**
+* \brief     Add the pin of an on/off output to the masks that turn it on or off
+* \details   For several outputs to be switched with one gpio_output_set. A pin already in the other mask is moved.
+* \return    false if the entry has no pin of its own, a dimmer or an input
+*/
+bool ICACHE_FLASH_ATTR state_pins(unsigned char idx, bool on, uint32 *high, uint32 *low) {
+	const struct state_entry *e = &table[idx];
+
+	if (e->kind > STATE_OUTPUT_LOW || e->gpio == 0)
+		return false;
+
+	if (on == (e->kind == STATE_OUTPUT)) {
+		*high |= e->gpio;
+		*low &= ~e->gpio;
+		}
+	else {
+		*low |= e->gpio;
+		*high &= ~e->gpio;
+		}
+	return true;
+	}
+
+const struct state_entry ICACHE_FLASH_ATTR *state_get(unsigned char idx) {
+	return idx < count ? &table[idx] : NULL;
+	}
+
+// Add the device output and the dimmers. Relays and inputs are added by their own code.
+void ICACHE_FLASH_ATTR state_init(void) {
+#if DIMMER
+	unsigned char i;
+#endif
+
+	count = 0;
+	state_add(STATE_OUTPUT_LOW, 0, MYHOUSE, MYUNIT, LED_GPIO, (GPIO_REG_READ(GPIO_OUT_ADDRESS) & LED_GPIO) == 0);
+#if DIMMER
+	for (i = 0; i < sizeof(dims) / sizeof(dims[0]); i++) {
+		state_add(STATE_DIMMER, 0, dims[i].house, dims[i].unit, 0, false);
+		}
+#endif
+	}
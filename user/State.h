@@ -0,0 +1,61 @@
+/*
+* xPL for ESP8266
+*
+* State of the outputs and inputs, and the stat messages that report it
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef State_h
+#define State_h
+
+#include "esp_common.h"
+#include "freertos/FreeRTOS.h"
+
+#define STATE_FRAME_MAX		128			// Room for the stat frame, header and values
+
+// What an entry is, and how its stat reads
+#define STATE_OUTPUT		0			// On/off output, on when the pin is high, x10.basic command=on or off
+#define STATE_OUTPUT_LOW	1			// Same, on when the pin is low
+#define STATE_DIMMER		2			// x10.basic with level=, in %
+#define STATE_INPUT			3			// Input sent as x10.basic triggers
+#define STATE_SENSOR		4			// Input sent as sensor.basic triggers, current=low or high
+
+// One output or input. Relays are found by their instance and have no X10 address (house 0).
+struct state_entry {
+	portTickType changed;				// Tick of the last change
+	uint16 gpio;						// GPIO bit of an on/off output, 0 if none
+	char house;							// X10 house code
+	uint8 unit;							// X10 unit
+	uint8 kind;							// STATE_OUTPUT...
+	uint8 instance;						// xPL instance the stat goes out from
+	uint8 on;							// On, or closed for an input
+	uint8 level;						// Dimmers, in %
+	uint8 frame_len;					// Length of the rendered frame, up to the value
+	char frame[STATE_FRAME_MAX];
+	};
+
+void state_init(void);
+signed char state_add(unsigned char kind, unsigned char instance, char house, unsigned char unit, uint16 gpio, bool on);
+signed char state_find(unsigned char instance, char house, unsigned char unit, bool input);
+bool state_set(unsigned char idx, bool on, unsigned char level);
+void state_gpio(uint32 high, uint32 low);
+bool state_pins(unsigned char idx, bool on, uint32 *high, uint32 *low);
+void state_send(unsigned char idx);
+const struct state_entry *state_get(unsigned char idx);
+
+#endif
@@ -0,0 +1,158 @@
+/*
+* xPL for ESP8266
+*
+* Resource telemetry
+*
+* The tasks are created through telem_task_create so we know about them.
+* Each task brackets its work, after its blocking wait, with telem_start/telem_stop,
+* which adds up the busy time of the calling task. The SDK's FreeRTOS is built without
+* run time stats, so this is how the CPU share of each task is measured.
+*
+* Every TELEM_HBEATS heartbeats, the stack high water marks, the free heap and its low mark,
+* and the CPU share of each task over the period are sent as an esp.telem status message.
+* They can also be asked for with esp.request query=telem, or read with telem_collect.
+*
+* The heap figures come from the SDK. It has no largest free block, and probing for one
+* with mallocs would starve the other tasks, so fragmentation is not reported.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "esp_common.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include "UserConfig.h"
+#include "xPL.h"
+#include "Telemetry.h"
+
+#if TELEMETRY
+
+static struct {
+	xTaskHandle handle;
+	const char *name;
+	uint16 stack;
+	uint32 busy;					// us, since the last collection
+	} tasks[TELEM_TASKS_MAX];
+static unsigned char task_count;
+
+static uint32 window_start;			// system_get_time() at the last collection
+static uint32 heap_min = 0xFFFFFFFF;
+static unsigned char hbeats;
+
+/// Create a task and keep track of it. All our tasks run at priority 2 and take no parameter.
+void ICACHE_FLASH_ATTR telem_task_create(pdTASK_CODE code, const char *name, unsigned short stack) {
+	xTaskHandle handle = NULL;
+
+	xTaskCreate(code, name, stack, NULL, 2, &handle);
+	if (handle != NULL && task_count < TELEM_TASKS_MAX) {
+		tasks[task_count].handle = handle;
+		tasks[task_count].name = name;
+		tasks[task_count].stack = stack;
+		task_count++;
+		}
+	}
+
+/// Start of a busy period of the calling task
+uint32 ICACHE_FLASH_ATTR telem_start(void) {
+	return system_get_time();
+	}
+
+/// End of a busy period, charge it to the calling task
+void ICACHE_FLASH_ATTR telem_stop(uint32 start) {
+	xTaskHandle self = xTaskGetCurrentTaskHandle();
+	unsigned char i;
+
+	for (i = 0; i < task_count; i++) {
+		if (tasks[i].handle == self) {
+			tasks[i].busy += system_get_time() - start;
+			return;
+			}
+		}
+	}
+
+/**
+* \brief     Collect the telemetry
+* \details   Starts a new period for the CPU shares
+*/
+void ICACHE_FLASH_ATTR telem_collect(struct telem_stats *stats) {
+	uint32 now = system_get_time();
+	uint32 window = now - window_start;
+	unsigned char i;
+
+	stats->uptime = now / 1000000;
+	stats->heap = system_get_free_heap_size();
+	if (stats->heap < heap_min) heap_min = stats->heap;
+	stats->heap_min = heap_min;
+
+	stats->tasks = task_count;
+	for (i = 0; i < task_count; i++) {
+		stats->task[i].name = tasks[i].name;
+		stats->task[i].stack = tasks[i].stack;
+		stats->task[i].stack_free = uxTaskGetStackHighWaterMark(tasks[i].handle);
+		stats->task[i].cpu = window ? (uint64)tasks[i].busy * 1000 / window : 0;
+		tasks[i].busy = 0;
+		}
+	window_start = now;
+	}
+
+/**
+* \brief     Send the telemetry as an esp.telem status message
+* \details   heap=free,least free, then name=free stack/stack,cpu per mille for each task
+*/
+void ICACHE_FLASH_ATTR telem_send(void) {
+	struct telem_stats *stats = malloc(sizeof(struct telem_stats));		// On heap, to save stack space
+	xPL_Message *msg;
+	char value[24];
+	unsigned char i;
+
+	if (stats == NULL)
+		return;
+
+	telem_collect(stats);
+	msg = new_xPL_Message();
+
+	msg->type = XPL_STAT;
+	msg->hop = 1;
+
+	xPL_Message_SetTarget(msg, "*", NULL, NULL);
+	xPL_Message_SetSchema(msg, "esp", "telem");
+
+	sprintf(value, "%d", stats->uptime);
+	xPL_Message_AddCommand(msg, "up", value);
+	sprintf(value, "%d,%d", stats->heap, stats->heap_min);
+	xPL_Message_AddCommand(msg, "heap", value);
+
+	for (i = 0; i < stats->tasks; i++) {
+		sprintf(value, "%d/%d,%d", stats->task[i].stack_free, stats->task[i].stack, stats->task[i].cpu);
+		xPL_Message_AddCommand(msg, stats->task[i].name, value);
+		}
+
+	xPL_SendMessage(msg, true);
+	free_xPL_Message(msg);
+	free(stats);
+	}
+
+/// Called on each heartbeat, sends the telemetry every TELEM_HBEATS
+void ICACHE_FLASH_ATTR telem_hbeat(void) {
+	if (++hbeats >= TELEM_HBEATS) {
+		hbeats = 0;
+		telem_send();
+		}
+	}
+
+#endif
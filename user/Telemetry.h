@@ -0,0 +1,62 @@
+/*
+* xPL for ESP8266
+*
+* Resource telemetry: stacks, heap and CPU use
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef Telemetry_h
+#define Telemetry_h
+
+#include "esp_common.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "UserConfig.h"
+
+#define TELEM_TASKS_MAX		8
+
+struct telem_task_stats {
+	const char *name;
+	uint16 stack;					// Stack size, words
+	uint16 stack_free;				// Least free stack seen, words
+	uint16 cpu;						// Busy time over the last period, per mille
+	};
+
+struct telem_stats {
+	uint32 uptime;					// s
+	uint32 heap;					// Free heap, bytes
+	uint32 heap_min;				// Least free heap seen at a collection
+	unsigned char tasks;
+	struct telem_task_stats task[TELEM_TASKS_MAX];
+	};
+
+#if TELEMETRY
+void telem_task_create(pdTASK_CODE code, const char *name, unsigned short stack);
+uint32 telem_start(void);
+void telem_stop(uint32 start);
+void telem_collect(struct telem_stats *stats);
+void telem_send(void);
+void telem_hbeat(void);
+#else
+#define telem_task_create(code, name, stack)	xTaskCreate(code, name, stack, NULL, 2, NULL)
+#define telem_start()							0
+#define telem_stop(start)						((void)(start))
+#define telem_hbeat()
+#endif
+
+#endif
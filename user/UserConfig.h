@@ -17,3 +17,110 @@
 #define LED_GPIO BIT0
 // Which GPIO for input
 #define INPUT_GPIO BIT2
+
+// Inputs to debounce, and what to send when they change: { GPIO bit, INPUT_X10, INPUT_SENSOR or INPUT_COUNTER, unit, house }
+// Up to INPUT_MAX of them. Can be changed at run time, the new map is then saved in flash in INPUT_MAP_SECTOR.
+#define INPUT_MAP { { INPUT_GPIO, INPUT_X10, MYUNIT, MYHOUSE } }
+#define INPUT_MAP_SECTOR 0x3C
+
+// Stack, heap and CPU telemetry, sent as esp.telem every TELEM_HBEATS heartbeats and on esp.request query=telem
+#define TELEMETRY 1
+#define TELEM_HBEATS 5
+
+// Receive pipeline latency histograms, on esp.request query=latency
+#define LATENCY 1
+
+// Run everything from one task and a timer wheel instead of one task per job
+#define EVENT_LOOP 0
+#define EV_STACK 512				// Words, the loop runs the xPL parser and the user routine
+#define EV_QUEUE_LEN 8
+
+// Interrupt driven debounce. Edges wake up a DEBOUNCE_SAMPLE_MS sampling timer which stops once the inputs are stable.
+// A new state is accepted after 4 samples in a row (20 ms). 5 ms is the shortest period os_timer_arm
+// takes without system_timer_reinit, which would change every other software timer as well.
+#define DEBOUNCE_IRQ 1
+#define DEBOUNCE_SAMPLE_MS 5
+#define DEBOUNCE_IDLE_SAMPLES 10	// Stable samples before going back to waiting for an edge
+#define DEBOUNCE_RETRY_TICKS 50		// Event loop only, retry sending triggers held while the link was down
+
+// Sensors reported as sensor.basic, see Sensor.h
+// { device, type, reader, reader arg, EMA shift, decimals, deadband, max silence in s }
+// A counter on an INPUT_COUNTER pin, e.g. GPIO4: { "pulses", "count", debounce_count, 4, 0, 0, 0, 60 }
+#define SENSORS 1
+#define SENSOR_MAP { { "adc0", "voltage", sensor_read_adc, 0, 3, 3, 4, 300 } }
+#define SENSOR_SAMPLE_TICKS 100		// Read the sensors every second
+#define SENSOR_MAX 4				// SENSOR_MAP and the ones added with sensor_add
+#define SENSOR_HOLD_TICKS 0			// Readings due wait up to this for others to share their message, see Sensor.c
+#define SENSOR_HOLD_MAX_MS 60000	// Longest hold a sensor-hold= line sets
+
+// Dimmers, software PWM on the FRC1 hardware timer: { GPIO bit, unit, house }
+#define DIMMER 0
+#define DIM_MAP { { BIT12, 2, MYHOUSE } }
+#define DIM_PWM_US 5000			// PWM period, 200 Hz
+#define DIM_FADE_STEP 2			// Levels per PWM period, off to full in 0.64 s
+#define DIM_STEP 16				// DIM or BRIGHT without a level, out of 255
+
+// Relay boards: each relay is an xPL instance of its own, with the vendor and device ids above: { instance id, GPIO bit }
+// The output is driven high on x10.basic ON. Up to XPL_INSTANCE_MAX - 1 of them.
+#define RELAYS 0
+#define RELAY_MAP { { "relay-1", BIT4 }, { "relay-2", BIT5 } }
+
+// Outputs and inputs whose state is kept, each with its stat frame rendered (STATE_FRAME_MAX bytes)
+#define STATE_MAX 8
+
+// xpl-group memberships set with group= lines in config.response messages are saved in flash here
+#define XPL_GROUP_SECTOR 0x39
+// and the receive filters set with filter= lines here
+#define XPL_FILTER_SECTOR 0x36
+
+// Acknowledged triggers: the triggers of the schemas listed carry a msgid= line and go out again, on a timeout
+// that follows the measured round trip, until an esp.ack command with the same msgid comes back.
+// A config.response reliable= line changes the list, e.g. reliable=x10.basic,sensor.basic, and it is saved in flash
+// in RELIABLE_SECTOR. The receiver has to send the acks, so the list is empty to start with.
+// Messages with a msgid= line that are for us get their esp.ack sent back.
+#define RELIABLE 1
+#define RELIABLE_SCHEMAS ""
+#define RELIABLE_SECTOR 0x2D
+#define RELIABLE_MAX 4				// Triggers waiting for their ack, each one keeps its rendered frame
+#define RELIABLE_RETRIES 3			// Then we give up on it
+#define RELIABLE_RTO_INIT 50		// Timeout in ticks until the first ack gives us a round trip (500 ms)
+#define RELIABLE_RTO_MIN 10			// 100 ms
+#define RELIABLE_RTO_MAX 300		// 3 s
+
+// Local rules, from rule= and action= line pairs in a config.response, see Rules.c. Saved in flash in RULE_SECTOR.
+#define RULES 1
+#define RULE_MAX 8
+#define RULE_SECTOR 0x33
+
+// esp.batch commands switch several outputs at once, and scenes are batches kept on the device, see Scene.c.
+// The scenes set with scene= lines in config.response are saved in flash in SCENE_SECTOR.
+#define SCENES 1
+#define SCENE_MAX 8
+#define SCENE_SECTOR 0x30
+
+// Compact binary frames between our own nodes, see xPL_Binary.c. Each heartbeat says bin=1. A gateway says bin=2 and
+// turns the binary frames it gets back into text for the other xPL applications. Until one is heard everything goes out
+// as text, after that a node sends binary to the peers that said bin= and to everyone. Heartbeats and config messages
+// always stay text. A config.response bin-gateway=1 line, or 0, switches a node to gateway and back.
+#define XPL_BINARY 1
+#define XPL_BIN_GATEWAY 0			// Start as a gateway
+#define XPL_BIN_PEERS 8				// Binary capable sources remembered
+#define XPL_BIN_RECENT 8			// Frames remembered, to drop the gateway's text copies
+#define XPL_BIN_COPY_WAIT 100		// Ticks a frame is remembered for (1 s)
+
+// Fast warm boot: keep the AP, IP configuration and outputs in RTC memory across resets
+#define FAST_BOOT 1
+#define FASTBOOT_TIMEOUT 300	// Ticks to wait for the saved AP before doing a full connect (3 s)
+
+// Wi-Fi connection manager, all in ticks (10 ms)
+#define WIFI_BACKOFF_MIN 25			// First reconnect attempt 250 ms after losing the link
+#define WIFI_BACKOFF_MAX 3000		// Doubles on each failure up to 30 s
+#define WIFI_ATTEMPT_TIMEOUT 1000	// Give up on an attempt after 10 s
+#define WIFI_CHECK_INTERVAL 6000	// Check the link once a minute in case an event was missed
+#define WIFI_RECOVER_TARGET 200		// Link loss to IP address in less than 2 s
+
+// Battery trigger mode: deep sleep, wake on input or timer, send one message and sleep again
+#define BATTERY_MODE 0
+#define BATTERY_SLEEP_TIME 240		// Timer wake up for a heartbeat, in s (255 max)
+#define BATTERY_AWAKE_MAX 300		// Go back to sleep after 3 s if the link does not come up, in ticks
+#define BATTERY_TX_DELAY 2			// Ticks to let the packet go out before sleeping
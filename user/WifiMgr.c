@@ -0,0 +1,266 @@
+/*
+* xPL for ESP8266
+*
+* Event driven Wi-Fi connection manager
+*
+* The SDK Wi-Fi events are posted to a queue and handled by the "conn" task, or by the event loop.
+* The task only wakes up on an event or when a deadline expires, there is no polling.
+* When the link drops, the xPL tasks are paused and reconnect attempts are made
+* with an exponential backoff, starting at WIFI_BACKOFF_MIN.
+* The time from link loss to getting our IP address back is measured for each outage.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "esp_common.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "UserConfig.h"
+#include "WifiMgr.h"
+#include "FastBoot.h"
+#include "EventLoop.h"
+#include "Telemetry.h"
+
+// Our IP address
+struct ip_info ipinfo;
+
+#if EVENT_LOOP
+static struct ev_timer wifi_timer;		// Deadline for wifi_mgr_timeout()
+#else
+static xQueueHandle wifiQ;				// Events from the SDK callback
+#endif
+
+static struct station_config stationConf;
+static unsigned char state = WIFI_CONNECTING;
+static unsigned char fast = 0;			// Trying the AP saved by the fast boot code
+static unsigned char started = 0;		// The up callback was called at least once
+static portTickType backoff = WIFI_BACKOFF_MIN;
+static portTickType deadline;			// Tick at which wifi_mgr_timeout() is due
+static portTickType down_since;			// Tick at which we lost the link
+
+static wifi_link_cb link_up;
+static void (*link_down)(void);
+
+static struct wifi_mgr_stats stats;
+
+// Called by the SDK, just pass the interesting events on to our task
+static void ICACHE_FLASH_ATTR wifi_event_cb(System_Event_t *evt) {
+	unsigned char event;
+
+	switch (evt->event_id) {
+		case EVENT_STAMODE_CONNECTED: event = WIFI_EV_CONNECTED; break;
+		case EVENT_STAMODE_GOT_IP: event = WIFI_EV_GOT_IP; break;
+		case EVENT_STAMODE_DISCONNECTED: event = WIFI_EV_DISCONNECTED; break;
+		default: return;
+		}
+#if EVENT_LOOP
+	ev_post(EV_WIFI, event, NULL);
+#else
+	xQueueSendToBack(wifiQ, &event, 0);
+#endif
+	}
+
+// Returns the number of ticks until the deadline
+static portTickType ICACHE_FLASH_ATTR wifi_mgr_wait(portTickType delay) {
+	deadline = xTaskGetTickCount() + delay;
+	return delay;
+	}
+
+// The saved AP did not answer, go back to a normal scan and DHCP
+static void ICACHE_FLASH_ATTR wifi_mgr_fast_fallback(void) {
+#if FAST_BOOT
+	printf("Fast boot failed\n");
+	fastboot_invalidate();
+	stationConf.bssid_set = 0;
+	wifi_station_set_config(&stationConf);
+	wifi_station_dhcpc_start();
+#endif
+	fast = 0;
+	}
+
+// The link went down, or an attempt failed. Schedule the next attempt.
+static portTickType ICACHE_FLASH_ATTR wifi_mgr_down(void) {
+	portTickType delay = backoff;
+
+	if (state == WIFI_UP) {
+		stats.outages++;
+		down_since = xTaskGetTickCount();
+		printf("Link down\n");
+		link_down();
+		}
+
+	if (fast) {
+		wifi_mgr_fast_fallback();
+		delay = 0;
+		}
+	else if (backoff < WIFI_BACKOFF_MAX) {
+		backoff = backoff * 2 > WIFI_BACKOFF_MAX ? WIFI_BACKOFF_MAX : backoff * 2;
+		}
+
+	state = WIFI_DOWN;
+	return wifi_mgr_wait(delay);
+	}
+
+// Handle one event, returns the number of ticks to wait for the next one
+portTickType ICACHE_FLASH_ATTR wifi_mgr_event(unsigned char event) {
+	switch (event) {
+		case WIFI_EV_CONNECTED:
+			state = WIFI_ASSOCIATED;
+			return wifi_mgr_wait(WIFI_ATTEMPT_TIMEOUT);		// Now give DHCP some time
+
+		case WIFI_EV_GOT_IP:
+			wifi_get_ip_info(STATION_IF, &ipinfo);
+#if FAST_BOOT
+			if (state == WIFI_UP) {						// The DHCP lease started after a fast boot, maybe another address
+				fastboot_save_link(&ipinfo);
+				break;
+				}
+			if (fast)
+				wifi_station_dhcpc_start();				// The saved address is only borrowed until DHCP renews it
+			else
+				fastboot_save_link(&ipinfo);			// Remember this link for the next reset
+#endif
+			if (started) {
+				stats.last_recover = xTaskGetTickCount() - down_since;
+				if (stats.last_recover > stats.max_recover) stats.max_recover = stats.last_recover;
+				printf("Link up, recovered in %d ms%s\n", stats.last_recover * portTICK_RATE_MS,
+					stats.last_recover > WIFI_RECOVER_TARGET ? " (over target)" : "");
+				}
+			else {
+				printf("Link up after %d ms%s\n", system_get_time() / 1000, fast ? " (fast boot)" : "");
+				}
+
+			state = WIFI_UP;
+			fast = 0;
+			backoff = WIFI_BACKOFF_MIN;
+			link_up(!started);
+			started = 1;
+			return wifi_mgr_wait(WIFI_CHECK_INTERVAL);
+
+		case WIFI_EV_DISCONNECTED:
+			if (state == WIFI_DOWN)					// Already waiting to retry, keep the current deadline
+				break;
+			return wifi_mgr_down();
+		}
+
+	return deadline - xTaskGetTickCount();
+	}
+
+// The deadline expired without an event
+portTickType ICACHE_FLASH_ATTR wifi_mgr_timeout(void) {
+	switch (state) {
+		case WIFI_DOWN:								// Backoff delay is over, try again
+			stats.attempts++;
+			state = WIFI_CONNECTING;
+			wifi_station_connect();
+			return wifi_mgr_wait(WIFI_ATTEMPT_TIMEOUT);
+
+		case WIFI_CONNECTING:						// Attempt went nowhere
+		case WIFI_ASSOCIATED:
+			return wifi_mgr_down();
+
+		case WIFI_UP:								// Safety net in case we missed an event
+			if (wifi_station_get_connect_status() != STATION_GOT_IP) {
+				return wifi_mgr_down();
+				}
+			return wifi_mgr_wait(WIFI_CHECK_INTERVAL);
+		}
+
+	return wifi_mgr_wait(WIFI_CHECK_INTERVAL);
+	}
+
+void ICACHE_FLASH_ATTR wifi_mgr_get_stats(struct wifi_mgr_stats *_stats) {
+	*_stats = stats;
+	}
+
+// Set up the station and start the first attempt. Returns the ticks to the first deadline.
+static portTickType ICACHE_FLASH_ATTR wifi_mgr_start(void) {
+	memset(&stationConf, 0, sizeof(stationConf));
+	strcpy(stationConf.ssid, MYSSID);
+	strcpy(stationConf.password, MYPASSPHRASE);
+
+	//Set station mode
+	wifi_set_opmode(0x1);
+	wifi_station_set_config(&stationConf);
+
+#if FAST_BOOT
+	fast = fastboot_apply(&stationConf);			// Warm boot, go straight to the last AP with our last IP
+#endif
+
+	wifi_set_event_handler_cb(wifi_event_cb);
+	wifi_station_connect();
+	return wifi_mgr_wait(fast ? FASTBOOT_TIMEOUT : WIFI_ATTEMPT_TIMEOUT);
+	}
+
+#if EVENT_LOOP
+
+// Re-arm the deadline timer, waits below 0 mean the deadline already passed while handling events
+static void ICACHE_FLASH_ATTR wifi_mgr_rearm(portTickType wait) {
+	ev_timer_add(&wifi_timer, (sint32)wait < 0 ? 0 : wait);
+	}
+
+static void ICACHE_FLASH_ATTR wifi_mgr_expired(struct ev_timer *timer) {
+	wifi_mgr_rearm(wifi_mgr_timeout());
+	}
+
+static void ICACHE_FLASH_ATTR wifi_mgr_ev(uint32 arg, void *data) {
+	wifi_mgr_rearm(wifi_mgr_event(arg));
+	}
+
+#else
+
+// Connection task. Sleeps until an event comes in or the current deadline expires.
+static void ICACHE_FLASH_ATTR connect_task(void *pvParameters) {
+	portTickType wait = wifi_mgr_start();
+	unsigned char event;
+	uint32 busy;
+
+	for (;;) {
+		if (xQueueReceive(wifiQ, &event, wait)) {
+			busy = telem_start();
+			wait = wifi_mgr_event(event);
+			}
+		else {
+			busy = telem_start();
+			wait = wifi_mgr_timeout();
+			}
+		telem_stop(busy);
+
+		if ((sint32)wait < 0) wait = 0;				// Deadline already passed while handling events
+		}
+	}
+
+#endif
+
+// Start the connection manager.
+// up gets called each time we get an IP address, with first set the first time,
+// down gets called each time an established link is lost.
+void ICACHE_FLASH_ATTR wifi_mgr_init(wifi_link_cb up, void (*down)(void)) {
+	link_up = up;
+	link_down = down;
+
+#if EVENT_LOOP
+	ev_set_handler(EV_WIFI, wifi_mgr_ev);
+	wifi_timer.fn = wifi_mgr_expired;
+	wifi_mgr_rearm(wifi_mgr_start());
+#else
+	wifiQ = xQueueCreate(4, sizeof(unsigned char));
+
+	telem_task_create(connect_task, "conn", 256);
+#endif
+	}
@@ -0,0 +1,54 @@
+/*
+* xPL for ESP8266
+*
+* Event driven Wi-Fi connection manager
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef WifiMgr_h
+#define WifiMgr_h
+
+#include "esp_common.h"
+#include "freertos/FreeRTOS.h"
+
+// Events posted by the SDK callback to the manager
+#define WIFI_EV_CONNECTED		1
+#define WIFI_EV_GOT_IP			2
+#define WIFI_EV_DISCONNECTED	3
+
+// Manager states
+#define WIFI_DOWN				0		// Waiting for the backoff delay before the next attempt
+#define WIFI_CONNECTING			1		// Attempt in progress, waiting for the AP
+#define WIFI_ASSOCIATED			2		// Associated, waiting for an IP address
+#define WIFI_UP					3
+
+struct wifi_mgr_stats {
+	unsigned long outages;				// Number of times an established link was lost
+	unsigned long attempts;				// Reconnect attempts we forced
+	portTickType last_recover;			// Ticks from link loss to IP address, last outage
+	portTickType max_recover;			// Worst one so far
+	};
+
+typedef void (*wifi_link_cb)(bool first);
+
+void wifi_mgr_init(wifi_link_cb up, void (*down)(void));
+portTickType wifi_mgr_event(unsigned char event);
+portTickType wifi_mgr_timeout(void);
+void wifi_mgr_get_stats(struct wifi_mgr_stats *stats);
+
+#endif
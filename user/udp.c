@@ -33,40 +33,84 @@
 #include "lwip/ip_addr.h"
 #include "lwip/pbuf.h"
 #include "xPL.h"
+#include "UserConfig.h"
+#include "EventLoop.h"
+#include "Latency.h"
+#include "xPL_Stats.h"
 
 xQueueHandle udpQ;		// Incoming UPD messages are stuffed into this queue for eventual consumption by the xPL device task
 
 // Callback routine for incomping UDP packets
+// Runs in the lwIP task, so it must not block: packets that don't fit in the queue are dropped
 static void ICACHE_FLASH_ATTR udp_recv_cb(void *arg, struct udp_pcb *pcb, struct pbuf *p, struct ip_addr *addr, u16_t port) {
-	if (p != NULL) {
-		char *packet = strdup(p->payload);	// Make our
+	struct udp_packet packet;
 
-		if (strlen(packet) > 0) {
-			xQueueSendToBack(udpQ, &packet, portMAX_DELAY);
+	if (p == NULL)
+		return;
+
+	packet.stamp = latency_now();
+	xPL_stats.received++;
+
+	if (p->tot_len == 0) {
+		xPL_stats.drop_empty++;
+		}
+	else if (p->tot_len >= XPL_MESSAGE_BUFFER_MAX) {
+		xPL_stats.drop_size++;
+		}
+	else if ((packet.buf = malloc(p->tot_len + 1)) == NULL) {
+		xPL_stats.drop_nomem++;
+		}
+	else {
+		pbuf_copy_partial(p, packet.buf, p->tot_len, 0);	// The payload may be split, and is not null terminated
+		packet.buf[p->tot_len] = '\0';
+
+#if EVENT_LOOP
+		if (ev_post(EV_UDP, packet.stamp, packet.buf)) {
+#else
+		if (xQueueSendToBack(udpQ, &packet, 0) == pdTRUE) {
+#endif
+			xPL_stats.queued++;
+			}
+		else {
+			xPL_stats.drop_full++;
+			free(packet.buf);
 			}
 		}
 
 	pbuf_free(p);
 	}
 
-// UDP send routine
+// UDP send routine, returns the lwIP error code
 int ICACHE_FLASH_ATTR udpio_send(const char *buf, int port) {
 	struct udp_pcb *pcb = udp_new();
 	struct pbuf *pb = pbuf_alloc(PBUF_TRANSPORT, strlen(buf) + 1, PBUF_RAM);
+	int err = ERR_MEM;
+
+	if (pcb != NULL && pb != NULL) {
+		strcpy(pb->payload, buf);
+		err = udp_sendto(pcb, pb, IP_ADDR_BROADCAST, port);
+		}
 
-	strcpy(pb->payload, buf);
-	int err = udp_sendto(pcb, pb, IP_ADDR_BROADCAST, port);
-	if (err != 0) printf(" Err=%d ", err);
+	if (err == ERR_OK) {
+		XPL_STATS_INC(sent);
+		}
+	else {
+		XPL_STATS_INC(send_err);
+		printf(" Err=%d ", err);
+		}
 
-	pbuf_free(pb);
-	udp_remove(pcb);
+	if (pb != NULL) pbuf_free(pb);
+	if (pcb != NULL) udp_remove(pcb);
+	return err;
 	}
 
 // Initialize UDP io by creating the Queue and registering the receive callback
 void ICACHE_FLASH_ATTR udpio_init(void) {
 	struct udp_pcb *pcb = udp_new();
 
-	udpQ = xQueueCreate(4, sizeof(char *));
+#if !EVENT_LOOP
+	udpQ = xQueueCreate(4, sizeof(struct udp_packet));
+#endif
 
 	udp_bind(pcb, IP_ADDR_ANY, XPL_UDP_PORT);
 	udp_recv(pcb, udp_recv_cb, NULL);
@@ -24,64 +24,57 @@
 #include "freertos/task.h"
 #include "UserConfig.h"
 #include "xPL.h"
+#include "FastBoot.h"
+#include "WifiMgr.h"
+#include "Battery.h"
+#include "Debounce.h"
+#include "Sensor.h"
+#include "Dimmer.h"
+#include "EventLoop.h"
+#include "Reliable.h"
+#include "State.h"
+#include "Rules.h"
+#include "Scene.h"
 
 
 void udpio_init(void);
-void debounce_init(void);
+void relay_init(void);
 
-// Our IP address
-struct ip_info ipinfo;
-
-// Initial task. Waits for connection and for an IP address before starting the other tasks.
-// Keeps checking for connection afterwards
-
-void ICACHE_FLASH_ATTR connect_task(void *pvParameters) {
-	portTickType xLastWakeTime = xTaskGetTickCount();
-	portTickType xFrequency = 1000;				// Every 10 s
-	struct station_config stationConf;
-
-	unsigned char cnt = 0;
-	unsigned char isinit = 0;
-
-	memset(&stationConf, 0, sizeof(stationConf));
-	strcpy(stationConf.ssid, MYSSID);
-	strcpy(stationConf.password, MYPASSPHRASE);
-
-	//Set station mode
-	wifi_set_opmode(0x1);
-	wifi_station_set_config(&stationConf);
-	
-	for (;;) {
-		// Wait for the next cycle.
-		vTaskDelayUntil(&xLastWakeTime, xFrequency);
-
-		if (wifi_station_get_connect_status() == STATION_GOT_IP) {		// Got an IP?
-			wifi_get_ip_info(0, &ipinfo);								// Get it
-
-			if (!isinit) {												// Start the tasks once we have our IP address
-				xPL_SetSource(xPL_VENDORID, xPL_DEVICEID, xPL_INSTANCEID);
-				xPL_init();
-				udpio_init();
-				debounce_init();
-				isinit = 1;
-				xFrequency = 6000;					// Once a minute from now on
-				}
-			}
-		else {										// Lost our connection?
-			printf("Checking IP - %d\r", cnt);
-			xFrequency = 1000;						// Check every 10s
-
-			if (cnt++ > 50) {						// Try to reconnect
-				wifi_station_disconnect();
-				vTaskDelay(100);
-				wifi_station_connect();
-				printf("Reconnecting\n");
-				cnt = 0;
-				}
-			}
+// Called by the connection manager each time we get our IP address.
+// Starts the tasks the first time, resumes them afterwards.
+static void ICACHE_FLASH_ATTR link_up(bool first) {
+	if (first) {
+		xPL_SetSource(xPL_VENDORID, xPL_DEVICEID, xPL_INSTANCEID);
+		state_init();
+#if RELAYS
+		relay_init();
+#endif
+#if RULES
+		rule_load();
+#endif
+#if SCENES
+		scene_init();
+#endif
+		xPL_init();
+		udpio_init();
+#if RELIABLE
+		reliable_init();
+#endif
+		debounce_init();
+		sensor_init();
+		printf("Started, free heap %d\n", system_get_free_heap_size());		// To compare EVENT_LOOP builds
+		}
+	else {
+		xPL_Resume();
+		xPL_SendHBeat();					// Let everyone know we are back
 		}
 	}
 
+// Called by the connection manager when the link is lost
+static void ICACHE_FLASH_ATTR link_down(void) {
+	xPL_Pause();
+	}
+
 //Init function
 //User program begins here
 void ICACHE_FLASH_ATTR user_init(void) {
@@ -90,5 +83,22 @@ void ICACHE_FLASH_ATTR user_init(void) {
 		SDK_VERSION_MINOR,
 		SDK_VERSION_REVISION);
 
-	xTaskCreate(connect_task, "conn", 256, NULL, 2, NULL);
+#if EVENT_LOOP
+	ev_init();
+#endif
+
+#if FAST_BOOT
+	fastboot_load();
+	fastboot_restore_outputs(LED_GPIO);			// Put the outputs back the way they were before the reset
+#endif
+
+#if DIMMER
+	dimmer_init();
+#endif
+
+#if BATTERY_MODE
+	battery_init();
+#else
+	wifi_mgr_init(link_up, link_down);
+#endif
 	}
@@ -31,7 +31,17 @@
 #include "freertos/FreeRTOS.h"
 #include <freertos/task.h>
 #include <freertos/queue.h>
+#include <freertos/semphr.h>
 #include <stdio.h>
+#include "UserConfig.h"
+#include "EventLoop.h"
+#include "Telemetry.h"
+#include "Latency.h"
+#include "xPL_Stats.h"
+#include "xPL_Filter.h"
+#include "Reliable.h"
+#include "Rules.h"
+#include "xPL_Binary.h"
 
 #define XPL_LINE_MESSAGE_BUFFER_MAX			128	// max length of a line			// maximum command in a xpl message
 #define XPL_END_OF_LINE						10
@@ -55,61 +65,358 @@ const char XPL_HBEAT_REQUEST_TYPE_ID[] = "request";
 extern struct ip_info ipinfo;			// Struct holding our IP address
 extern xQueueHandle udpQ;				// Queue with received UDP packets
 
-extern void process_message(xPL_Message *msg);		// User routine to do something with the received xPL messages
+extern void process_message(xPL_Message *msg, unsigned char instance);		// User routine to do something with the received xPL messages
+extern int udpio_send(const char *buf, int port);	// In udp.c
 
 struct xPL xPL_device;					// The device
 
+// The xpl-group names, as saved in flash
+static struct {
+	uint32 magic;
+	struct xPL_group group[XPL_GROUP_MAX];
+	} xPL_groups;
+static unsigned char xPL_group_bucket[XPL_GROUP_BUCKETS];		// First group with this hash plus 1, 0 if none
+
+static xSemaphoreHandle xPL_link_sem;	// Taken while the link is down, tasks block on it in xPL_WaitLink
+static volatile bool xPL_link_up = true;
+
+/**
+* \brief     Handle one received packet
+* \details   Parses it once, answers heartbeat requests and passes it to the handler of each instance
+*            it is for: one, the members of an xpl-group, or all of them for *. Frees the buffer.
+* \param     arrival   latency_now() stamp from the UDP callback
+*/
+void ICACHE_FLASH_ATTR xPL_HandlePacket(char *buf, uint32 arrival) {
+	if (buf != NULL && strlen(buf) > 0) {
+		xPL_Message *msg;
+		struct xPL_instance *inst;
+		unsigned char i;
+		bool filtered;
+
+		latency_begin(arrival);
+		msg = xPL_ParseInputMessage(buf);
+		latency_mark(LAT_PARSE);
+
+		// The filters, and what the device accepts, decide whether the handlers and the rules get to see it
+		filtered = !xPL_FilterAccepts(msg) || (xPL_device.xpl_accepted == XPL_ACCEPT_SELF && msg->target.vendor_id[0] == '*');
+		if (filtered) {
+			msg->targets = 0;
+			xPL_stats.filtered++;
+			}
+
+		for (i = 0, inst = xPL_device.instance; i < xPL_device.instance_count; i++, inst++) {
+			if ((msg->targets & (1 << i)) && inst->handler != NULL) inst->handler(msg, i);
+			}
+#if RULES
+		if (!filtered) rule_run(msg);
+#endif
+		latency_end();
+		xPL_stats.handled++;
+
+		free_xPL_Message(msg);
+		free(buf);
+		}
+	}
+
+// Send the heartbeats that are due, each instance on its own interval. Returns the ticks from now until the next one.
+// Heartbeats missed while the link was down are not caught up on.
+static portTickType ICACHE_FLASH_ATTR xPL_hbeat_run(portTickType now) {
+	portTickType wait = portMAX_DELAY;
+	struct xPL_instance *inst;
+	unsigned char i;
+
+	for (i = 0, inst = xPL_device.instance; i < xPL_device.instance_count; i++, inst++) {
+		if ((sint32)(now - inst->hbeat_due) >= 0) {
+			if (xPL_link_up && ipinfo.ip.addr != 0) {
+				xPL_SendInstanceHBeat(i);
+				if (i == 0) telem_hbeat();
+				}
+			inst->hbeat_due += inst->hbeat_interval * 100;
+			if ((sint32)(now - inst->hbeat_due) >= 0) inst->hbeat_due = now + inst->hbeat_interval * 100;
+			}
+		if (inst->hbeat_due - now < wait) wait = inst->hbeat_due - now;
+		}
+	return wait;
+	}
+
+#if EVENT_LOOP
+
+static struct ev_timer hbeat_timer;
+
+// Heartbeat timer, runs in the event loop
+static void ICACHE_FLASH_ATTR xPL_hbeat_timer(struct ev_timer *timer) {
+	ev_timer_add(timer, xPL_hbeat_run(xTaskGetTickCount()));
+	}
+
+static void ICACHE_FLASH_ATTR xPL_packet_event(uint32 arg, void *data) {
+	xPL_HandlePacket(data, arg);
+	}
+
+#else
+
 /**
 * \brief     HeartBeat task
-* \details   Send heartbeat messages at "hbeat_interval" interval
+* \details   Send heartbeat messages at each instance's "hbeat_interval" interval
 */
 void ICACHE_FLASH_ATTR xPL_hbeat_task(void *pvParameters) {
-	portTickType xLastWakeTime = xTaskGetTickCount();
-	portTickType xFrequency = xPL_device.hbeat_interval * 100;				// Once a minute
+	portTickType xLastWakeTime, wait;
+	uint32 busy;
 
 	for (;;) {
-		if (ipinfo.ip.addr != 0) {
-			xPL_SendHBeat();
-			}
-		// Wait for the next cycle.
-		vTaskDelayUntil(&xLastWakeTime, xFrequency);
+		xPL_WaitLink();
+
+		busy = telem_start();
+		xLastWakeTime = xTaskGetTickCount();
+		wait = xPL_hbeat_run(xLastWakeTime);
+		telem_stop(busy);
+
+		// Sleep until the next one is due
+		vTaskDelayUntil(&xLastWakeTime, wait);
 		}
 	}
 
 // This task takes the received UDP packets, parses them, then passes them to the user routine for action
 
 void ICACHE_FLASH_ATTR xPL_recv_task(void *pvParameters) {
-	char *buf;
+	struct udp_packet packet;
+	uint32 busy;
 
 	for (;;) {
-		xQueueReceive(udpQ, &buf, portMAX_DELAY);
-		if (buf != NULL && strlen(buf) > 0) {
-			xPL_Message *msg = xPL_ParseInputMessage(buf);
-
-			process_message(msg);			// User process routine
-
-			free_xPL_Message(msg);
-			free(buf);
-			}
+		xQueueReceive(udpQ, &packet, portMAX_DELAY);
+		xPL_WaitLink();
+		busy = telem_start();
+		xPL_HandlePacket(packet.buf, packet.stamp);
+		telem_stop(busy);
 		}
 	}
 
+#endif
+
 // Setup the xPL device object, start the hartbeat and receive tasks
 void ICACHE_FLASH_ATTR xPL_init() {
+	unsigned char i;
+
 	xPL_device.last_heartbeat = 0;
-	xPL_device.hbeat_interval = XPL_DEFAULT_HEARTBEAT_INTERVAL;
 	xPL_device.xpl_accepted = XPL_ACCEPT_ALL;
+	for (i = 0; i < xPL_device.instance_count; i++) {
+		xPL_device.instance[i].hbeat_due = xTaskGetTickCount();		// Everyone says hello right away
+		}
+	xPL_LoadGroups();
+	xPL_FilterLoad();
+	vSemaphoreCreateBinary(xPL_link_sem);
+
+#if EVENT_LOOP
+	ev_set_handler(EV_UDP, xPL_packet_event);
+	hbeat_timer.fn = xPL_hbeat_timer;
+	ev_timer_add(&hbeat_timer, 0);
+#else
+	telem_task_create(xPL_hbeat_task, "Hbt", 512);
+	telem_task_create(xPL_recv_task, "recv", 512);
+#endif
+	}
+
+
+/**
+* \brief     Pause the xPL tasks
+* \details   Called when the link goes down. The tasks stop at their next call to xPL_WaitLink.
+*/
+void ICACHE_FLASH_ATTR xPL_Pause(void) {
+	xPL_link_up = false;
+	xSemaphoreTake(xPL_link_sem, 0);
+	}
+
+/**
+* \brief     Resume the xPL tasks once the link is back up
+*/
+void ICACHE_FLASH_ATTR xPL_Resume(void) {
+	xPL_link_up = true;
+	xSemaphoreGive(xPL_link_sem);
+	}
+
+/**
+* \brief     Block the calling task while the link is down
+* \details   Every task waiting here is released in turn, each one passing the semaphore on to the next.
+* \return    true if the task had to wait
+*/
+bool ICACHE_FLASH_ATTR xPL_WaitLink(void) {
+	if (xPL_link_up)
+		return false;
+
+	xSemaphoreTake(xPL_link_sem, portMAX_DELAY);
+	xSemaphoreGive(xPL_link_sem);
+	return true;
+	}
+
+/// true while the link is up, for tasks that keep running without it
+bool ICACHE_FLASH_ATTR xPL_LinkUp(void) {
+	return xPL_link_up;
+	}
+
+/// FNV-1a hash of a string
+uint32 ICACHE_FLASH_ATTR xPL_Hash(const char *s) {
+	uint32 hash = 2166136261u;
+
+	while (*s) {
+		hash = (hash ^ (unsigned char)*s++) * 16777619u;
+		}
+	return hash;
+	}
+
+// Rebuild the instance id hash table, after an instance was added or renamed
+static void ICACHE_FLASH_ATTR xPL_Rehash(void) {
+	unsigned char i, *bucket;
+
+	memset(xPL_device.bucket, 0, sizeof(xPL_device.bucket));
+	for (i = 0; i < xPL_device.instance_count; i++) {
+		bucket = &xPL_device.bucket[xPL_Hash(xPL_device.instance[i].instance_id) & (XPL_INSTANCE_BUCKETS - 1)];
+		xPL_device.instance[i].next = *bucket;
+		*bucket = i + 1;
+		}
+	}
+
+// Fill in an instance slot
+static void ICACHE_FLASH_ATTR xPL_SetInstance(unsigned char i, const char *_instanceId, xpl_handler handler) {
+	struct xPL_instance *inst = &xPL_device.instance[i];
+
+	strlcpy(inst->instance_id, _instanceId, XPL_INSTANCE_ID_MAX + 1);
+	inst->handler = handler;
+	if (inst->hbeat_interval == 0) inst->hbeat_interval = XPL_DEFAULT_HEARTBEAT_INTERVAL;
+	inst->hbeat_due = xTaskGetTickCount();
+	xPL_Rehash();
+	}
+
+/**
+ * \brief       Add a logical instance
+ * \details   It shares our vendor and device ids, and gets its own heartbeat. Instance 0 is set by xPL_SetSource.
+ *            Instances added after xPL_init send their first heartbeat when the next one of the others is due.
+ * \param    _instanceId     instance id, must not be one we already have
+ * \param    handler         gets the messages for this instance and those for *
+ * \return   index of the new instance, -1 if the id is taken or there is no room left
+ */
+signed char ICACHE_FLASH_ATTR xPL_AddInstance(const char *_instanceId, xpl_handler handler) {
+	if (xPL_device.instance_count == 0)
+		xPL_device.instance_count = 1;				// Keep instance 0 for the device itself
+
+	if (xPL_device.instance_count >= XPL_INSTANCE_MAX || xPL_FindInstance(_instanceId) >= 0)
+		return -1;
+
+	xPL_SetInstance(xPL_device.instance_count++, _instanceId, handler);
+	return xPL_device.instance_count - 1;
+	}
+
+/// Index of the instance with this id, -1 if none
+signed char ICACHE_FLASH_ATTR xPL_FindInstance(const char *_instanceId) {
+	unsigned char i = xPL_device.bucket[xPL_Hash(_instanceId) & (XPL_INSTANCE_BUCKETS - 1)];
+
+	for (; i != 0; i = xPL_device.instance[i - 1].next) {
+		if (strcmp(xPL_device.instance[i - 1].instance_id, _instanceId) == 0)
+			return i - 1;
+		}
+	return -1;
+	}
+
+// Rebuild the group name hash table, after a group was added or emptied
+static void ICACHE_FLASH_ATTR xPL_RehashGroups(void) {
+	unsigned char i, *bucket;
+
+	memset(xPL_group_bucket, 0, sizeof(xPL_group_bucket));
+	for (i = 0; i < XPL_GROUP_MAX; i++) {
+		if (xPL_groups.group[i].members == 0)
+			continue;
+
+		bucket = &xPL_group_bucket[xPL_groups.group[i].hash & (XPL_GROUP_BUCKETS - 1)];
+		xPL_groups.group[i].next = *bucket;
+		*bucket = i + 1;
+		}
+	}
+
+// Slot of the group with this name, -1 if none of our instances is in it
+static signed char ICACHE_FLASH_ATTR xPL_FindGroup(const char *name, uint32 hash) {
+	unsigned char i = xPL_group_bucket[hash & (XPL_GROUP_BUCKETS - 1)];
 
-	xTaskCreate(xPL_hbeat_task, "Hbt", 512, NULL, 2, NULL);
-	xTaskCreate(xPL_recv_task, "recv", 512, NULL, 2, NULL);
+	for (; i != 0; i = xPL_groups.group[i - 1].next) {
+		if (xPL_groups.group[i - 1].hash == hash && strcmp(xPL_groups.group[i - 1].name, name) == 0)
+			return i - 1;
+		}
+	return -1;
+	}
+
+// Group memberships are kept in flash, the instances must all have been added before this
+void ICACHE_FLASH_ATTR xPL_LoadGroups(void) {
+	if (!system_param_load(XPL_GROUP_SECTOR, 0, &xPL_groups, sizeof(xPL_groups)) || xPL_groups.magic != XPL_GROUP_MAGIC) {
+		memset(&xPL_groups, 0, sizeof(xPL_groups));
+		xPL_groups.magic = XPL_GROUP_MAGIC;
+		}
+	xPL_RehashGroups();
+	}
+
+/// Keep the group memberships across a reset
+void ICACHE_FLASH_ATTR xPL_SaveGroups(void) {
+	system_param_save_with_protect(XPL_GROUP_SECTOR, &xPL_groups, sizeof(xPL_groups));
 	}
 
+/// Bitmap of our instances in the xpl-group with this name, without the prefix
+unsigned char ICACHE_FLASH_ATTR xPL_GroupMembers(const char *_group) {
+	signed char i = xPL_FindGroup(_group, xPL_Hash(_group));
+
+	return i < 0 ? 0 : xPL_groups.group[i].members;
+	}
+
+/**
+ * \brief       Add an instance to an xpl-group
+ * \details   The group name is interned, the instances in the same group share its slot.
+ *            Call xPL_SaveGroups to keep the change across a reset.
+ * \param    instance       index of the instance
+ * \param    _group         name of the group, with or without the xpl-group. prefix
+ * \return   false if the name is too long or there is no room left for a new group
+ */
+bool ICACHE_FLASH_ATTR xPL_JoinGroup(unsigned char instance, const char *_group) {
+	signed char i;
+	uint32 hash;
 
-/// Set the source of outgoing xPL messages
+	if (strncasecmp(_group, "xpl-group.", 10) == 0)
+		_group += 10;
+	if (*_group == '\0' || strlen(_group) > XPL_INSTANCE_ID_MAX)
+		return false;
+
+	hash = xPL_Hash(_group);
+	i = xPL_FindGroup(_group, hash);
+	if (i < 0) {
+		for (i = 0; i < XPL_GROUP_MAX && xPL_groups.group[i].members != 0; i++)
+			;
+		if (i == XPL_GROUP_MAX)
+			return false;
+
+		strlcpy(xPL_groups.group[i].name, _group, XPL_INSTANCE_ID_MAX + 1);
+		xPL_groups.group[i].hash = hash;
+		xPL_groups.group[i].members = 1 << instance;
+		xPL_RehashGroups();
+		}
+	else {
+		xPL_groups.group[i].members |= 1 << instance;
+		}
+	return true;
+	}
+
+/// Take an instance out of all its groups, the ones left empty free their slot
+void ICACHE_FLASH_ATTR xPL_LeaveGroups(unsigned char instance) {
+	unsigned char i;
+
+	for (i = 0; i < XPL_GROUP_MAX; i++) {
+		xPL_groups.group[i].members &= ~(1 << instance);
+		}
+	xPL_RehashGroups();
+	}
+
+/// Set the source of outgoing xPL messages, and the instance id of instance 0
 void ICACHE_FLASH_ATTR xPL_SetSource(const char * _vendorId, const char * _deviceId, const char * _instanceId) {
-	strlcpy(xPL_device.source.vendor_id, _vendorId, XPL_VENDOR_ID_MAX);
-	strlcpy(xPL_device.source.device_id, _deviceId, XPL_DEVICE_ID_MAX);
-	strlcpy(xPL_device.source.instance_id, _instanceId, XPL_INSTANCE_ID_MAX);
+	strlcpy(xPL_device.source.vendor_id, _vendorId, XPL_VENDOR_ID_MAX + 1);
+	strlcpy(xPL_device.source.device_id, _deviceId, XPL_DEVICE_ID_MAX + 1);
+	strlcpy(xPL_device.source.instance_id, _instanceId, XPL_INSTANCE_ID_MAX + 1);
+
+	if (xPL_device.instance_count == 0)
+		xPL_device.instance_count = 1;
+	xPL_SetInstance(0, _instanceId, process_message);
 	}
 
 /**
@@ -121,9 +428,30 @@ void ICACHE_FLASH_ATTR xPL_SendMessageBuf(const char *_buffer) {
 	udpio_send(_buffer, XPL_UDP_PORT);
 	}
 
+/**
+ * \brief       Render an xPL message the way it goes out
+ * \details   As a binary frame if the target reads them, see xPL_BinWanted, as text otherwise.
+ * \param    buffer         XPL_MESSAGE_BUFFER_MAX bytes
+ * \return   false if the text is too long for the buffer, counted as a send error
+ */
+bool ICACHE_FLASH_ATTR xPL_RenderMessage(xPL_Message *_message, char *_buffer) {
+#if XPL_BINARY
+	if (xPL_BinWanted(_message) && xPL_BinEncode(_message, _buffer, XPL_MESSAGE_BUFFER_MAX) > 0) {
+		XPL_STATS_INC(bin_tx);
+		xPL_BinSeen(_message);
+		return true;
+		}
+#endif
+	if (!xPL_Message_toString(_message, _buffer, XPL_MESSAGE_BUFFER_MAX)) {
+		XPL_STATS_INC(send_err);
+		return false;
+		}
+	return true;
+	}
+
 /**
  * \brief       Send an xPL message
- * \details   There is no validation of the message, it is sent as is.
+ * \details   There is no validation of the message, it is sent as is, unless its text is too long for a datagram.
  * \param    message         			An xPL message.
  * \param    _useDefaultSource	if true, insert the default source (defined in SetSource) on the message.
  */
@@ -134,12 +462,23 @@ void ICACHE_FLASH_ATTR xPL_SendMessage(xPL_Message *_message, bool _useDefaultSo
 		xPL_Message_SetSource(_message, xPL_device.source.vendor_id, xPL_device.source.device_id, xPL_device.source.instance_id);
 		}
 
-	xPL_Message_toString(_message, xPLMessageBuff);
-	//printf("Sending: %s\n", xPLMessageBuff);
-	xPL_SendMessageBuf(xPLMessageBuff);
+	if (xPLMessageBuff != NULL && xPL_RenderMessage(_message, xPLMessageBuff)) {
+		//printf("Sending: %s\n", xPLMessageBuff);
+		xPL_SendMessageBuf(xPLMessageBuff);
+		}
 	free(xPLMessageBuff);
 	}
 
+/**
+ * \brief       Send an xPL message from one of our instances
+ * \param    message         			An xPL message.
+ * \param    instance	index of the instance, its id goes in the source
+ */
+void ICACHE_FLASH_ATTR xPL_SendInstanceMessage(xPL_Message *_message, unsigned char instance) {
+	xPL_Message_SetSource(_message, xPL_device.source.vendor_id, xPL_device.source.device_id, xPL_device.instance[instance].instance_id);
+	xPL_SendMessage(_message, false);
+	}
+
 /**
  * \brief       Parse an ingoing xPL message
  * \details   Parse a message, check for hearbeat request and call user defined callback for post processing.
@@ -147,47 +486,110 @@ void ICACHE_FLASH_ATTR xPL_SendMessage(xPL_Message *_message, bool _useDefaultSo
  */
 xPL_Message ICACHE_FLASH_ATTR *xPL_ParseInputMessage(const char* _buffer) {
 	xPL_Message *xPLMessage =  new_xPL_Message();
+	unsigned char i;
 
 	//printf("message %s\n", _buffer);
 
+#if XPL_BINARY
+	if ((unsigned char)_buffer[0] == XPL_BIN_VERSION) {
+		xPL_stats.bin_rx++;
+		if (!xPL_BinDecode(xPLMessage, _buffer)) {
+			xPL_stats.bin_fail++;
+			free_xPL_Message(xPLMessage);
+			return new_xPL_Message();			// Empty, for no one
+			}
+		xPL_BinSeen(xPLMessage);
+		if (xPL_bin_gateway) {					// Pass it on as text for everyone else, if it fits
+			xPLMessage->hop++;
+			xPL_SendMessage(xPLMessage, false);
+			xPLMessage->hop--;
+			}
+		}
+	else {
+		xPL_Parse(xPLMessage, _buffer);
+		if (xPL_BinCopy(xPLMessage)) {			// We had the binary original already
+			free_xPL_Message(xPLMessage);
+			return new_xPL_Message();
+			}
+		}
+	xPL_BinCheckHBeat(xPLMessage);
+#else
 	xPL_Parse(xPLMessage, _buffer);
+#endif
+	xPLMessage->targets = xPL_TargetInstances(xPLMessage);
 
 	// check if the message is an hbeat.request to send a heartbeat
 	if (xPL_CheckHBeatRequest(xPLMessage)) {
-		xPL_SendHBeat();
+		for (i = 0; i < xPL_device.instance_count; i++) {
+			if (xPLMessage->targets & (1 << i)) xPL_SendInstanceHBeat(i);
+			}
 		}
+
+	xPL_CheckEspRequest(xPLMessage);
+	xPL_CheckGroupConfig(xPLMessage);
+	xPL_CheckFilterConfig(xPLMessage);
+#if RELIABLE
+	reliable_ack(xPLMessage);
+#endif
 	return xPLMessage;
 	}
 
 /**
  * \brief       Check the xPL message target
- * \details   Check if the xPL message is for us
+ * \details   Find which of our instances the xPL message is for, with a hash lookup on the instance id
+ *            or on the group name for xpl-group targets
  * \param    _message         an xPL message
+ * \return   bitmap of the instances, 0 if none
  */
-bool ICACHE_FLASH_ATTR xPL_TargetIsMe(xPL_Message * _message) {
+unsigned char ICACHE_FLASH_ATTR xPL_TargetInstances(xPL_Message * _message) {
+	signed char i;
+
 	if (_message->target.vendor_id[0] == '*') 
-		return true;
+		return (1 << xPL_device.instance_count) - 1;
+
+	if (strcmp(_message->target.vendor_id, "xpl") == 0 && strcmp(_message->target.device_id, "group") == 0)
+		return xPL_GroupMembers(_message->target.instance_id);
 
 	if (strcmp(_message->target.vendor_id, xPL_device.source.vendor_id) != 0)
-		return false;
+		return 0;
 
 	if (strcmp(_message->target.device_id, xPL_device.source.device_id) != 0)
-		return false;
+		return 0;
 
-	if (strcmp(_message->target.instance_id, xPL_device.source.instance_id) != 0)
-		return false;
+	i = xPL_FindInstance(_message->target.instance_id);
+	return i < 0 ? 0 : 1 << i;
+	}
 
-	return true;
+/**
+ * \brief       Check the xPL message target
+ * \details   Check if the xPL message is for us, any of our instances
+ * \param    _message         an xPL message
+ */
+bool ICACHE_FLASH_ATTR xPL_TargetIsMe(xPL_Message * _message) {
+	return xPL_TargetInstances(_message) != 0;
 	}
 
 /**
- * \brief       Send a heartbeat message
+ * \brief       Send a heartbeat message for each instance
   */
 void ICACHE_FLASH_ATTR xPL_SendHBeat() {
+	unsigned char i;
+
+	for (i = 0; i < xPL_device.instance_count; i++) {
+		xPL_SendInstanceHBeat(i);
+		}
+	}
+
+/**
+ * \brief       Send the heartbeat message of one instance
+  */
+void ICACHE_FLASH_ATTR xPL_SendInstanceHBeat(unsigned char instance) {
+	struct xPL_instance *inst = &xPL_device.instance[instance];
 	char *ipptr = (char *)&ipinfo.ip;
 	char *buffer = malloc(XPL_MESSAGE_BUFFER_MAX);			// On heap, to save stack space
+	int len;
 
-	sprintf(buffer, 
+	len = sprintf(buffer, 
 			"xpl-stat\n{\n"
 			"hop=1\n"
 			"source=%s-%s.%s\n"
@@ -196,9 +598,13 @@ void ICACHE_FLASH_ATTR xPL_SendHBeat() {
 			"interval=%d\n"
 			"port=3865\n"
 			"remote-ip=%d.%d.%d.%d\n"
-			"version=1.0\n}\n"
-			, xPL_device.source.vendor_id, xPL_device.source.device_id, xPL_device.source.instance_id,
-			xPL_device.hbeat_interval, ipptr[0],ipptr[1], ipptr[2], ipptr[3]);
+			"version=1.0\n"
+			, xPL_device.source.vendor_id, xPL_device.source.device_id, inst->instance_id,
+			inst->hbeat_interval, ipptr[0],ipptr[1], ipptr[2], ipptr[3]);
+#if XPL_BINARY
+	len += sprintf(buffer + len, "bin=%d\n", xPL_bin_gateway ? XPL_BIN_GW : XPL_BIN_NODE);
+#endif
+	strcpy(buffer + len, "}\n");
 
 	xPL_SendMessageBuf(buffer);
 	free(buffer);
@@ -209,12 +615,87 @@ void ICACHE_FLASH_ATTR xPL_SendHBeat() {
   * \param    _message         an xPL message
  */
 bool ICACHE_FLASH_ATTR xPL_CheckHBeatRequest(xPL_Message* _message) {
-	if (!xPL_TargetIsMe(_message))
+	if (_message->targets == 0)
 		return false;
 
 	return xPL_Message_IsSchema(_message, XPL_HBEAT_REQUEST_CLASS_ID, XPL_HBEAT_REQUEST_TYPE_ID);
 	}
 
+// esp.request queries, and the routines that send the answers
+static const struct {
+	const char *query;
+	void (*send)(void);
+	} xPL_queries[] = {
+#if TELEMETRY
+	{ "telem", telem_send },
+#endif
+#if LATENCY
+	{ "latency", latency_send },
+#endif
+#if RELIABLE
+	{ "reliable", reliable_send_stats },
+#endif
+	{ "counters", xPL_SendStats },
+	{ NULL, NULL }
+	};
+
+/**
+ * \brief       Answer an esp.request
+ * \details   Each query= line names a status message to send back, e.g. query=telem
+  * \param    _message         an xPL message
+ */
+void ICACHE_FLASH_ATTR xPL_CheckEspRequest(xPL_Message* _message) {
+	unsigned char i, j;
+
+	if (_message->type != XPL_CMND || _message->targets == 0 || !xPL_Message_IsSchema(_message, "esp", "request"))
+		return;
+
+	for (i = 0; i < _message->command_count; i++) {
+		if (strcasecmp(_message->command[i].name, "query") != 0)
+			continue;
+
+		for (j = 0; xPL_queries[j].query != NULL; j++) {
+			if (strcasecmp(_message->command[i].value, xPL_queries[j].query) == 0) {
+				xPL_queries[j].send();
+				}
+			}
+		}
+	}
+
+/**
+ * \brief       Apply the group= lines of a config.response
+ * \details   The instances the message is for leave their groups and join the ones listed, if any.
+ *            An empty group= line just leaves them all. The new memberships are saved in flash.
+  * \param    _message         an xPL message
+ */
+void ICACHE_FLASH_ATTR xPL_CheckGroupConfig(xPL_Message* _message) {
+	unsigned char i, j, left = 0;
+
+	if (_message->type != XPL_CMND || _message->targets == 0 || !xPL_Message_IsSchema(_message, "config", "response"))
+		return;
+
+	for (i = 0; i < _message->command_count; i++) {
+		if (strcasecmp(_message->command[i].name, "group") != 0)
+			continue;
+
+		for (j = 0; j < xPL_device.instance_count; j++) {
+			if (!(_message->targets & (1 << j)))
+				continue;
+
+			if (!(left & (1 << j))) {
+				xPL_LeaveGroups(j);
+				left |= 1 << j;
+				}
+			if (_message->command[i].value[0] != '\0' && !xPL_JoinGroup(j, _message->command[i].value)) {
+				printf("Bad group: %s\n", _message->command[i].value);
+				}
+			}
+		}
+
+	if (left != 0)
+		xPL_SaveGroups();
+	}
+
 /**
  * \brief       Parse a buffer and generate a xPL_Message
  * \details	  Line based xPL parser
@@ -223,7 +704,8 @@ bool ICACHE_FLASH_ATTR xPL_CheckHBeatRequest(xPL_Message* _message) {
  */
 void ICACHE_FLASH_ATTR xPL_Parse(xPL_Message* _xPLMessage, const char* _buffer) {
 	int len = strlen(_buffer);
-	byte i, j=0;
+	int i;
+	byte j=0;
 	byte line=0;
 	int result=0;
 	char *lineBuffer = malloc(XPL_LINE_MESSAGE_BUFFER_MAX+1);
@@ -250,15 +732,23 @@ void ICACHE_FLASH_ATTR xPL_Parse(xPL_Message* _xPLMessage, const char* _buffer)
 					break;
 				}
 
-			if (result < 0) break;
+			if (result < 0 || (line == XPL_MESSAGE_TYPE_IDENTIFIER && result == 0)) {
+				xPL_stats.parse_fail[line - 1]++;
+				break;
+				}
 
 			j = 0; // reset the buffer pointer
 			lineBuffer[0] = '\0'; // clear the buffer
 			}
-		else {
+		else if (j < XPL_LINE_MESSAGE_BUFFER_MAX) {
 			// next character
 			lineBuffer[j++] = _buffer[i];
 			}
+		else {
+			// line too long for the buffer
+			if (line < XPL_PARSE_LINES) xPL_stats.parse_fail[line]++;
+			break;
+			}
 		}
 	free(lineBuffer);
 	}
@@ -269,7 +759,7 @@ void ICACHE_FLASH_ATTR xPL_Parse(xPL_Message* _xPLMessage, const char* _buffer)
  * \param    _buffer         	   the line to parse
  * \param    _line         	       the line number
  */
-byte ICACHE_FLASH_ATTR xPL_AnalyseHeaderLine(xPL_Message* _xPLMessage, const char* _buffer, byte _line) {
+signed char ICACHE_FLASH_ATTR xPL_AnalyseHeaderLine(xPL_Message* _xPLMessage, const char* _buffer, byte _line) {
 	int hopval;
 
 	switch (_line) {
@@ -371,10 +861,17 @@ byte ICACHE_FLASH_ATTR xPL_AnalyseCommandLine(xPL_Message * _xPLMessage, const c
 		return _xPLMessage->command_count+1;
 		}
 	else {	// parse the next command
-		struct_command newcmd;
-
-		sscanf(_buffer, XPL_COMMAND_PARSER, &newcmd.name, &newcmd.value);
-		xPL_Message_AddCommand(_xPLMessage, newcmd.name, newcmd.value);
+		char name[XPL_NAME_LENGTH_MAX + 1];
+		char value[XPL_CONFIG_VALUE_MAX + 1];
+
+		name[0] = '\0';
+		value[0] = '\0';			// name= with nothing after it leaves the value alone
+		sscanf(_buffer, XPL_COMMAND_PARSER, name, value);
+		if (name[0] == '\0')		// No name, it would read as the rest of the line before
+			return _command_line;
+		if (strcmp(_xPLMessage->schema.class_id, "config") != 0)
+			value[XPL_VALUE_LENGTH_MAX] = '\0';		// Only config lines get the longer values
+		xPL_Message_AddCommand(_xPLMessage, name, value);
 
 		return _command_line;
 		}
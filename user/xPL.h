@@ -35,32 +35,86 @@
 
 #define XPL_DEFAULT_HEARTBEAT_INTERVAL   60
 
+#define XPL_INSTANCE_MAX		8		// Logical instances hosted by the device, instance 0 is the device itself
+#define XPL_INSTANCE_BUCKETS	8		// Size of the instance id hash table, a power of 2
+#define XPL_GROUP_MAX			16		// Distinct xpl-group names our instances belong to
+#define XPL_GROUP_BUCKETS		16		// Size of the group name hash table, a power of 2
+#define XPL_GROUP_MAGIC			0x78504C47		// "xPLG"
+
 #define XPL_UDP_PORT 3865
 
 #define XPL_PORT_L  0x19
 #define XPL_PORT_H  0xF
 
 typedef enum {XPL_ACCEPT_ALL, XPL_ACCEPT_SELF, XPL_ACCEPT_SELF_ANY} xpl_accepted_type;
-// XPL_ACCEPT_ALL = all xpl messages
-// XPL_ACCEPT_SELF = only for me
-// XPL_ACCEPT_SELF_ANY = only for me and any (*)
+// XPL_ACCEPT_ALL = all xpl messages for one of our instances, one of their groups or *, the handlers never see the others
+// XPL_ACCEPT_SELF = only for me, * messages are kept from the handlers
+// XPL_ACCEPT_SELF_ANY = only for me and any (*), same as XPL_ACCEPT_ALL
+
+// Handles the messages for one instance, instance is its index
+typedef void (*xpl_handler)(xPL_Message *msg, unsigned char instance);
 
 xPL_Message *xPL_ParseInputMessage(const char *buffer);
+uint32 xPL_Hash(const char *s);
+signed char xPL_AddInstance(const char *instance_id, xpl_handler handler);
+signed char xPL_FindInstance(const char *instance_id);
+unsigned char xPL_TargetInstances(xPL_Message * message);
 bool xPL_TargetIsMe(xPL_Message * message);
+bool xPL_JoinGroup(unsigned char instance, const char *group);
+void xPL_LeaveGroups(unsigned char instance);
+void xPL_LoadGroups(void);
+void xPL_SaveGroups(void);
+unsigned char xPL_GroupMembers(const char *group);
+void xPL_CheckGroupConfig(xPL_Message * message);
 void xPL_SendHBeat();
+void xPL_SendInstanceHBeat(unsigned char instance);
 bool xPL_CheckHBeatRequest(xPL_Message * message);
+void xPL_CheckEspRequest(xPL_Message * message);
 void xPL_Parse(xPL_Message *, const char *);
-unsigned char xPL_AnalyseHeaderLine(xPL_Message *, const char *, unsigned char);
+signed char xPL_AnalyseHeaderLine(xPL_Message *, const char *, unsigned char);
 unsigned char xPL_AnalyseCommandLine(xPL_Message *, const char *, unsigned char, unsigned char);
 void xPL_SendMessageBuf(const char *);
 void xPL_SendMessage(xPL_Message *, bool);
+bool xPL_RenderMessage(xPL_Message *, char *);
+void xPL_SendInstanceMessage(xPL_Message *, unsigned char);
 void xPL_SetSource(const char *x, const char *y, const char *z);  // define my source
+void xPL_Pause(void);
+void xPL_Resume(void);
+bool xPL_WaitLink(void);
+bool xPL_LinkUp(void);
+void xPL_init();
+void xPL_HandlePacket(char *, uint32);
+
+// Received packet, as queued by the UDP callback
+struct udp_packet {
+	char *buf;
+	uint32 stamp;			// latency_now() on arrival
+	};
+
+// One logical xPL device. They all share the vendor and device ids, the socket, the receive queue and the parser.
+struct xPL_instance {
+	char instance_id[XPL_INSTANCE_ID_MAX+1];
+	xpl_handler handler;				// Gets the messages for this instance, and those for *
+	uint32 hbeat_due;					// Tick at which the next heartbeat goes out
+	unsigned char hbeat_interval;		// In s
+	unsigned char next;					// Next instance in the same hash bucket plus 1, 0 at the end
+	};
+
+// One xpl-group name, interned. Saved in flash as is, in XPL_GROUP_SECTOR.
+struct xPL_group {
+	char name[XPL_INSTANCE_ID_MAX+1];		// Without the xpl-group. prefix
+	uint32 hash;						// xPL_Hash of the name
+	unsigned char members;				// Bitmap of our instances in the group, 0 for a free slot
+	unsigned char next;					// Next group in the same hash bucket plus 1, 0 at the end
+	};
 
 struct xPL {
-	struct_id source;  // my source
-	unsigned char hbeat_interval;  // default 5
+	struct_id source;  // my source, with the instance id of instance 0
 	xpl_accepted_type xpl_accepted;
 	unsigned long last_heartbeat;
+	unsigned char instance_count;
+	struct xPL_instance instance[XPL_INSTANCE_MAX];
+	unsigned char bucket[XPL_INSTANCE_BUCKETS];		// First instance with this hash plus 1, 0 if none
 	};
 
 typedef struct xPL xPL;
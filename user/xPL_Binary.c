@@ -0,0 +1,441 @@
+/*
+* xPL for ESP8266
+*
+* Compact binary framing of xPL messages, between our own nodes
+*
+* A frame never holds a 0 byte, so it goes through the same receive buffers and send path as a text
+* message, and the first byte tells them apart. Lengths are all explicit, decoding is a walk over the
+* frame that checks each length against what is left, and never scans for line ends or separators.
+*
+*   XPL_BIN_VERSION
+*   type | hop << 2
+*   source vendor, device, instance			strings
+*   target vendor, device, instance			strings, a * target has empty device and instance
+*   schema									index in bin_schemas plus 1, or BIN_LITERAL then class and type strings
+*   then up to the end of the frame, for each body line:
+*     name									index in bin_names plus 1, or BIN_LITERAL then a string
+*     value									BIN_INTEGER then an integer, or a string
+*
+* A string is its length plus 1, then its characters. An integer is zigzag encoded, then written
+* as base 127 digits, lowest first, each plus 1, with BIN_MORE set on all but the last.
+* Only canonical decimal values (no leading zeros, no + sign) go as integers, so they come back as they went.
+*
+* The schema and name tables are part of the format: only ever add entries at the end,
+* and change XPL_BIN_VERSION if an entry has to go.
+*
+* Binary capable sources are found from the bin= line of their heartbeats, and nothing goes out binary
+* until a gateway has said bin=2, so the other xPL applications always get to see the traffic.
+* A gateway re-sends what it decodes as text with the hop count bumped. Nodes remember the frames they
+* decoded or sent for a moment, by source and a digest of the rest, and drop the text copy of those only.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "esp_common.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include "UserConfig.h"
+#include "xPL.h"
+#include "xPL_Binary.h"
+
+#if XPL_BINARY
+
+#define BIN_LITERAL			0xFF		// Schema or name not in the tables, spelled out
+#define BIN_INTEGER			0x80		// Value tag, an integer follows
+#define BIN_MORE			0x80		// Integer digit, more digits follow
+#define BIN_INT_DIGITS		5			// 127^5 > 2^32
+
+static const struct {
+	const char *class_id;
+	const char *type_id;
+	} bin_schemas[] = {
+	{ "x10", "basic" }, { "sensor", "basic" }, { "sensor", "request" }, { "control", "basic" },
+	{ "esp", "request" }, { "esp", "ack" }, { "esp", "batch" }, { "esp", "counters" },
+	{ "hbeat", "app" }, { "hbeat", "request" }, { "config", "response" }, { "config", "app" },
+	};
+
+static const char *bin_names[] = {
+	"command", "device", "type", "current", "level", "data1", "msgid", "scene",
+	"query", "units", "interval", "rx", "tx", "drop", "parse", "bin",
+	};
+
+#define BIN_SCHEMAS		(sizeof(bin_schemas) / sizeof(bin_schemas[0]))
+#define BIN_NAMES		(sizeof(bin_names) / sizeof(bin_names[0]))
+
+// A binary capable source, from its heartbeat
+struct bin_peer {
+	uint32 hash;						// xPL_Hash of vendor-device.instance
+	unsigned char role;					// XPL_BIN_NODE or XPL_BIN_GW, 0 for a free slot
+	};
+
+static struct bin_peer peers[XPL_BIN_PEERS];
+static unsigned char peer_next;			// Slot to reuse when the table is full
+
+// A frame decoded or sent lately, whose text copy from the gateway is to be dropped
+struct bin_recent {
+	uint32 source;						// bin_hash of the source
+	uint32 digest;						// bin_digest of the message
+	portTickType time;					// When it was seen, 0 for a free or used up slot
+	};
+
+static struct bin_recent recent[XPL_BIN_RECENT];
+static unsigned char recent_next;
+
+unsigned char xPL_bin_gateway = XPL_BIN_GATEWAY;
+
+// Append a length prefixed string, returns the new end, NULL if it does not fit
+static char ICACHE_FLASH_ATTR *bin_put_string(char *p, const char *end, const char *s) {
+	size_t len = strlen(s);
+
+	if (p == NULL || len + 1 > end - p)
+		return NULL;
+	*p++ = len + 1;
+	memcpy(p, s, len);
+	return p + len;
+	}
+
+// Append a table index plus 1, or BIN_LITERAL if the index is -1
+static char ICACHE_FLASH_ATTR *bin_put_index(char *p, const char *end, int index) {
+	if (p == NULL || p == end)
+		return NULL;
+	*p++ = index < 0 ? BIN_LITERAL : index + 1;
+	return p;
+	}
+
+// The value as an integer, if writing it back in decimal gives the same string
+static bool ICACHE_FLASH_ATTR bin_integer(const char *s, sint32 *value) {
+	const char *d = s + (*s == '-');
+	sint32 v = 0;
+
+	if (*d == '\0' || strlen(d) > 9 || (d[0] == '0' && (d[1] != '\0' || d != s)))
+		return false;
+	for (; *d; d++) {
+		if (*d < '0' || *d > '9')
+			return false;
+		v = v * 10 + *d - '0';
+		}
+	*value = *s == '-' ? -v : v;
+	return true;
+	}
+
+static char ICACHE_FLASH_ATTR *bin_put_integer(char *p, const char *end, sint32 value) {
+	uint32 u = ((uint32)value << 1) ^ (uint32)(value >> 31);
+
+	if (p == NULL || p == end)
+		return NULL;
+	*p++ = BIN_INTEGER;
+	do {
+		if (p == end)
+			return NULL;
+		*p = u % 127 + 1;
+		u /= 127;
+		if (u != 0) *p |= BIN_MORE;
+		p++;
+		} while (u != 0);
+	return p;
+	}
+
+/**
+* \brief     Encode a message as a binary frame
+* \param     buf    where the frame goes, NUL terminated
+* \param     size   size of buf
+* \return    length of the frame, 0 if the message does not fit or cannot be encoded
+*/
+int ICACHE_FLASH_ATTR xPL_BinEncode(xPL_Message *msg, char *buf, int size) {
+	const char *end = buf + size - 1;		// Room for the NUL
+	char *p = buf;
+	int hop = msg->hop > 1 ? msg->hop : 1;		// Like xPL_Message_toString
+	sint32 value;
+	int i, k;
+
+	if (size < 3 || msg->type < XPL_CMND || msg->type > XPL_TRIG || hop > 63)
+		return 0;
+
+	*p++ = XPL_BIN_VERSION;
+	*p++ = msg->type | hop << 2;
+	p = bin_put_string(p, end, msg->source.vendor_id);
+	p = bin_put_string(p, end, msg->source.device_id);
+	p = bin_put_string(p, end, msg->source.instance_id);
+	p = bin_put_string(p, end, msg->target.vendor_id);
+	p = bin_put_string(p, end, msg->target.vendor_id[0] == '*' ? "" : msg->target.device_id);
+	p = bin_put_string(p, end, msg->target.vendor_id[0] == '*' ? "" : msg->target.instance_id);
+
+	for (k = BIN_SCHEMAS - 1; k >= 0; k--) {
+		if (xPL_Message_IsSchema(msg, bin_schemas[k].class_id, bin_schemas[k].type_id)) break;
+		}
+	p = bin_put_index(p, end, k);
+	if (k < 0) {
+		p = bin_put_string(p, end, msg->schema.class_id);
+		p = bin_put_string(p, end, msg->schema.type_id);
+		}
+
+	for (i = 0; i < msg->command_count; i++) {
+		for (k = BIN_NAMES - 1; k >= 0; k--) {
+			if (strcmp(msg->command[i].name, bin_names[k]) == 0) break;
+			}
+		p = bin_put_index(p, end, k);
+		if (k < 0) p = bin_put_string(p, end, msg->command[i].name);
+
+		if (bin_integer(msg->command[i].value, &value))
+			p = bin_put_integer(p, end, value);
+		else
+			p = bin_put_string(p, end, msg->command[i].value);
+		}
+
+	if (p == NULL)
+		return 0;
+	*p = '\0';
+	return p - buf;
+	}
+
+// Read a length prefixed string of up to max characters, returns what follows it, NULL if it is bad
+static const unsigned char ICACHE_FLASH_ATTR *bin_get_string(const unsigned char *p, const unsigned char *end, char *dest, int max) {
+	int len;
+
+	if (p == NULL || p == end)
+		return NULL;
+	len = *p++ - 1;
+	if (len > max || len > end - p)
+		return NULL;
+	memcpy(dest, p, len);
+	dest[len] = '\0';
+	return p + len;
+	}
+
+static const unsigned char ICACHE_FLASH_ATTR *bin_get_integer(const unsigned char *p, const unsigned char *end, char *dest) {
+	uint32 u = 0, scale = 1, digit;
+	unsigned char i;
+
+	for (i = 0; i < BIN_INT_DIGITS; i++, scale *= 127) {
+		if (p == end)
+			return NULL;
+		digit = (*p & ~BIN_MORE) - 1;
+		if (digit > 126 || digit > (0xFFFFFFFFu - u) / scale)
+			return NULL;
+		u += digit * scale;
+		if ((*p++ & BIN_MORE) == 0) {
+			sprintf(dest, "%d", (sint32)((u >> 1) ^ -(u & 1)));
+			return p;
+			}
+		}
+	return NULL;
+	}
+
+/**
+* \brief     Decode a binary frame
+* \details   Every length is checked against the end of the frame, and against the size of the
+*            message field it goes to. A field too long is an error, not truncated.
+* \param     buf   the frame, NUL terminated, as it came from the network
+* \return    false if the frame is malformed, msg is then only partly filled
+*/
+bool ICACHE_FLASH_ATTR xPL_BinDecode(xPL_Message *msg, const char *buf) {
+	const unsigned char *p = (const unsigned char *)buf;
+	const unsigned char *end = p + strlen(buf);
+	char name[XPL_NAME_LENGTH_MAX + 1];
+	char value[XPL_VALUE_LENGTH_MAX + 1];
+	unsigned char k;
+
+	if (end - p < 3 || p[0] != XPL_BIN_VERSION)
+		return false;
+	msg->type = p[1] & 3;
+	msg->hop = p[1] >> 2;
+	if (msg->type == 0 || msg->hop == 0)
+		return false;
+	p += 2;
+
+	p = bin_get_string(p, end, msg->source.vendor_id, XPL_VENDOR_ID_MAX);
+	p = bin_get_string(p, end, msg->source.device_id, XPL_DEVICE_ID_MAX);
+	p = bin_get_string(p, end, msg->source.instance_id, XPL_INSTANCE_ID_MAX);
+	p = bin_get_string(p, end, msg->target.vendor_id, XPL_VENDOR_ID_MAX);
+	p = bin_get_string(p, end, msg->target.device_id, XPL_DEVICE_ID_MAX);
+	p = bin_get_string(p, end, msg->target.instance_id, XPL_INSTANCE_ID_MAX);
+	if (p == NULL || p == end)
+		return false;
+
+	k = *p++;
+	if (k == BIN_LITERAL) {
+		p = bin_get_string(p, end, msg->schema.class_id, XPL_CLASS_ID_MAX);
+		p = bin_get_string(p, end, msg->schema.type_id, XPL_TYPE_ID_MAX);
+		if (p == NULL)
+			return false;
+		}
+	else if (k <= BIN_SCHEMAS) {
+		xPL_Message_SetSchema(msg, bin_schemas[k - 1].class_id, bin_schemas[k - 1].type_id);
+		}
+	else {
+		return false;
+		}
+
+	while (p < end) {
+		k = *p++;
+		if (k == BIN_LITERAL)
+			p = bin_get_string(p, end, name, XPL_NAME_LENGTH_MAX);
+		else if (k <= BIN_NAMES)
+			strcpy(name, bin_names[k - 1]);
+		else
+			return false;
+
+		if (p == NULL || p == end)
+			return false;
+		if (*p == BIN_INTEGER)
+			p = bin_get_integer(p + 1, end, value);
+		else
+			p = bin_get_string(p, end, value, XPL_VALUE_LENGTH_MAX);
+		if (p == NULL || !xPL_Message_AddCommand(msg, name, value))
+			return false;
+		}
+	return true;
+	}
+
+static uint32 ICACHE_FLASH_ATTR bin_hash(struct struct_id *id) {
+	char name[XPL_VENDOR_ID_MAX + XPL_DEVICE_ID_MAX + XPL_INSTANCE_ID_MAX + 3];
+
+	sprintf(name, "%s-%s.%s", id->vendor_id, id->device_id, id->instance_id);
+	return xPL_Hash(name);
+	}
+
+// Peers are told apart by the hash of their name only, the table is far too small for a collision to matter
+static struct bin_peer ICACHE_FLASH_ATTR *bin_find(uint32 hash) {
+	unsigned char i;
+
+	for (i = 0; i < XPL_BIN_PEERS; i++) {
+		if (peers[i].role != 0 && peers[i].hash == hash) return &peers[i];
+		}
+	return NULL;
+	}
+
+/**
+* \brief     Learn binary capable sources from their heartbeats
+* \details   hbeat.app and config.app with a bin= line add the source, hbeat.end and config.end remove it.
+*/
+void ICACHE_FLASH_ATTR xPL_BinCheckHBeat(xPL_Message *msg) {
+	struct bin_peer *peer;
+	unsigned char i, role = 0;
+
+	if (msg->type != XPL_STAT || (strcmp(msg->schema.class_id, "hbeat") != 0 && strcmp(msg->schema.class_id, "config") != 0))
+		return;
+
+	if (strcmp(msg->schema.type_id, "app") == 0) {
+		for (i = 0; i < msg->command_count; i++) {
+			if (strcmp(msg->command[i].name, "bin") == 0) role = atoi(msg->command[i].value);
+			}
+		}
+	else if (strcmp(msg->schema.type_id, "end") != 0) {
+		return;
+		}
+
+	peer = bin_find(bin_hash(&msg->source));
+	if (peer == NULL && role != 0) {
+		peer = &peers[peer_next];
+		peer_next = (peer_next + 1) % XPL_BIN_PEERS;
+		peer->hash = bin_hash(&msg->source);
+		}
+	if (peer != NULL) peer->role = role;
+	}
+
+/**
+* \brief     Should this message go out as a binary frame
+* \details   Only once a gateway is there to translate for the other xPL applications,
+*            then if it is for a binary capable peer, or for everyone.
+*            Heartbeats and config messages stay text, they are how everyone finds everyone else.
+*            A gateway only sends text.
+*/
+bool ICACHE_FLASH_ATTR xPL_BinWanted(xPL_Message *msg) {
+	unsigned char i;
+
+	if (xPL_bin_gateway || strcmp(msg->schema.class_id, "hbeat") == 0 || strcmp(msg->schema.class_id, "config") == 0)
+		return false;
+
+	for (i = 0; i < XPL_BIN_PEERS && peers[i].role != XPL_BIN_GW; i++)
+		;
+	if (i == XPL_BIN_PEERS)
+		return false;
+
+	if (msg->target.vendor_id[0] == '*' || (strcmp(msg->target.vendor_id, "xpl") == 0 && strcmp(msg->target.device_id, "group") == 0))
+		return true;
+	return bin_find(bin_hash(&msg->target)) != NULL;
+	}
+
+static uint32 ICACHE_FLASH_ATTR bin_mix(uint32 hash, const char *s) {
+	return (hash ^ xPL_Hash(s)) * 16777619u;
+	}
+
+// Digest of all but the source and hop count, the same for a frame and for its text copy
+static uint32 ICACHE_FLASH_ATTR bin_digest(xPL_Message *msg) {
+	uint32 hash = 2166136261u ^ msg->type;
+	unsigned char i;
+
+	hash = bin_mix(hash, msg->target.vendor_id);
+	if (msg->target.vendor_id[0] != '*') {
+		hash = bin_mix(hash, msg->target.device_id);
+		hash = bin_mix(hash, msg->target.instance_id);
+		}
+	hash = bin_mix(hash, msg->schema.class_id);
+	hash = bin_mix(hash, msg->schema.type_id);
+	for (i = 0; i < msg->command_count; i++) {
+		hash = bin_mix(hash, msg->command[i].name);
+		hash = bin_mix(hash, msg->command[i].value);
+		}
+	return hash;
+	}
+
+/**
+* \brief     Remember a frame that was decoded or sent, to drop the gateway's text copy of it
+*/
+void ICACHE_FLASH_ATTR xPL_BinSeen(xPL_Message *msg) {
+	uint32 source = bin_hash(&msg->source), digest = bin_digest(msg);
+	portTickType now = xTaskGetTickCount();
+
+	taskENTER_CRITICAL();
+	recent[recent_next].source = source;
+	recent[recent_next].digest = digest;
+	recent[recent_next].time = now ? now : 1;
+	recent_next = (recent_next + 1) % XPL_BIN_RECENT;
+	taskEXIT_CRITICAL();
+	}
+
+/**
+* \brief     Is this text message a gateway's copy of a binary frame we already have
+* \details   The copy has gone through one more hop, and matches a frame seen in the last XPL_BIN_COPY_WAIT ticks.
+*            Each frame drops one copy, a message that really is sent again gets through.
+*/
+bool ICACHE_FLASH_ATTR xPL_BinCopy(xPL_Message *msg) {
+	uint32 source, digest;
+	portTickType now;
+	unsigned char i;
+	bool copy = false;
+
+	if (xPL_bin_gateway || msg->hop < 2)
+		return false;
+
+	source = bin_hash(&msg->source);
+	digest = bin_digest(msg);
+	now = xTaskGetTickCount();
+
+	taskENTER_CRITICAL();
+	for (i = 0; i < XPL_BIN_RECENT && !copy; i++) {
+		if (recent[i].time != 0 && now - recent[i].time <= XPL_BIN_COPY_WAIT && recent[i].source == source && recent[i].digest == digest) {
+			recent[i].time = 0;
+			copy = true;
+			}
+		}
+	taskEXIT_CRITICAL();
+	return copy;
+	}
+
+#endif
@@ -0,0 +1,43 @@
+/*
+* xPL for ESP8266
+*
+* Compact binary framing of xPL messages, between our own nodes
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef xPLBinary_h
+#define xPLBinary_h
+
+#include "xPL_Message.h"
+
+#define XPL_BIN_VERSION		0xB1		// First byte of a binary frame, never the start of a text message
+
+// What a heartbeat bin= line says about its sender
+#define XPL_BIN_NODE		1			// Reads binary frames
+#define XPL_BIN_GW			2			// And turns them back into text for the other applications
+
+extern unsigned char xPL_bin_gateway;
+
+int xPL_BinEncode(xPL_Message *msg, char *buf, int size);
+bool xPL_BinDecode(xPL_Message *msg, const char *buf);
+bool xPL_BinWanted(xPL_Message *msg);
+void xPL_BinSeen(xPL_Message *msg);
+bool xPL_BinCopy(xPL_Message *msg);
+void xPL_BinCheckHBeat(xPL_Message *msg);
+
+#endif
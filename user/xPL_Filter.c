@@ -0,0 +1,238 @@
+/*
+* xPL for ESP8266
+*
+* Receive filters
+*
+* A filter is msgtype.vendor.device.instance.class.type, any part can be *, and it matches the
+* message type, the source and the schema of a received message. With no filters set everything gets through.
+* The filters are compiled into one table per field. Each distinct value a filter asks for is interned
+* in its field's table, with a bitmap of the filters that want it, and each field has a bitmap of the
+* filters that take any value. A message is checked with one hash lookup per field and an AND of the
+* bitmaps, whatever the number of filters.
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "esp_common.h"
+#include <stdio.h>
+#include "UserConfig.h"
+#include "xPL.h"
+#include "xPL_Filter.h"
+
+// The string fields, in filter order after the message type
+#define FILTER_VENDOR		0
+#define FILTER_DEVICE		1
+#define FILTER_INSTANCE		2
+#define FILTER_CLASS		3
+#define FILTER_TYPE			4
+#define FILTER_FIELDS		5
+
+// One value some filters want for a field, interned
+struct filter_key {
+	char value[XPL_INSTANCE_ID_MAX+1];
+	uint32 hash;						// xPL_Hash of the value
+	unsigned char filters;				// Bitmap of the filters that want it, 0 for a free slot
+	unsigned char next;					// Next key in the same hash bucket plus 1, 0 at the end
+	};
+
+struct filter_field {
+	struct filter_key key[XPL_FILTER_MAX];		// Each filter has at most one value per field
+	unsigned char bucket[XPL_FILTER_MAX];		// First key with this hash plus 1, 0 if none
+	unsigned char any;							// Filters with * in this field
+	};
+
+static struct {
+	unsigned char count;						// Filters compiled in
+	unsigned char msgtype[4];					// Filters for each message type, XPL_CMND to XPL_TRIG
+	struct filter_field field[FILTER_FIELDS];
+	} filters;
+
+static const unsigned char field_len[FILTER_FIELDS] = {
+	XPL_VENDOR_ID_MAX, XPL_DEVICE_ID_MAX, XPL_INSTANCE_ID_MAX, XPL_CLASS_ID_MAX, XPL_TYPE_ID_MAX
+	};
+
+/// Forget all the filters, everything gets through again
+void ICACHE_FLASH_ATTR xPL_FilterClear(void) {
+	memset(&filters, 0, sizeof(filters));
+	}
+
+// Add the filter bit to the key for this value, interning it if it is new
+static void ICACHE_FLASH_ATTR xPL_FilterIntern(struct filter_field *field, const char *value, unsigned char bit) {
+	uint32 hash = xPL_Hash(value);
+	unsigned char *bucket = &field->bucket[hash & (XPL_FILTER_MAX - 1)];
+	unsigned char i;
+
+	for (i = *bucket; i != 0; i = field->key[i - 1].next) {
+		if (field->key[i - 1].hash == hash && strcmp(field->key[i - 1].value, value) == 0) {
+			field->key[i - 1].filters |= bit;
+			return;
+			}
+		}
+
+	for (i = 0; field->key[i].filters != 0; i++)	// There is always a free one, a filter has one key per field at most
+		;
+	strlcpy(field->key[i].value, value, XPL_INSTANCE_ID_MAX + 1);
+	field->key[i].hash = hash;
+	field->key[i].filters = bit;
+	field->key[i].next = *bucket;
+	*bucket = i + 1;
+	}
+
+/**
+* \brief     Compile one more filter into the tables
+* \param     filter   msgtype.vendor.device.instance.class.type, e.g. xpl-cmnd.*.*.*.x10.basic
+* \return    false if it is malformed or there is no room left
+*/
+bool ICACHE_FLASH_ATTR xPL_FilterAdd(const char *filter) {
+	char buf[XPL_FILTER_LEN + 1];
+	char *part[FILTER_FIELDS + 1], *p;
+	unsigned char i, type, bit;
+
+	if (filters.count >= XPL_FILTER_MAX || strlcpy(buf, filter, sizeof(buf)) >= sizeof(buf))
+		return false;
+
+	// Split and check everything before touching the tables
+	for (i = 0, p = buf; i <= FILTER_FIELDS; i++) {
+		part[i] = p;
+		p = strchr(p, '.');
+		if ((p == NULL) != (i == FILTER_FIELDS))
+			return false;
+		if (p != NULL) *p++ = '\0';
+		if (*part[i] == '\0' || (i > 0 && strlen(part[i]) > field_len[i - 1]))
+			return false;
+		}
+
+	if (strcmp(part[0], "*") == 0) type = 0;
+	else if (strcasecmp(part[0], "xpl-cmnd") == 0) type = XPL_CMND;
+	else if (strcasecmp(part[0], "xpl-stat") == 0) type = XPL_STAT;
+	else if (strcasecmp(part[0], "xpl-trig") == 0) type = XPL_TRIG;
+	else return false;
+
+	bit = 1 << filters.count++;
+	for (i = XPL_CMND; i <= XPL_TRIG; i++) {
+		if (type == 0 || type == i) filters.msgtype[i] |= bit;
+		}
+
+	for (i = 0; i < FILTER_FIELDS; i++) {
+		if (strcmp(part[i + 1], "*") == 0)
+			filters.field[i].any |= bit;
+		else
+			xPL_FilterIntern(&filters.field[i], part[i + 1], bit);
+		}
+	return true;
+	}
+
+// Filters that accept this value for the field
+static unsigned char ICACHE_FLASH_ATTR xPL_FilterField(const struct filter_field *field, const char *value) {
+	uint32 hash = xPL_Hash(value);
+	unsigned char i = field->bucket[hash & (XPL_FILTER_MAX - 1)];
+
+	for (; i != 0; i = field->key[i - 1].next) {
+		if (field->key[i - 1].hash == hash && strcmp(field->key[i - 1].value, value) == 0)
+			return field->key[i - 1].filters | field->any;
+		}
+	return field->any;
+	}
+
+/**
+* \brief     Does any of the filters let the message through
+* \details   hbeat and config messages always get through, so the device can still be found and set up.
+*/
+bool ICACHE_FLASH_ATTR xPL_FilterAccepts(xPL_Message *msg) {
+	const char *value[FILTER_FIELDS];
+	unsigned char match, i;
+
+	if (filters.count == 0 || strcmp(msg->schema.class_id, "hbeat") == 0 || strcmp(msg->schema.class_id, "config") == 0)
+		return true;
+
+	value[FILTER_VENDOR] = msg->source.vendor_id;
+	value[FILTER_DEVICE] = msg->source.device_id;
+	value[FILTER_INSTANCE] = msg->source.instance_id;
+	value[FILTER_CLASS] = msg->schema.class_id;
+	value[FILTER_TYPE] = msg->schema.type_id;
+
+	match = filters.msgtype[msg->type & 3];
+	for (i = 0; i < FILTER_FIELDS && match != 0; i++) {
+		match &= xPL_FilterField(&filters.field[i], value[i]);
+		}
+	return match != 0;
+	}
+
+// Compile a set of filter lines, the bad ones are skipped
+static void ICACHE_FLASH_ATTR xPL_FilterCompile(const struct xpl_filter_set *set) {
+	unsigned char i;
+
+	xPL_FilterClear();
+	for (i = 0; i < set->count; i++) {
+		if (!xPL_FilterAdd(set->line[i])) {
+			printf("Bad filter: %s\n", set->line[i]);
+			}
+		}
+	}
+
+/// Compile the filters saved in flash, if any
+void ICACHE_FLASH_ATTR xPL_FilterLoad(void) {
+	struct xpl_filter_set *set = malloc(sizeof(struct xpl_filter_set));		// On heap, to save stack space
+
+	if (set == NULL)
+		return;
+
+	if (system_param_load(XPL_FILTER_SECTOR, 0, set, sizeof(*set)) && set->magic == XPL_FILTER_MAGIC && set->count <= XPL_FILTER_MAX) {
+		xPL_FilterCompile(set);
+		}
+	free(set);
+	}
+
+/**
+* \brief     Apply the filter= lines of a config.response
+* \details   They replace the filters of the whole device, whichever instance the message is for.
+*            An empty filter= line clears them. The new set is saved in flash.
+*/
+void ICACHE_FLASH_ATTR xPL_CheckFilterConfig(xPL_Message *msg) {
+	struct xpl_filter_set *set;
+	char value[XPL_CONFIG_VALUE_MAX + 1];
+	unsigned char i, found = 0;
+
+	if (msg->type != XPL_CMND || msg->targets == 0 || !xPL_Message_IsSchema(msg, "config", "response"))
+		return;
+
+	set = malloc(sizeof(struct xpl_filter_set));
+	if (set == NULL)
+		return;
+
+	memset(set, 0, sizeof(*set));
+	set->magic = XPL_FILTER_MAGIC;
+	for (i = 0; i < msg->command_count; i++) {
+		if (strcasecmp(msg->command[i].name, "filter") != 0)
+			continue;
+
+		found = 1;
+		xPL_Message_GetValue(msg, i, value);
+		if (strlen(value) > XPL_FILTER_LEN) {		// Can't be a filter, and cut short it would be another one
+			printf("Bad filter: %s\n", value);
+			}
+		else if (value[0] != '\0' && set->count < XPL_FILTER_MAX) {
+			strcpy(set->line[set->count++], value);
+			}
+		}
+
+	if (found) {
+		xPL_FilterCompile(set);
+		system_param_save_with_protect(XPL_FILTER_SECTOR, set, sizeof(*set));
+		}
+	free(set);
+	}
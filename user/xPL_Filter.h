@@ -0,0 +1,45 @@
+/*
+* xPL for ESP8266
+*
+* Receive filters, compiled from standard xPL filter expressions
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef xPLFilter_h
+#define xPLFilter_h
+
+#include "xPL_Message.h"
+
+#define XPL_FILTER_MAX		8			// filter= lines, each one is a bit in the compiled tables (a power of 2)
+#define XPL_FILTER_LEN		61			// msgtype.vendor.device.instance.class.type at their longest: 8+8+8+16+8+8 and 5 dots
+#define XPL_FILTER_MAGIC	0x78504C46	// "xPLF"
+
+// The filter lines, as saved in flash
+struct xpl_filter_set {
+	uint32 magic;
+	unsigned char count;
+	char line[XPL_FILTER_MAX][XPL_FILTER_LEN + 1];
+	};
+
+bool xPL_FilterAdd(const char *filter);
+void xPL_FilterClear(void);
+bool xPL_FilterAccepts(xPL_Message *msg);
+void xPL_FilterLoad(void);
+void xPL_CheckFilterConfig(xPL_Message *msg);
+
+#endif
@@ -85,7 +85,7 @@ bool ICACHE_FLASH_ATTR xPL_Message_CreateCommand(xPL_Message *this) {
 	struct_command	*ncommand;
 	// Maximun command reach
 	// To avoid oom, we arbitrary accept only XPL_MESSAGE_COMMAND_MAX command
-	if (this->command_count > XPL_MESSAGE_COMMAND_MAX)
+	if (this->command_count >= XPL_MESSAGE_COMMAND_MAX)
 		return false;
 
 	ncommand = (struct_command*) malloc((this->command_count + 1) * sizeof(struct_command));
@@ -105,59 +105,88 @@ bool ICACHE_FLASH_ATTR xPL_Message_CreateCommand(xPL_Message *this) {
 
 /**
  * \brief       Add a command to the message's body
- * \details	  char* Version
+ * \details	  char* Version. A value longer than XPL_VALUE_LENGTH_MAX, up to XPL_CONFIG_VALUE_MAX, spills over into
+ *            more commands with no name, so only the few lines that need it pay for the room. See xPL_Message_GetValue.
  * \param    _name         name of the command
  * \param    _value         value of the command
  */
 bool ICACHE_FLASH_ATTR xPL_Message_AddCommand(xPL_Message *this, const char* _name, const char* _value) {
-	if(!xPL_Message_CreateCommand(this)) return false;
+	unsigned char first = this->command_count;
+	struct_command *cmd;
+	int len = strlen(_value), pos = 0, part;
+
+	do {
+		if (!xPL_Message_CreateCommand(this)) {
+			this->command_count = first;
+			return false;
+			}
 
-	struct_command newcmd;
-	strlcpy(newcmd.name, _name, XPL_NAME_LENGTH_MAX + 1);
-	strlcpy(newcmd.value, _value, XPL_VALUE_LENGTH_MAX + 1);
-	this->command[this->command_count - 1] = newcmd;
+		part = XPL_CONFIG_VALUE_MAX - pos < XPL_VALUE_LENGTH_MAX ? XPL_CONFIG_VALUE_MAX - pos : XPL_VALUE_LENGTH_MAX;
+		cmd = &this->command[this->command_count - 1];
+		strlcpy(cmd->name, pos == 0 ? _name : "", XPL_NAME_LENGTH_MAX + 1);
+		strlcpy(cmd->value, _value + pos, part + 1);
+		pos += part;
+		} while (pos < len && pos < XPL_CONFIG_VALUE_MAX);
 	return true;
 	}
 
+/**
+ * \brief       Value of a command, with the parts that spilled over into the commands after it
+ * \param    _index         the command, not one of the spilled over parts
+ * \param    _value         XPL_CONFIG_VALUE_MAX + 1 bytes
+ * \return      _value
+ */
+const char ICACHE_FLASH_ATTR *xPL_Message_GetValue(xPL_Message *this, unsigned char _index, char *_value) {
+	int len;
+
+	strlcpy(_value, this->command[_index].value, XPL_CONFIG_VALUE_MAX + 1);
+	while (++_index < this->command_count && this->command[_index].name[0] == '\0') {
+		len = strlen(_value);
+		strlcpy(_value + len, this->command[_index].value, XPL_CONFIG_VALUE_MAX + 1 - len);
+		}
+	return _value;
+	}
+
 /**
  * \brief       Convert xPL_Message to char* buffer
+ * \details	  Each piece is only written while there is room, pos keeps counting past the end so the check at the end sees it.
+ * \param    _size          size of message_buffer
+ * \return      false, and an empty buffer, if the text does not fit
  */
-void ICACHE_FLASH_ATTR xPL_Message_toString(xPL_Message *this, char message_buffer[]) {
+bool ICACHE_FLASH_ATTR xPL_Message_toString(xPL_Message *this, char message_buffer[], int _size) {
+	const char *type = this->type == XPL_CMND ? "xpl-cmnd" : this->type == XPL_STAT ? "xpl-stat" : "xpl-trig";
 	int pos;
 	unsigned char i;
 
-	message_buffer[0] = '\0';
-
-	switch (this->type) {
-		case (XPL_CMND):
-			pos = sprintf(message_buffer, "xpl-cmnd");
-			break;
-		case (XPL_STAT):
-			pos = sprintf(message_buffer, "xpl-stat");
-			break;
-		case (XPL_TRIG):
-			pos = sprintf(message_buffer, "xpl-trig");
-			break;
+	pos = snprintf(message_buffer, _size, "%s\n{\nhop=%d\nsource=%s-%s.%s\ntarget="
+		, type, this->hop > 1 ? this->hop : 1, this->source.vendor_id, this->source.device_id, this->source.instance_id);		// Relayed messages keep their count
+
+	if (pos < _size) {
+		if (this->target.vendor_id[0] == '*') // check if broadcast message
+			pos += snprintf(message_buffer + pos, _size - pos, "*\n}\n");
+		else
+			pos += snprintf(message_buffer + pos, _size - pos, "%s-%s.%s\n}\n"
+				, this->target.vendor_id, this->target.device_id, this->target.instance_id);
 		}
 
-	pos += sprintf(message_buffer + pos, "\n{\nhop=1\nsource=%s-%s.%s\ntarget="
-		, this->source.vendor_id, this->source.device_id, this->source.instance_id);
+	if (pos < _size)
+		pos += snprintf(message_buffer + pos, _size - pos, "%s.%s\n{\n", this->schema.class_id, this->schema.type_id);
 
-	if (this->target.vendor_id[0] == '*') { // check if broadcast message
-		pos += sprintf(message_buffer + pos, "*\n}\n");
-		}
-	else {
-		pos += sprintf(message_buffer + pos, "%s-%s.%s\n}\n"
-			, this->target.vendor_id, this->target.device_id, this->target.instance_id);
+	for (i = 0; i < this->command_count && pos < _size; i++) {
+		if (i > 0 && this->command[i].name[0] == '\0')		// Rest of the value of the line before
+			pos += snprintf(message_buffer + pos - 1, _size - pos + 1, "%s\n", this->command[i].value) - 1;
+		else
+			pos += snprintf(message_buffer + pos, _size - pos, "%s=%s\n", this->command[i].name, this->command[i].value);
 		}
 
-	pos += sprintf(message_buffer + pos, "%s.%s\n{\n", this->schema.class_id, this->schema.type_id);
+	if (pos < _size)
+		pos += snprintf(message_buffer + pos, _size - pos, "}\n");
 
-	for (i = 0; i < this->command_count; i++) {
-		pos += sprintf(message_buffer + pos, "%s=%s\n", this->command[i].name, this->command[i].value);
+	if (pos >= _size) {
+		message_buffer[0] = '\0';
+		return false;
 		}
-
-	sprintf(message_buffer + pos, "}\n");
+	return true;
 	}
 
 
@@ -35,8 +35,8 @@
 #define XPL_STAT 2
 #define XPL_TRIG 3
 
-#define XPL_MESSAGE_BUFFER_MAX           256  // going over 256 would mean changing index from unsigned char to int
-#define XPL_MESSAGE_COMMAND_MAX          10
+#define XPL_MESSAGE_BUFFER_MAX           512  // Longest message, sent or received, with its NUL
+#define XPL_MESSAGE_COMMAND_MAX          32   // Room for 10 sensor readings of 3 lines
 
 struct xPL_Message {
 	short type;			        // 1=cmnd, 2=stat, 3=trig
@@ -48,16 +48,18 @@ struct xPL_Message {
 	struct_xpl_schema schema;
 	struct_command *command;
 	unsigned char command_count;
+	unsigned char targets;		// Received messages: bitmap of our instances it is for, see xPL_TargetInstances
 	};
 
 typedef struct xPL_Message xPL_Message;
 
 bool xPL_Message_AddCommand(xPL_Message *this, const char* _name, const char* _value);
+const char *xPL_Message_GetValue(xPL_Message *this, unsigned char _index, char *_value);
 
 xPL_Message *new_xPL_Message(void);
-void free_xPL_Message_(xPL_Message *this);
+void free_xPL_Message(xPL_Message *this);
 
-void xPL_Message_toString(xPL_Message *this, char message_buffer[]);
+bool xPL_Message_toString(xPL_Message *this, char message_buffer[], int _size);
 
 bool xPL_Message_IsSchema(xPL_Message *this, const char * _classId, const char* _typeId);
 		
@@ -0,0 +1,68 @@
+/*
+* xPL for ESP8266
+*
+* Traffic and error counters, sent as an esp.counters status message on esp.request query=counters
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "esp_common.h"
+#include <stdio.h>
+#include "UserConfig.h"
+#include "xPL.h"
+#include "xPL_Stats.h"
+
+struct xpl_stats xPL_stats;
+
+/**
+* \brief     Send the counters as an esp.counters status message
+* \details   rx=received,queued,handled,filtered drop=empty,size,nomem,full parse=failures for header lines 1 to 4
+*            parse5=the same for lines 5 to 8 tx=sent,errors bin=binary frames received,malformed,sent
+*            Values longer than XPL_VALUE_LENGTH_MAX spill over, see xPL_Message_AddCommand.
+*/
+void ICACHE_FLASH_ATTR xPL_SendStats(void) {
+	xPL_Message *msg = new_xPL_Message();
+	char value[XPL_STATS_VALUE_MAX + 1];
+
+	msg->type = XPL_STAT;
+	msg->hop = 1;
+
+	xPL_Message_SetTarget(msg, "*", NULL, NULL);
+	xPL_Message_SetSchema(msg, "esp", "counters");
+
+	snprintf(value, sizeof(value), "%u,%u,%u,%u", xPL_stats.received, xPL_stats.queued, xPL_stats.handled, xPL_stats.filtered);
+	xPL_Message_AddCommand(msg, "rx", value);
+
+	snprintf(value, sizeof(value), "%u,%u,%u,%u", xPL_stats.drop_empty, xPL_stats.drop_size, xPL_stats.drop_nomem, xPL_stats.drop_full);
+	xPL_Message_AddCommand(msg, "drop", value);
+
+	snprintf(value, sizeof(value), "%u,%u,%u,%u", xPL_stats.parse_fail[0], xPL_stats.parse_fail[1], xPL_stats.parse_fail[2], xPL_stats.parse_fail[3]);
+	xPL_Message_AddCommand(msg, "parse", value);
+	snprintf(value, sizeof(value), "%u,%u,%u,%u", xPL_stats.parse_fail[4], xPL_stats.parse_fail[5], xPL_stats.parse_fail[6], xPL_stats.parse_fail[7]);
+	xPL_Message_AddCommand(msg, "parse5", value);
+
+	snprintf(value, sizeof(value), "%u,%u", xPL_stats.sent, xPL_stats.send_err);
+	xPL_Message_AddCommand(msg, "tx", value);
+
+#if XPL_BINARY
+	snprintf(value, sizeof(value), "%u,%u,%u", xPL_stats.bin_rx, xPL_stats.bin_fail, xPL_stats.bin_tx);
+	xPL_Message_AddCommand(msg, "bin", value);
+#endif
+
+	xPL_SendMessage(msg, true);
+	free_xPL_Message(msg);
+	}
@@ -0,0 +1,59 @@
+/*
+* xPL for ESP8266
+*
+* Traffic and error counters
+*
+* Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef xPLStats_h
+#define xPLStats_h
+
+#include "esp_common.h"
+
+#define XPL_PARSE_LINES		8		// Header lines, up to the opening brace of the body
+#define XPL_STATS_VALUE_MAX		43		// Four 32 bit counters and their commas, no more than XPL_CONFIG_VALUE_MAX
+
+// The receive side counters are only written by the UDP callback, or by the receive task or
+// the event loop, and are plain increments. sent, send_err and bin_tx are bumped by whichever
+// task sends, so they go through XPL_STATS_INC. Reads take no lock, a count read while
+// another task bumps it is off by one at worst.
+struct xpl_stats {
+	uint32 received;				// Packets from the UDP callback
+	uint32 queued;					// Passed on to the receive task or the event loop
+	uint32 drop_empty;				// Dropped, empty
+	uint32 drop_size;				// Dropped, too long for the parser
+	uint32 drop_nomem;				// Dropped, no memory for a copy
+	uint32 drop_full;				// Dropped, queue full
+	uint32 parse_fail[XPL_PARSE_LINES];	// Malformed, by header line
+	uint32 handled;					// Parsed and given to the user routine
+	uint32 filtered;				// Of those, kept from the handlers by the filters
+	uint32 sent;					// Packets sent
+	uint32 send_err;				// Send failures
+	uint32 bin_rx;					// Binary frames received
+	uint32 bin_fail;				// Of those, malformed
+	uint32 bin_tx;					// Binary frames sent
+	};
+
+extern struct xpl_stats xPL_stats;
+
+// Read-modify-write of a counter written from several tasks. Needs freertos/task.h.
+#define XPL_STATS_INC(counter)	do { taskENTER_CRITICAL(); xPL_stats.counter++; taskEXIT_CRITICAL(); } while (0)
+
+void xPL_SendStats(void);
+
+#endif
@@ -2,11 +2,23 @@
 * xPL for ESP8266
 * 
 * This file holds the user functions for the ESP8266 xPL implementation.
-* process_message gets called whenever a properly formated xPL message is received.
+* process_message gets called whenever a properly formated xPL message for this device, or for everyone, is received.
 * this example checks for an X10.BASIC ON or OFF command and turns GPIO0 on or off to control an LED
+* Devices that are dimmers also take DIM, BRIGHT, PREDIM1/2 with a level.
+* Outputs are recorded in the state table, which sends their stat when they change and answers STATUS_REQUEST.
 *
-* xPL_send_trigger gets called by the input debounce routine whenever a transition is detected on GPIO2
-* it then formats an X10 ON or OFF trigger message and sends it
+* xPL_send_trigger gets called by the input debounce routine whenever a transition is detected on one of the inputs
+* it then formats an X10 ON or OFF trigger message and sends it. xPL_send_input does the same with a sensor.basic message.
+*
+* config.response messages with input=pin,device[,sensor] lines change the input map,
+* reliable=class.type,... lines the triggers that are sent until they are acknowledged,
+* rule= and action= lines the local rules, scene= lines the scenes, sensor-hold=ms how long sensor readings
+* wait for others to share their message, and bin-gateway=1 or 0 whether the device passes binary frames on as text. The triggers the device sends go through the rules too.
+* esp.batch commands switch several outputs, and scenes, at once.
+*
+* With RELAYS set, each relay of the board shows up as an xPL instance of its own, and relay_message
+* switches its output on x10.basic ON and OFF commands sent to it, or to one of its groups.
+* sensor.request messages get the current value of the sensor back
 
 * Copyright (C) 2014  Pierre Benard xsc.peteben@neverbox.com
 *
@@ -30,6 +42,16 @@
 #include "xPL.h"
 #include <string.h>
 #include "UserConfig.h"
+#include "FastBoot.h"
+#include "Debounce.h"
+#include "Sensor.h"
+#include "Dimmer.h"
+#include "Latency.h"
+#include "Reliable.h"
+#include "State.h"
+#include "Rules.h"
+#include "Scene.h"
+#include "xPL_Binary.h"
 
 
 #define CMD_ALL_UNITS_OFF     0
@@ -98,49 +120,231 @@ int toupper(int c) {
 	return c >= 'a' && c <= 'z' ? (c - 'a' + 'A') : c;
 	}
 
-// Process a received xPL message
-void ICACHE_FLASH_ATTR process_message(xPL_Message *msg) {
-	unsigned char house = 0, unit = 0, X10cmd = 15,  i;
+#if DIMMER
+// X10 command for one of the dimmers, level in %, 0 to 100, if the message had one
+static void ICACHE_FLASH_ATTR dim_command(unsigned char ch, unsigned char X10cmd, bool has_level, int level) {
+	int step = has_level ? level * DIM_FULL / 100 : DIM_STEP;
 
-	if (xPL_TargetIsMe(msg)) {
-		if (xPL_Message_IsSchema(msg, "x10", "basic") && msg->type == XPL_CMND) {
-			struct_command *cmd = msg->command;
+	switch (X10cmd) {
+		case CMD_ON: dimmer_on(ch); break;
+		case CMD_OFF: dimmer_off(ch); break;
+		case CMD_DIM: dimmer_step(ch, -step); break;
+		case CMD_BRIGHT: dimmer_step(ch, step); break;
+		case CMD_PRE_SET_DIM_0:
+		case CMD_PRE_SET_DIM_1: if (has_level) dimmer_set(ch, step); break;
+		}
+	}
+#endif
 
-			for (i = 0; i < msg->command_count; i++) {
-				if (strcasecmp(cmd->name, "device") == 0) {
-					house = toupper(cmd->value[0]);
-					unit = atoi(cmd->value + 1);
-					}
+// Record the new state of an output, its stat goes out if it changed
+static void ICACHE_FLASH_ATTR output_changed(unsigned char instance, char house, unsigned char unit, bool on, unsigned char level) {
+	signed char idx = state_find(instance, house, unit, false);
+
+	if (idx >= 0) state_set(idx, on, level);
+	}
+
+// Answer a STATUS_REQUEST for one of our devices, output or input
+static void ICACHE_FLASH_ATTR status_request(unsigned char instance, char house, unsigned char unit) {
+	signed char idx = state_find(instance, house, unit, false);
+
+	if (idx < 0) idx = state_find(instance, house, unit, true);
+	if (idx >= 0) state_send(idx);
+	}
 
-				if (strcasecmp(cmd->name, "command") == 0) {
-					unsigned char j;
-					for (j = 0; j < 15; j++) {
-						if (strcasecmp(cmd->value, X10ToString(j)) == 0) {
-							X10cmd = j;
-							break;
-							}
+// sensor.request for an input reported as sensor.basic
+static void ICACHE_FLASH_ATTR input_request(unsigned char instance, const char *device) {
+	signed char idx = state_find(instance, toupper(device[0]), atoi(device + 1), true);
+
+	if (idx >= 0 && state_get(idx)->kind == STATE_SENSOR) state_send(idx);
+	}
+
+// Process a received xPL message, for the device itself, instance 0
+void ICACHE_FLASH_ATTR process_message(xPL_Message *msg, unsigned char instance) {
+	unsigned char house = 0, unit = 0, X10cmd = 0xFF, i;
+#if DIMMER
+	bool has_level = false;
+	int level = 0, ch;
+#endif
+
+	latency_mark(LAT_DISPATCH);
+
+	if (xPL_Message_IsSchema(msg, "x10", "basic") && msg->type == XPL_CMND) {
+		struct_command *cmd = msg->command;
+
+		for (i = 0; i < msg->command_count; i++) {
+			if (strcasecmp(cmd->name, "device") == 0) {
+				house = toupper(cmd->value[0]);
+				unit = atoi(cmd->value + 1);
+				}
+
+#if DIMMER
+			if (strcasecmp(cmd->name, "level") == 0) {
+				level = atoi(cmd->value);
+				has_level = level >= 0 && level <= 100;		// Out of range is as good as none
+				}
+#endif
+
+			if (strcasecmp(cmd->name, "command") == 0) {
+				unsigned char j;
+				for (j = 0; j < 16; j++) {
+					if (strcasecmp(cmd->value, X10ToString(j)) == 0) {
+						X10cmd = j;
+						break;
 						}
 					}
-				cmd++;
 				}
+			cmd++;
+			}
 
-			if (house == MYHOUSE && unit == MYUNIT) {
-				if (X10cmd == CMD_ON) {
-					gpio_output_set(0, LED_GPIO, LED_GPIO, 0);
-					}
+		if (X10cmd == CMD_STATUS_REQUEST) {
+			status_request(instance, house, unit);
+			}
+		else
+#if DIMMER
+		if ((ch = dimmer_find(house, unit)) >= 0) {
+			dim_command(ch, X10cmd, has_level, level);
+			latency_mark(LAT_HANDLER);
+			level = (dimmer_level(ch) * 100 + DIM_FULL / 2) / DIM_FULL;
+			output_changed(instance, house, unit, level != 0, level);
+			}
+		else
+#endif
+		if (house == MYHOUSE && unit == MYUNIT) {
+			if (X10cmd == CMD_ON) {
+				gpio_output_set(0, LED_GPIO, LED_GPIO, 0);
+				latency_mark(LAT_HANDLER);
+				output_changed(instance, house, unit, true, 0);
+				}
 
-				if (X10cmd == CMD_OFF) {
-					gpio_output_set(LED_GPIO, 0, LED_GPIO, 0);
-					}
+			if (X10cmd == CMD_OFF) {
+				gpio_output_set(LED_GPIO, 0, LED_GPIO, 0);
+				latency_mark(LAT_HANDLER);
+				output_changed(instance, house, unit, false, 0);
+				}
+#if FAST_BOOT
+			fastboot_save_outputs(LED_GPIO);		// Keep the new state across a reset
+#endif
+			}
+		}
+
+#if SCENES
+	if (xPL_Message_IsSchema(msg, "esp", "batch") && msg->type == XPL_CMND && scene_batch(msg)) {
+		latency_mark(LAT_HANDLER);
+		}
+#endif
+
+	if (xPL_Message_IsSchema(msg, "sensor", "request") && msg->type == XPL_CMND) {
+		struct_command *cmd = msg->command;
+
+		for (i = 0; i < msg->command_count; i++) {
+			if (strcasecmp(cmd->name, "device") == 0 && !sensor_request(cmd->value)) {
+				input_request(instance, cmd->value);
+				}
+			cmd++;
+			}
+		}
+
+	if (xPL_Message_IsSchema(msg, "config", "response") && msg->type == XPL_CMND) {
+		struct_command *cmd = msg->command;
+		char value[XPL_CONFIG_VALUE_MAX + 1];
+
+#if RULES
+		rule_config(msg);
+#endif
+
+		for (i = 0; i < msg->command_count; i++) {
+			xPL_Message_GetValue(msg, i, value);		// With the rest of a long line
+			if (strcasecmp(cmd->name, "input") == 0 && !debounce_config(value)) {
+				printf("Bad input config: %s\n", value);
+				}
+#if RELIABLE
+			if (strcasecmp(cmd->name, "reliable") == 0) {
+				reliable_config(value);
+				}
+#endif
+#if SCENES
+			if (strcasecmp(cmd->name, "scene") == 0 && !scene_config(value)) {
+				printf("Bad scene: %s\n", value);
+				}
+#endif
+			if (strcasecmp(cmd->name, "sensor-hold") == 0 && !sensor_set_hold(atoi(value))) {
+				printf("Bad sensor hold: %s\n", value);
 				}
+#if XPL_BINARY
+			if (strcasecmp(cmd->name, "bin-gateway") == 0) {
+				xPL_bin_gateway = atoi(value) != 0;
+				}
+#endif
+			cmd++;
 			}
 		}
 	}
 
+#if RELAYS
+static const struct {
+	const char *instance_id;
+	uint16 gpio;
+	} relay_map[] = RELAY_MAP;
+
+static uint16 relay_gpio[XPL_INSTANCE_MAX];		// Output of each relay, by instance
+
+// Process a received xPL message for one of the relays. The instance is the address, the device line is not looked at,
+// so commands sent to * are ignored, they would switch every relay at once.
+static void ICACHE_FLASH_ATTR relay_message(xPL_Message *msg, unsigned char instance) {
+	struct_command *cmd = msg->command;
+	unsigned char i;
+
+	latency_mark(LAT_DISPATCH);
+
+	if (!xPL_Message_IsSchema(msg, "x10", "basic") || msg->type != XPL_CMND || msg->target.vendor_id[0] == '*')
+		return;
+
+	for (i = 0; i < msg->command_count; i++, cmd++) {
+		if (strcasecmp(cmd->name, "command") != 0)
+			continue;
+
+		if (strcasecmp(cmd->value, "on") == 0) {
+			gpio_output_set(relay_gpio[instance], 0, relay_gpio[instance], 0);
+			latency_mark(LAT_HANDLER);
+			output_changed(instance, 0, 0, true, 0);
+			}
+		else if (strcasecmp(cmd->value, "off") == 0) {
+			gpio_output_set(0, relay_gpio[instance], relay_gpio[instance], 0);
+			latency_mark(LAT_HANDLER);
+			output_changed(instance, 0, 0, false, 0);
+			}
+		else if (strcasecmp(cmd->value, "status_request") == 0) {
+			status_request(instance, 0, 0);
+			}
+		}
+	}
+
+// Add an instance for each relay, all of them off. The state table must be set up.
+void ICACHE_FLASH_ATTR relay_init(void) {
+	signed char inst;
+	unsigned char i, pin;
+
+	for (i = 0; i < sizeof(relay_map) / sizeof(relay_map[0]); i++) {
+		inst = xPL_AddInstance(relay_map[i].instance_id, relay_message);
+		if (inst < 0) {
+			printf("No room for relay %s\n", relay_map[i].instance_id);
+			continue;
+			}
+
+		relay_gpio[inst] = relay_map[i].gpio;
+		for (pin = 0; pin < 16; pin++) {
+			if (relay_map[i].gpio & (1 << pin)) pin_select_gpio(pin, false);
+			}
+		gpio_output_set(0, relay_map[i].gpio, relay_map[i].gpio, 0);
+		state_add(STATE_OUTPUT, inst, 0, 0, relay_map[i].gpio, false);
+		}
+	}
+#endif
+
 // Send an X10 trigger message
 void ICACHE_FLASH_ATTR xPL_send_trigger(unsigned char house, unsigned char unit, unsigned char state) {
 	xPL_Message *msg = new_xPL_Message();
-	char device[4];
+	char device[5];						// House and up to 3 digits of unit
 
 	msg->type = XPL_TRIG;
 	msg->hop = 1;
@@ -151,6 +355,39 @@ void ICACHE_FLASH_ATTR xPL_send_trigger(unsigned char house, unsigned char unit,
 	sprintf(device, "%c%d", house, unit);
 	xPL_Message_AddCommand(msg, "command", state ? "on" : "off");
 	xPL_Message_AddCommand(msg, "device", device);
+#if RULES
+	rule_run(msg);
+#endif
+#if RELIABLE
+	reliable_send(msg);
+#else
+	xPL_SendMessage(msg, true);
+#endif
+	free_xPL_Message(msg);
+	}
+
+// Send a sensor.basic trigger for a digital input
+void ICACHE_FLASH_ATTR xPL_send_input(unsigned char house, unsigned char unit, unsigned char state) {
+	xPL_Message *msg = new_xPL_Message();
+	char device[5];						// House and up to 3 digits of unit
+
+	msg->type = XPL_TRIG;
+	msg->hop = 1;
+
+	xPL_Message_SetTarget(msg, "*", NULL, NULL);
+	xPL_Message_SetSchema(msg, "sensor", "basic");
+
+	sprintf(device, "%c%d", house, unit);
+	xPL_Message_AddCommand(msg, "device", device);
+	xPL_Message_AddCommand(msg, "type", "input");
+	xPL_Message_AddCommand(msg, "current", state ? "low" : "high");		// Closed contact pulls the pin low
+#if RULES
+	rule_run(msg);
+#endif
+#if RELIABLE
+	reliable_send(msg);
+#else
 	xPL_SendMessage(msg, true);
+#endif
 	free_xPL_Message(msg);
 	}
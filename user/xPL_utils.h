@@ -43,12 +43,13 @@ typedef  unsigned char byte;
 #define	XPL_TYPE_ID_MAX			8
 #define XPL_NAME_LENGTH_MAX		16
 #define XPL_VALUE_LENGTH_MAX	32  // should be 128 but need to spare RAM
+#define XPL_CONFIG_VALUE_MAX	64  // config lines (filter=, rule=, action=...) spill over into more commands, see xPL_Message_AddCommand
 
 #define	XPL_HOP_COUNT_PARSER	"hop=%d"
 #define	XPL_SOURCE_PARSER		"source=%8[^-]-%8[^'.'].%16s"
 #define	XPL_TARGET_PARSER		"target=%8[^-]-%8[^'.'].%16s"
 #define	XPL_SCHEMA_PARSER		"%8[^'.'].%8s"
-#define XPL_COMMAND_PARSER		"%16[^'=']=%32s"    // 32 shall match XPL_VALUE_LENGTH_MAX
+#define XPL_COMMAND_PARSER		"%16[^'=']=%64s"    // 64 shall match XPL_CONFIG_VALUE_MAX
 
 //#define true 1
 //#define false 0
@@ -72,6 +73,11 @@ struct struct_command {		// source or target
 	char value[XPL_VALUE_LENGTH_MAX+1];		// device id
 	};
 
+// In sscanf.c
+int strcasecmp(const char *s1, const char *s2);
+int strncasecmp(const char *s1, const char *s2, size_t n);
+size_t strlcpy(char *dst, const char *src, size_t siz);
+
 void clearStr (char* str);
 void Sprint(const char *s);
 void Sprintln(const char *);